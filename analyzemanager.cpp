@@ -1,4 +1,5 @@
 #include "analyzemanager.h"
+#include "tracer.h"
 
 #include <QDebug>
 #include <QDir>
@@ -6,21 +7,69 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QThreadPool>
+
+#include <algorithm>
+
+namespace {
+
+// Removed recordings are moved here first and deleted together.
+const QLatin1String s_trashName(".removed");
+
+} // namespace
 
 AnalyzeManager::AnalyzeManager(QObject *parent)
     : QObject{parent}
-{}
+    , m_jobs(new QThreadPool(this))
+{
+    m_jobs->setMaxThreadCount(1);
+}
+
+AnalyzeManager::~AnalyzeManager()
+{
+    m_jobs->waitForDone();
+}
 
 void AnalyzeManager::analyzeDataAdded(const QString &location)
 {
+    QAI_TRACE_SCOPE("analyze", "analyzeDataAdded");
     qDebug() << Q_FUNC_INFO << location;
 
+    const QVariantMap point = readPoint(location);
+    if (point.isEmpty())
+    {
+        return;
+    }
+
+    emit dataAdded(point);
+}
+
+QVariantMap AnalyzeManager::readPoint(const QString &location)
+{
+    QVariantMap point = readPointObject(location).toVariantMap();
+    if (point.isEmpty())
+    {
+        return {};
+    }
+
+    point.insert("location", location);
+    if (!point.contains("id"))
+    {
+        point.insert("id", "");
+    }
+
+    return point;
+}
+
+QJsonObject AnalyzeManager::readPointObject(const QString &location)
+{
     QFile pointFile(location + "/point.json");
     if (!pointFile.open(QIODevice::ReadOnly))
     {
         qWarning() << Q_FUNC_INFO << "Failed to open point file:" << pointFile.fileName();
-        return;
+        return {};
     }
 
     QByteArray pointData = pointFile.readAll();
@@ -29,7 +78,7 @@ void AnalyzeManager::analyzeDataAdded(const QString &location)
     if (pointData.isEmpty())
     {
         qWarning() << Q_FUNC_INFO << "Point data is empty in file:" << pointFile.fileName();
-        return;
+        return {};
     }
 
     QJsonParseError parseError;
@@ -37,26 +86,87 @@ void AnalyzeManager::analyzeDataAdded(const QString &location)
     if (parseError.error != QJsonParseError::NoError)
     {
         qWarning() << Q_FUNC_INFO << "Failed to parse point data:" << parseError.errorString();
-        return;
+        return {};
     }
     if (!doc.isObject())
     {
         qWarning() << Q_FUNC_INFO << "Point data is not an object:" << pointData;
-        return;
+        return {};
     }
-    QVariantMap point = doc.object().toVariantMap();
-    point.insert("location", location);
-    if (!point.contains("id"))
+
+    return doc.object();
+}
+
+bool AnalyzeManager::writePointObject(const QString &location, const QJsonObject &point)
+{
+    // Written next to the old file and renamed over it, so a crash leaves
+    // one or the other intact.
+    QSaveFile pointFile(location + "/point.json");
+    if (!pointFile.open(QIODevice::WriteOnly))
     {
-        point.insert("id", "");
+        qWarning() << Q_FUNC_INFO << "Failed to open output file:" << pointFile.fileName();
+        return false;
     }
 
-    emit dataAdded(point);
+    pointFile.write(QJsonDocument(point).toJson());
+    if (!pointFile.commit())
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to write" << pointFile.fileName() << pointFile.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString AnalyzeManager::dataLocation()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+}
+
+QList<QVariantMap> AnalyzeManager::recordings()
+{
+    QDir dirPath(dataLocation());
+    QStringList files = dirPath.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    files.removeAll(s_trashName);
+
+    // Recording directories are named after the capture time in milliseconds.
+    std::sort(files.begin(), files.end(),
+              [](const QString &left, const QString &right)
+              {
+                  return left.toLongLong() < right.toLongLong();
+              });
+
+    QList<QVariantMap> result;
+    for (const QString &file : std::as_const(files))
+    {
+        QVariantMap point = readPoint(dirPath.absoluteFilePath(file));
+        if (!point.isEmpty())
+        {
+            point.insert("timestamp", file.toLongLong());
+            result.append(point);
+        }
+    }
+    return result;
+}
+
+bool AnalyzeManager::isBusy() const
+{
+    return m_completed < m_total;
+}
+
+int AnalyzeManager::completedOperations() const
+{
+    return m_completed;
+}
+
+int AnalyzeManager::totalOperations() const
+{
+    return m_total;
 }
 
 void AnalyzeManager::load()
 {
-    const auto dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QAI_TRACE_SCOPE("analyze", "load");
+    const auto dir = dataLocation();
 
     QDir dirPath(dir);
     if (!dirPath.exists())
@@ -65,70 +175,155 @@ void AnalyzeManager::load()
         return;
     }
 
-    const QStringList files = dirPath.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-    for (const QString &file : files)
+    QStringList files = dirPath.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    files.removeAll(s_trashName);
+    for (const QString &file : std::as_const(files))
     {
         const QString location = dirPath.absoluteFilePath(file);
-        analyzeDataAdded(location);
+        if (!m_removing.contains(location))
+        {
+            analyzeDataAdded(location);
+        }
     }
 }
 
 void AnalyzeManager::remove(const QString &location)
 {
-    qDebug() << Q_FUNC_INFO << location;
+    removeAll({location});
+}
 
-    QDir dir(location);
-    if (!dir.exists())
+void AnalyzeManager::removeAll(const QStringList &locations)
+{
+    qDebug() << Q_FUNC_INFO << locations.size();
+    if (locations.isEmpty())
     {
-        qWarning() << Q_FUNC_INFO << "Directory does not exist:" << location;
         return;
     }
 
-    if (!dir.removeRecursively())
+    for (const QString &location : locations)
     {
-        qWarning() << Q_FUNC_INFO << "Failed to remove directory:" << location;
+        m_removing.insert(location);
     }
+
+    enqueue(locations.size(),
+            [this, locations]()
+            {
+                QAI_TRACE_SCOPE("analyze", "removeAll");
+
+                // A rename takes a recording away at once; the files are
+                // deleted in one pass once all of them are out of the way.
+                const QString trashPath = dataLocation() + QLatin1Char('/') + s_trashName;
+                QDir().mkpath(trashPath);
+                QDir trash(trashPath);
+
+                for (const QString &location : locations)
+                {
+                    QDir dir(location);
+                    if (!dir.exists())
+                    {
+                        // Already gone, which is what was asked for.
+                        qWarning() << Q_FUNC_INFO << "Directory does not exist:" << location;
+                        operationDone([this, location]() { removed(location, true); });
+                        continue;
+                    }
+
+                    // Falls back to deleting in place when a leftover of an
+                    // interrupted batch has the same name.
+                    const QString target = trash.absoluteFilePath(dir.dirName());
+                    if (!QDir().rename(location, target) && !dir.removeRecursively())
+                    {
+                        qWarning() << Q_FUNC_INFO << "Failed to remove directory:" << location;
+                        operationDone([this, location]() { removed(location, false); });
+                        continue;
+                    }
+
+                    operationDone([this, location]() { removed(location, true); });
+                }
+
+                if (!trash.removeRecursively())
+                {
+                    qWarning() << Q_FUNC_INFO << "Failed to empty" << trashPath;
+                }
+            });
 }
 
-void AnalyzeManager::refine(const QString &location, const QString &id)
+void AnalyzeManager::removed(const QString &location, bool ok)
 {
-    qDebug() << Q_FUNC_INFO << location << id;
-
-    QFile pointFile(location + "/point.json");
-    if (!pointFile.open(QIODevice::ReadOnly))
+    m_removing.remove(location);
+    if (ok)
     {
-        qWarning() << Q_FUNC_INFO << "Failed to open point file:" << pointFile.fileName();
-        return;
+        emit dataRemoved(location);
     }
-
-    QByteArray pointData = pointFile.readAll();
-    pointFile.close();
-
-    if (pointData.isEmpty())
+    else
     {
-        qWarning() << Q_FUNC_INFO << "Point data is empty in file:" << pointFile.fileName();
-        return;
+        emit operationFailed(location);
     }
+}
 
-    QJsonParseError parseError;
-    QJsonDocument doc = QJsonDocument::fromJson(pointData, &parseError);
-    if (parseError.error != QJsonParseError::NoError)
+void AnalyzeManager::refine(const QString &location, const QString &id)
+{
+    refineAll({location}, id);
+}
+
+void AnalyzeManager::refineAll(const QStringList &locations, const QString &id)
+{
+    qDebug() << Q_FUNC_INFO << locations.size() << id;
+    if (locations.isEmpty())
     {
-        qWarning() << Q_FUNC_INFO << "Failed to parse point data:" << parseError.errorString();
         return;
     }
 
-    QJsonObject pointObject = doc.object();
-    pointObject.insert("id", id);
+    enqueue(locations.size(),
+            [this, locations, id]()
+            {
+                QAI_TRACE_SCOPE("analyze", "refineAll");
+
+                for (const QString &location : locations)
+                {
+                    QJsonObject point = readPointObject(location);
+                    if (point.isEmpty())
+                    {
+                        operationDone([this, location]() { emit operationFailed(location); });
+                        continue;
+                    }
+
+                    point.insert("id", id);
+                    if (!writePointObject(location, point))
+                    {
+                        operationDone([this, location]() { emit operationFailed(location); });
+                        continue;
+                    }
+
+                    operationDone([this, location, id]() { emit dataRefined(location, id); });
+                }
+            });
+}
 
-    QFile outFile(location + "/point.json");
-    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+void AnalyzeManager::enqueue(int operations, const std::function<void()> &job)
+{
+    if (!isBusy())
     {
-        qWarning() << Q_FUNC_INFO << "Failed to open output file:" << outFile.fileName();
-        return;
+        m_completed = 0;
+        m_total = 0;
     }
+    m_total += operations;
+    emit jobsChanged();
 
-    outFile.write(QJsonDocument(pointObject).toJson());
-
+    m_jobs->start(job);
+}
 
+void AnalyzeManager::operationDone(const std::function<void()> &notify)
+{
+    QMetaObject::invokeMethod(
+        this,
+        [this, notify]()
+        {
+            ++m_completed;
+            if (notify)
+            {
+                notify();
+            }
+            emit jobsChanged();
+        },
+        Qt::QueuedConnection);
 }
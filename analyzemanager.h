@@ -1,20 +1,64 @@
 #pragma once
 
+#include <QJsonObject>
 #include <QObject>
 #include <QPoint>
+#include <QSet>
 
+#include <functional>
+
+class QThreadPool;
+
+// Recordings of the analyze stream, one directory per tap. Removing and
+// refining run as jobs on a single background thread, in the order they
+// were requested; the signals for each recording are emitted on the
+// owner's thread as it is done, operationFailed when it could not be.
 class AnalyzeManager : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(bool busy READ isBusy NOTIFY jobsChanged)
+    // Recordings handled and still queued since the queue was last idle.
+    Q_PROPERTY(int completedOperations READ completedOperations NOTIFY jobsChanged)
+    Q_PROPERTY(int totalOperations READ totalOperations NOTIFY jobsChanged)
 public:
     explicit AnalyzeManager(QObject *parent = nullptr);
+    ~AnalyzeManager() override;
 
     void analyzeDataAdded(const QString &location);
 
+    static QVariantMap readPoint(const QString &location);
+    static QList<QVariantMap> recordings();
+
+    bool isBusy() const;
+    int completedOperations() const;
+    int totalOperations() const;
+
     Q_INVOKABLE void load();
     Q_INVOKABLE void remove(const QString &location);
+    Q_INVOKABLE void removeAll(const QStringList &locations);
     Q_INVOKABLE void refine(const QString &location, const QString &id);
+    Q_INVOKABLE void refineAll(const QStringList &locations, const QString &id);
 
 signals:
     void dataAdded(const QVariantMap &point);
+    void dataRemoved(const QString &location);
+    void dataRefined(const QString &location, const QString &id);
+    void operationFailed(const QString &location);
+    void jobsChanged();
+
+private:
+    static QJsonObject readPointObject(const QString &location);
+    static bool writePointObject(const QString &location, const QJsonObject &point);
+    static QString dataLocation();
+
+    void enqueue(int operations, const std::function<void()> &job);
+    void removed(const QString &location, bool ok);
+    // Called from a job for every recording it handled.
+    void operationDone(const std::function<void()> &notify);
+
+    QThreadPool *m_jobs {};
+    // Queued for removal; load() leaves them out.
+    QSet<QString> m_removing;
+    int m_completed = 0;
+    int m_total = 0;
 };
@@ -0,0 +1,323 @@
+#include "base64.h"
+
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define QAI_BASE64_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Maps every byte to its 6 bit value, or -1.
+struct DecodeTable
+{
+    signed char values[256];
+
+    constexpr DecodeTable()
+        : values()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            values[i] = -1;
+        }
+        const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i)
+        {
+            values[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+        }
+    }
+};
+
+constexpr DecodeTable s_table;
+
+// Decodes whole quanta, the last one possibly padded. Returns the number of
+// bytes written or -1.
+qsizetype decodeScalar(const unsigned char *in, qsizetype size, char *out)
+{
+    char *const begin = out;
+    const unsigned char *const end = in + size;
+
+    while (in < end)
+    {
+        const int a = s_table.values[in[0]];
+        const int b = s_table.values[in[1]];
+        const int c = s_table.values[in[2]];
+        const int d = s_table.values[in[3]];
+
+        if ((a | b | c | d) >= 0)
+        {
+            const quint32 word = quint32(a) << 18 | quint32(b) << 12 | quint32(c) << 6 | quint32(d);
+            out[0] = char(word >> 16);
+            out[1] = char(word >> 8);
+            out[2] = char(word);
+            out += 3;
+            in += 4;
+            continue;
+        }
+
+        // Only the final quantum may carry padding.
+        if (in + 4 != end || (a | b) < 0 || in[3] != '=')
+        {
+            return -1;
+        }
+        if (in[2] == '=')
+        {
+            out[0] = char((a << 2) | (b >> 4));
+            out += 1;
+        }
+        else if (c >= 0)
+        {
+            out[0] = char((a << 2) | (b >> 4));
+            out[1] = char((b << 4) | (c >> 2));
+            out += 2;
+        }
+        else
+        {
+            return -1;
+        }
+        in += 4;
+    }
+
+    return out - begin;
+}
+
+#ifdef QAI_BASE64_X86
+
+// Translates 16 ASCII characters into 6 bit values (Muła's pshufb lookup)
+// and reports invalid characters through *invalid.
+__attribute__((target("sse4.1")))
+inline __m128i translate128(__m128i input, int *invalid)
+{
+    const __m128i higherNibble = _mm_and_si128(_mm_srli_epi32(input, 4), _mm_set1_epi8(0x0f));
+    const __m128i lowerNibble = _mm_and_si128(input, _mm_set1_epi8(0x0f));
+
+    const __m128i shiftLut = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i maskLut = _mm_setr_epi8(char(0xa8), char(0xf8), char(0xf8), char(0xf8),
+                                          char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                                          char(0xf8), char(0xf8), char(0xf0), char(0x54),
+                                          char(0x50), char(0x50), char(0x50), char(0x54));
+    const __m128i bitLut = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+
+    const __m128i shift = _mm_blendv_epi8(_mm_shuffle_epi8(shiftLut, higherNibble), _mm_set1_epi8(16),
+                                          _mm_cmpeq_epi8(input, _mm_set1_epi8('/')));
+    const __m128i mask = _mm_shuffle_epi8(maskLut, lowerNibble);
+    const __m128i bit = _mm_shuffle_epi8(bitLut, higherNibble);
+
+    *invalid |= _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(mask, bit), _mm_setzero_si128()));
+    return _mm_add_epi8(input, shift);
+}
+
+// Packs 16 6 bit values into 12 bytes at the start of the register.
+__attribute__((target("sse4.1")))
+inline __m128i pack128(__m128i values)
+{
+    const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("sse4.1")))
+qsizetype decodeSse41(const unsigned char *in, qsizetype size, char *out)
+{
+    char *const begin = out;
+    const unsigned char *const end = in + size;
+
+    // Stores write 16 bytes for 12 decoded ones; stop early enough that the
+    // slack stays inside the output and the padded tail is left to the
+    // scalar loop.
+    while (end - in >= 24)
+    {
+        int invalid = 0;
+        const __m128i values = translate128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in)), &invalid);
+        if (invalid)
+        {
+            return -1;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), pack128(values));
+        in += 16;
+        out += 12;
+    }
+
+    const qsizetype tail = decodeScalar(in, end - in, out);
+    return tail < 0 ? -1 : (out - begin) + tail;
+}
+
+__attribute__((target("avx2")))
+qsizetype decodeAvx2(const unsigned char *in, qsizetype size, char *out)
+{
+    char *const begin = out;
+    const unsigned char *const end = in + size;
+
+    const __m256i shiftLut = _mm256_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i maskLut = _mm256_setr_epi8(char(0xa8), char(0xf8), char(0xf8), char(0xf8),
+                                             char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                                             char(0xf8), char(0xf8), char(0xf0), char(0x54),
+                                             char(0x50), char(0x50), char(0x50), char(0x54),
+                                             char(0xa8), char(0xf8), char(0xf8), char(0xf8),
+                                             char(0xf8), char(0xf8), char(0xf8), char(0xf8),
+                                             char(0xf8), char(0xf8), char(0xf0), char(0x54),
+                                             char(0x50), char(0x50), char(0x50), char(0x54));
+    const __m256i bitLut = _mm256_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                                            0, 0, 0, 0, 0, 0, 0, 0,
+                                            0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                                            0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i packShuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i packLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    // 32 byte stores for 24 decoded bytes, see decodeSse41.
+    while (end - in >= 48)
+    {
+        const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+        const __m256i higherNibble = _mm256_and_si256(_mm256_srli_epi32(input, 4), _mm256_set1_epi8(0x0f));
+        const __m256i lowerNibble = _mm256_and_si256(input, _mm256_set1_epi8(0x0f));
+
+        const __m256i shift = _mm256_blendv_epi8(_mm256_shuffle_epi8(shiftLut, higherNibble), _mm256_set1_epi8(16),
+                                                 _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/')));
+        const __m256i mask = _mm256_shuffle_epi8(maskLut, lowerNibble);
+        const __m256i bit = _mm256_shuffle_epi8(bitLut, higherNibble);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(mask, bit), _mm256_setzero_si256())))
+        {
+            return -1;
+        }
+
+        const __m256i values = _mm256_add_epi8(input, shift);
+        const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, packShuffle), packLanes);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), packed);
+        in += 32;
+        out += 24;
+    }
+
+    const qsizetype tail = decodeSse41(in, end - in, out);
+    return tail < 0 ? -1 : (out - begin) + tail;
+}
+
+#endif
+
+using DecodeFunction = qsizetype (*)(const unsigned char *, qsizetype, char *);
+
+struct Implementation
+{
+    DecodeFunction decode;
+    const char *name;
+};
+
+Implementation selectImplementation()
+{
+#ifdef QAI_BASE64_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {decodeAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return {decodeSse41, "sse4.1"};
+    }
+#endif
+    return {decodeScalar, "scalar"};
+}
+
+const Implementation &implementationForCpu()
+{
+    static const Implementation implementation = selectImplementation();
+    return implementation;
+}
+
+} // namespace
+
+namespace Base64 {
+
+bool decode(QByteArrayView input, QByteArray *output)
+{
+    if (input.size() % 4 != 0)
+    {
+        return false;
+    }
+
+    output->resize(input.size() / 4 * 3);
+    const qsizetype size = implementationForCpu().decode(
+        reinterpret_cast<const unsigned char *>(input.data()), input.size(), output->data());
+    if (size < 0)
+    {
+        return false;
+    }
+    output->truncate(size);
+    return true;
+}
+
+QByteArray decode(QByteArrayView input)
+{
+    QByteArray output;
+    if (decode(input, &output))
+    {
+        return output;
+    }
+    return QByteArray::fromBase64(input.toByteArray());
+}
+
+const char *implementation()
+{
+    return implementationForCpu().name;
+}
+
+QByteArrayView jsonStringValue(QByteArrayView json, QByteArrayView key)
+{
+    const char *const end = json.data() + json.size();
+
+    qsizetype from = 0;
+    while (true)
+    {
+        const qsizetype keyAt = json.indexOf(key, from);
+        if (keyAt < 0)
+        {
+            return {};
+        }
+        from = keyAt + key.size();
+
+        // The key has to be a whole JSON string followed by a colon.
+        if (keyAt == 0 || json.at(keyAt - 1) != '"' || from >= json.size() || json.at(from) != '"')
+        {
+            continue;
+        }
+        if (keyAt >= 2 && json.at(keyAt - 2) == '\\')
+        {
+            continue;
+        }
+
+        const char *p = json.data() + from + 1;
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        if (p == end || *p != ':')
+        {
+            continue;
+        }
+        ++p;
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        if (p == end || *p != '"')
+        {
+            return {};
+        }
+        ++p;
+
+        const char *close = static_cast<const char *>(memchr(p, '"', size_t(end - p)));
+        if (!close || memchr(p, '\\', size_t(close - p)))
+        {
+            return {};
+        }
+        return QByteArrayView(p, close - p);
+    }
+}
+
+} // namespace Base64
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+// Base64 decoding straight from reply bytes. Blocks of 32 (AVX2) or 16
+// (SSE4.1) characters are translated and validated with pshufb lookups and
+// packed with multiply-add, the instruction set being picked at runtime;
+// everything else goes through a table driven scalar loop.
+namespace Base64 {
+
+// Decodes standard, padded base64 into output. Returns false, leaving
+// output unspecified, when the input contains anything else.
+bool decode(QByteArrayView input, QByteArray *output);
+
+// Decodes input, falling back to QByteArray::fromBase64 (which skips
+// invalid characters) when it is not strictly valid base64.
+QByteArray decode(QByteArrayView input);
+
+// The implementation selected for this CPU: "avx2", "sse4.1" or "scalar".
+const char *implementation();
+
+// Finds the contents of the string value of key in a serialized JSON
+// object without parsing it. Returns a null view when the key is missing,
+// its value is not a string, or the string contains escapes.
+QByteArrayView jsonStringValue(QByteArrayView json, QByteArrayView key);
+
+} // namespace Base64
@@ -0,0 +1,318 @@
+#include "boundsoverlay.h"
+#include "mytreemodel2.h"
+#include "overlayboxes.h"
+#include "tracer.h"
+
+#include <QHoverEvent>
+#include <QMatrix4x4>
+#include <QSGGeometryNode>
+#include <QSGTransformNode>
+#include <QSGVertexColorMaterial>
+
+BoundsOverlay::BoundsOverlay(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents);
+    setAcceptHoverEvents(true);
+}
+
+MyTreeModel2 *BoundsOverlay::model() const
+{
+    return m_model;
+}
+
+void BoundsOverlay::setModel(MyTreeModel2 *model)
+{
+    if (m_model == model)
+    {
+        return;
+    }
+
+    if (m_model)
+    {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model)
+    {
+        connect(m_model, &QAbstractItemModel::modelReset, this, &BoundsOverlay::rebuild);
+        connect(m_model, &MyTreeModel2::nodesUpdated, this, &BoundsOverlay::rebuild);
+        connect(m_model, &MyTreeModel2::selectedIndexChanged, this, &BoundsOverlay::updateSelection);
+    }
+
+    rebuild();
+    emit modelChanged();
+}
+
+QSizeF BoundsOverlay::sourceSize() const
+{
+    return m_sourceSize;
+}
+
+void BoundsOverlay::setSourceSize(const QSizeF &size)
+{
+    if (m_sourceSize == size)
+    {
+        return;
+    }
+    m_sourceSize = size;
+    update();
+    emit sourceSizeChanged();
+}
+
+bool BoundsOverlay::hitTestableOnly() const
+{
+    return m_hitTestableOnly;
+}
+
+void BoundsOverlay::setHitTestableOnly(bool hitTestableOnly)
+{
+    if (m_hitTestableOnly == hitTestableOnly)
+    {
+        return;
+    }
+    m_hitTestableOnly = hitTestableOnly;
+    rebuild();
+    emit hitTestableOnlyChanged();
+}
+
+void BoundsOverlay::setColor(const QColor &color)
+{
+    m_color = color;
+    m_rebuildPending = true;
+    update();
+    emit colorsChanged();
+}
+
+void BoundsOverlay::setHoverColor(const QColor &color)
+{
+    m_hoverColor = color;
+    recolor(m_hovered);
+    emit colorsChanged();
+}
+
+void BoundsOverlay::setSelectedColor(const QColor &color)
+{
+    m_selectedColor = color;
+    recolor(m_selected);
+    emit colorsChanged();
+}
+
+QModelIndex BoundsOverlay::hoveredIndex() const
+{
+    return m_model ? m_model->indexAt(m_hovered) : QModelIndex();
+}
+
+int BoundsOverlay::count() const
+{
+    return m_positions.size();
+}
+
+QSGNode *BoundsOverlay::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *transform = static_cast<QSGTransformNode *>(oldNode);
+    QSGGeometryNode *node = nullptr;
+    if (!transform)
+    {
+        transform = new QSGTransformNode;
+
+        auto *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawLines);
+        geometry->setLineWidth(1);
+        // Keeps the vertex buffer on the GPU between frames; it is only
+        // uploaded again when marked dirty below.
+        geometry->setVertexDataPattern(QSGGeometry::StaticPattern);
+
+        node = new QSGGeometryNode;
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGVertexColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+        transform->appendChildNode(node);
+
+        m_rebuildPending = true;
+    }
+    else
+    {
+        node = static_cast<QSGGeometryNode *>(transform->firstChild());
+    }
+
+    QMatrix4x4 matrix;
+    if (!m_sourceSize.isEmpty())
+    {
+        matrix.scale(width() / m_sourceSize.width(), height() / m_sourceSize.height());
+    }
+    transform->setMatrix(matrix);
+
+    QSGGeometry *geometry = node->geometry();
+    if (m_rebuildPending)
+    {
+        QAI_TRACE_SCOPE("overlay", "buildVertices");
+
+        geometry->allocate(m_positions.size() * OverlayBoxes::VerticesPerBox);
+        QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+        const QVector<QRect> &rects = m_model ? m_model->rects() : QVector<QRect>();
+        for (int slot = 0; slot < m_positions.size(); ++slot)
+        {
+            const int position = m_positions.at(slot);
+            OverlayBoxes::setBox(vertices + slot * OverlayBoxes::VerticesPerBox, rects.at(position));
+            OverlayBoxes::setBoxColor(vertices + slot * OverlayBoxes::VerticesPerBox, colorFor(position));
+        }
+        geometry->markVertexDataDirty();
+        node->markDirty(QSGNode::DirtyGeometry);
+    }
+    else if (!m_recolorPending.isEmpty())
+    {
+        QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+        for (int position : std::as_const(m_recolorPending))
+        {
+            const int slot = m_slots.value(position, -1);
+            if (slot >= 0)
+            {
+                OverlayBoxes::setBoxColor(vertices + slot * OverlayBoxes::VerticesPerBox, colorFor(position));
+            }
+        }
+        geometry->markVertexDataDirty();
+        node->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    m_rebuildPending = false;
+    m_recolorPending.clear();
+    return transform;
+}
+
+void BoundsOverlay::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+    {
+        update();
+    }
+}
+
+void BoundsOverlay::hoverMoveEvent(QHoverEvent *event)
+{
+    if (!m_model || m_sourceSize.isEmpty() || width() <= 0 || height() <= 0)
+    {
+        return;
+    }
+
+    const QPointF pos(event->position().x() * m_sourceSize.width() / width(),
+                      event->position().y() * m_sourceSize.height() / height());
+
+    // Later boxes are drawn on top, so the last one containing the point
+    // is the hovered one.
+    int hovered = -1;
+    const QVector<QRect> &rects = m_model->rects();
+    for (int slot = m_positions.size() - 1; slot >= 0; --slot)
+    {
+        const QRect &rect = rects.at(m_positions.at(slot));
+        if (pos.x() >= rect.x() && pos.x() <= rect.x() + rect.width() &&
+            pos.y() >= rect.y() && pos.y() <= rect.y() + rect.height())
+        {
+            hovered = m_positions.at(slot);
+            break;
+        }
+    }
+    setHovered(hovered);
+}
+
+void BoundsOverlay::hoverLeaveEvent(QHoverEvent *)
+{
+    setHovered(-1);
+}
+
+void BoundsOverlay::rebuild()
+{
+    QAI_TRACE_SCOPE("overlay", "rebuild");
+
+    m_positions.clear();
+    m_slots.clear();
+    m_hovered = -1;
+    m_selected = -1;
+
+    if (m_model)
+    {
+        const int nodeCount = m_model->nodeCount();
+        m_slots.fill(-1, nodeCount);
+        for (int position = 0; position < nodeCount; ++position)
+        {
+            const int flags = m_model->flagsAt(position);
+            if (m_hitTestableOnly)
+            {
+                // Same rules as MyTreeModel2::hitTest.
+                if (flags & MyTreeModel2::NodeDropArea)
+                {
+                    position += m_model->subtreeSizeAt(position);
+                    continue;
+                }
+                if (!(flags & MyTreeModel2::NodeHitTestable))
+                {
+                    continue;
+                }
+            }
+            else if (!(flags & MyTreeModel2::NodeVisible))
+            {
+                continue;
+            }
+            m_slots[position] = m_positions.size();
+            m_positions.append(position);
+        }
+        m_selected = m_model->positionOf(m_model->selectedIndex());
+    }
+
+    m_rebuildPending = true;
+    m_recolorPending.clear();
+    update();
+    emit countChanged();
+    emit hoveredIndexChanged();
+}
+
+void BoundsOverlay::updateSelection()
+{
+    const int selected = m_model ? m_model->positionOf(m_model->selectedIndex()) : -1;
+    if (selected == m_selected)
+    {
+        return;
+    }
+    const int previous = m_selected;
+    m_selected = selected;
+    recolor(previous);
+    recolor(selected);
+}
+
+void BoundsOverlay::setHovered(int position)
+{
+    if (m_hovered == position)
+    {
+        return;
+    }
+    const int previous = m_hovered;
+    m_hovered = position;
+    recolor(previous);
+    recolor(position);
+    emit hoveredIndexChanged();
+}
+
+void BoundsOverlay::recolor(int position)
+{
+    if (position < 0 || m_slots.value(position, -1) < 0)
+    {
+        return;
+    }
+    m_recolorPending.append(position);
+    update();
+}
+
+QColor BoundsOverlay::colorFor(int position) const
+{
+    if (position == m_selected)
+    {
+        return m_selectedColor;
+    }
+    if (position == m_hovered)
+    {
+        return m_hoverColor;
+    }
+    return m_color;
+}
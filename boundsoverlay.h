@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QColor>
+#include <QModelIndex>
+#include <QPointer>
+#include <QQuickItem>
+
+class MyTreeModel2;
+
+// Draws the bounding boxes of the tree model's nodes over the screenshot.
+// All boxes are line segments of one QSGGeometryNode in device coordinates,
+// scaled to the item by a transform node, so resizing never touches the
+// vertices and hover or selection changes only recolour the affected box.
+class BoundsOverlay : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(MyTreeModel2 *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(QSizeF sourceSize READ sourceSize WRITE setSourceSize NOTIFY sourceSizeChanged)
+    Q_PROPERTY(bool hitTestableOnly READ hitTestableOnly WRITE setHitTestableOnly NOTIFY hitTestableOnlyChanged)
+    Q_PROPERTY(QColor color MEMBER m_color WRITE setColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor hoverColor MEMBER m_hoverColor WRITE setHoverColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor selectedColor MEMBER m_selectedColor WRITE setSelectedColor NOTIFY colorsChanged)
+    Q_PROPERTY(QModelIndex hoveredIndex READ hoveredIndex NOTIFY hoveredIndexChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+public:
+    explicit BoundsOverlay(QQuickItem *parent = nullptr);
+
+    MyTreeModel2 *model() const;
+    void setModel(MyTreeModel2 *model);
+
+    // Size of the device screen the node geometry refers to.
+    QSizeF sourceSize() const;
+    void setSourceSize(const QSizeF &size);
+
+    // Only draw nodes searchByCoordinates can pick, instead of all of them.
+    bool hitTestableOnly() const;
+    void setHitTestableOnly(bool hitTestableOnly);
+
+    void setColor(const QColor &color);
+    void setHoverColor(const QColor &color);
+    void setSelectedColor(const QColor &color);
+
+    QModelIndex hoveredIndex() const;
+    int count() const;
+
+signals:
+    void modelChanged();
+    void sourceSizeChanged();
+    void hitTestableOnlyChanged();
+    void colorsChanged();
+    void hoveredIndexChanged();
+    void countChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void hoverMoveEvent(QHoverEvent *event) override;
+    void hoverLeaveEvent(QHoverEvent *event) override;
+
+private:
+    void rebuild();
+    void updateSelection();
+    void setHovered(int position);
+    void recolor(int position);
+    QColor colorFor(int position) const;
+
+    QPointer<MyTreeModel2> m_model;
+    QSizeF m_sourceSize;
+    bool m_hitTestableOnly = true;
+    QColor m_color = QColor(0x40, 0xa0, 0xff, 0x80);
+    QColor m_hoverColor = QColor(0xff, 0x80, 0x00);
+    QColor m_selectedColor = QColor(0xff, 0xde, 0x21);
+
+    // Node positions drawn, in pre-order, and the slot of every node
+    // position in that list (-1 when not drawn).
+    QVector<int> m_positions;
+    QVector<int> m_slots;
+    int m_hovered = -1;
+    int m_selected = -1;
+
+    // Pending scene graph work: a full vertex rebuild, or the positions
+    // whose box only needs a new colour.
+    bool m_rebuildPending = true;
+    QVector<int> m_recolorPending;
+};
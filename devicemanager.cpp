@@ -0,0 +1,392 @@
+#include "devicemanager.h"
+#include "mytreemodel2.h"
+#include "screenprovider.h"
+#include "socketconnector.h"
+#include "tracer.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+
+DeviceConnection::DeviceConnection(const QString &name, const QString &hostname, const QString &port,
+                                   const QString &applicationName, QObject *parent)
+    : QObject(parent)
+    , m_name(name)
+    , m_hostname(hostname)
+    , m_port(port)
+    , m_connector(new SocketConnector)
+    , m_model(new MyTreeModel2(this))
+{
+    m_connector->setProperty("hostname", hostname);
+    m_connector->setProperty("port", port);
+    m_connector->setProperty("applicationName", applicationName);
+    m_connector->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_connector, &QObject::deleteLater);
+
+    connect(m_connector, &SocketConnector::connectedChanged, this,
+            [this](bool connected)
+            {
+                if (m_connected == connected)
+                {
+                    return;
+                }
+                m_connected = connected;
+                emit connectedChanged(connected);
+            });
+
+    m_thread.setObjectName(QStringLiteral("Device %1:%2").arg(hostname, port));
+    m_thread.start();
+}
+
+DeviceConnection::~DeviceConnection()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+QString DeviceConnection::name() const
+{
+    return m_name;
+}
+
+QString DeviceConnection::hostname() const
+{
+    return m_hostname;
+}
+
+QString DeviceConnection::port() const
+{
+    return m_port;
+}
+
+bool DeviceConnection::isConnected() const
+{
+    return m_connected;
+}
+
+bool DeviceConnection::isBusy() const
+{
+    return m_pendingRequests > 0;
+}
+
+MyTreeModel2 *DeviceConnection::model() const
+{
+    return m_model;
+}
+
+QByteArray DeviceConnection::screenshot() const
+{
+    return m_screenshot;
+}
+
+// Runs fn on the connector thread. Requests are executed in the order they
+// are posted, one at a time, without blocking the GUI or other devices.
+template <typename Fn>
+void DeviceConnection::post(Fn &&fn)
+{
+    if (m_pendingRequests++ == 0)
+    {
+        emit busyChanged(true);
+    }
+    QMetaObject::invokeMethod(m_connector, std::forward<Fn>(fn), Qt::QueuedConnection);
+}
+
+void DeviceConnection::finishRequest()
+{
+    if (--m_pendingRequests == 0)
+    {
+        emit busyChanged(false);
+    }
+}
+
+void DeviceConnection::connectDevice()
+{
+    SocketConnector *connector = m_connector;
+    post([this, connector]()
+         {
+             connector->setConnected(true);
+             QMetaObject::invokeMethod(this, [this]() { finishRequest(); }, Qt::QueuedConnection);
+         });
+}
+
+void DeviceConnection::disconnectDevice()
+{
+    SocketConnector *connector = m_connector;
+    post([this, connector]()
+         {
+             connector->setConnected(false);
+             QMetaObject::invokeMethod(this, [this]() { finishRequest(); }, Qt::QueuedConnection);
+         });
+}
+
+void DeviceConnection::dump(const QString &filter)
+{
+    SocketConnector *connector = m_connector;
+    post([this, connector, filter]()
+         {
+             QAI_TRACE_SCOPE("device", "dump");
+
+             QElapsedTimer timer;
+             timer.start();
+
+             // Both the request and parsing stay off the GUI thread, only
+             // filling the model has to happen there.
+             QJsonObject root;
+             if (connector->isConnected())
+             {
+                 QJsonParseError error;
+                 const QJsonDocument doc = QJsonDocument::fromJson(connector->getDumpTree(filter).toUtf8(), &error);
+                 if (error.error == QJsonParseError::NoError)
+                 {
+                     root = doc.object();
+                 }
+                 else
+                 {
+                     qWarning() << Q_FUNC_INFO << m_hostname << error.errorString();
+                 }
+             }
+
+             const int elapsed = int(timer.elapsed());
+             QMetaObject::invokeMethod(
+                 this,
+                 [this, root, elapsed]()
+                 {
+                     if (!root.isEmpty())
+                     {
+                         m_model->fillModel(root);
+                         emit dumped(elapsed);
+                     }
+                     finishRequest();
+                 },
+                 Qt::QueuedConnection);
+         });
+}
+
+void DeviceConnection::grabWindow()
+{
+    SocketConnector *connector = m_connector;
+    post([this, connector]()
+         {
+             QAI_TRACE_SCOPE("device", "grabWindow");
+
+             const QByteArray data = connector->isConnected() ? connector->getGrabWindow() : QByteArray();
+             QMetaObject::invokeMethod(
+                 this,
+                 [this, data]()
+                 {
+                     if (!data.isEmpty())
+                     {
+                         m_screenshot = data;
+                         emit screenshotChanged();
+                     }
+                     finishRequest();
+                 },
+                 Qt::QueuedConnection);
+         });
+}
+
+DeviceManager::DeviceManager(ScreenshotStore *store, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_store(store)
+{
+}
+
+int DeviceManager::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+    {
+        return 0;
+    }
+    return m_devices.size();
+}
+
+QVariant DeviceManager::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_devices.size())
+    {
+        return {};
+    }
+
+    DeviceConnection *device = m_devices.at(index.row());
+    switch (role)
+    {
+    case NameRole:
+        return device->name();
+    case HostnameRole:
+        return device->hostname();
+    case PortRole:
+        return device->port();
+    case ConnectedRole:
+        return device->isConnected();
+    case BusyRole:
+        return device->isBusy();
+    case DeviceRole:
+        return QVariant::fromValue(device);
+    default:
+        return {};
+    }
+}
+
+QHash<int, QByteArray> DeviceManager::roleNames() const
+{
+    return {
+        { NameRole, "name" },
+        { HostnameRole, "hostname" },
+        { PortRole, "port" },
+        { ConnectedRole, "connected" },
+        { BusyRole, "busy" },
+        { DeviceRole, "device" },
+    };
+}
+
+int DeviceManager::currentIndex() const
+{
+    return m_currentIndex;
+}
+
+void DeviceManager::setCurrentIndex(int index)
+{
+    if (index < -1 || index >= m_devices.size() || index == m_currentIndex)
+    {
+        return;
+    }
+
+    m_currentIndex = index;
+    emit currentChanged();
+
+    // Switching only swaps the model and the cached screenshot, nothing is
+    // requested from the device. A device without one yet must not keep
+    // showing the screen of another.
+    DeviceConnection *device = current();
+    if (device && !device->screenshot().isEmpty())
+    {
+        m_store->setData(device->screenshot());
+    }
+    else
+    {
+        m_store->clear();
+    }
+}
+
+DeviceConnection *DeviceManager::current() const
+{
+    return m_currentIndex >= 0 ? m_devices.at(m_currentIndex) : nullptr;
+}
+
+MyTreeModel2 *DeviceManager::currentModel() const
+{
+    DeviceConnection *device = current();
+    return device ? device->model() : nullptr;
+}
+
+int DeviceManager::addDevice(const QString &hostname, const QString &port, const QString &name)
+{
+    for (int row = 0; row < m_devices.size(); ++row)
+    {
+        if (m_devices.at(row)->hostname() == hostname && m_devices.at(row)->port() == port)
+        {
+            return row;
+        }
+    }
+
+    const QString deviceName = name.isEmpty() ? QStringLiteral("%1:%2").arg(hostname, port) : name;
+    DeviceConnection *device = new DeviceConnection(deviceName, hostname, port, QStringLiteral("inspector"), this);
+
+    connect(device, &DeviceConnection::connectedChanged, this, [this, device]() { deviceChanged(device); });
+    connect(device, &DeviceConnection::busyChanged, this, [this, device]() { deviceChanged(device); });
+    connect(device, &DeviceConnection::screenshotChanged, this,
+            [this, device]()
+            {
+                if (device == current())
+                {
+                    m_store->setData(device->screenshot());
+                }
+            });
+
+    const int row = m_devices.size();
+    beginInsertRows(QModelIndex(), row, row);
+    m_devices.append(device);
+    endInsertRows();
+    emit countChanged();
+
+    return row;
+}
+
+void DeviceManager::removeDevice(int row)
+{
+    if (row < 0 || row >= m_devices.size())
+    {
+        return;
+    }
+
+    if (row == m_currentIndex)
+    {
+        setCurrentIndex(-1);
+    }
+
+    beginRemoveRows(QModelIndex(), row, row);
+    DeviceConnection *device = m_devices.takeAt(row);
+    endRemoveRows();
+
+    if (m_currentIndex > row)
+    {
+        --m_currentIndex;
+        emit currentChanged();
+    }
+    emit countChanged();
+
+    device->deleteLater();
+}
+
+DeviceConnection *DeviceManager::device(int row) const
+{
+    if (row < 0 || row >= m_devices.size())
+    {
+        return nullptr;
+    }
+    return m_devices.at(row);
+}
+
+void DeviceManager::connectAll()
+{
+    for (DeviceConnection *device : std::as_const(m_devices))
+    {
+        device->connectDevice();
+    }
+}
+
+void DeviceManager::disconnectAll()
+{
+    for (DeviceConnection *device : std::as_const(m_devices))
+    {
+        device->disconnectDevice();
+    }
+}
+
+void DeviceManager::dumpAll(const QString &filter)
+{
+    // Every device has its own connector thread, so the dumps run in parallel.
+    for (DeviceConnection *device : std::as_const(m_devices))
+    {
+        device->dump(filter);
+    }
+}
+
+void DeviceManager::grabAll()
+{
+    for (DeviceConnection *device : std::as_const(m_devices))
+    {
+        device->grabWindow();
+    }
+}
+
+void DeviceManager::deviceChanged(DeviceConnection *device)
+{
+    const int row = m_devices.indexOf(device);
+    if (row < 0)
+    {
+        return;
+    }
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, { ConnectedRole, BusyRole });
+}
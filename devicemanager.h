@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QThread>
+
+class MyTreeModel2;
+class ScreenshotStore;
+class SocketConnector;
+
+// One inspected device: a SocketConnector living on its own thread, whose
+// event queue serializes the requests sent to it, and a tree model owned by
+// the GUI thread.
+class DeviceConnection : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString name READ name CONSTANT)
+    Q_PROPERTY(QString hostname READ hostname CONSTANT)
+    Q_PROPERTY(QString port READ port CONSTANT)
+    Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged)
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+    Q_PROPERTY(MyTreeModel2 *model READ model CONSTANT)
+public:
+    DeviceConnection(const QString &name, const QString &hostname, const QString &port,
+                     const QString &applicationName, QObject *parent = nullptr);
+    ~DeviceConnection() override;
+
+    QString name() const;
+    QString hostname() const;
+    QString port() const;
+    bool isConnected() const;
+    bool isBusy() const;
+    MyTreeModel2 *model() const;
+    QByteArray screenshot() const;
+
+public slots:
+    void connectDevice();
+    void disconnectDevice();
+    void dump(const QString &filter);
+    void grabWindow();
+
+signals:
+    void connectedChanged(bool connected);
+    void busyChanged(bool busy);
+    void dumped(int elapsed);
+    void screenshotChanged();
+
+private:
+    template <typename Fn>
+    void post(Fn &&fn);
+    void finishRequest();
+
+    QString m_name;
+    QString m_hostname;
+    QString m_port;
+
+    QThread m_thread;
+    SocketConnector *m_connector {};
+    MyTreeModel2 *m_model {};
+
+    QByteArray m_screenshot;
+    bool m_connected = false;
+    int m_pendingRequests = 0;
+};
+
+class DeviceManager : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+    Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentChanged)
+    Q_PROPERTY(DeviceConnection *current READ current NOTIFY currentChanged)
+    Q_PROPERTY(MyTreeModel2 *currentModel READ currentModel NOTIFY currentChanged)
+public:
+    enum Roles {
+        NameRole = Qt::UserRole + 1,
+        HostnameRole,
+        PortRole,
+        ConnectedRole,
+        BusyRole,
+        DeviceRole,
+    };
+
+    explicit DeviceManager(ScreenshotStore *store, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+    DeviceConnection *current() const;
+    MyTreeModel2 *currentModel() const;
+
+    Q_INVOKABLE int addDevice(const QString &hostname, const QString &port, const QString &name = QString());
+    Q_INVOKABLE void removeDevice(int row);
+    Q_INVOKABLE DeviceConnection *device(int row) const;
+
+public slots:
+    void connectAll();
+    void disconnectAll();
+    void dumpAll(const QString &filter);
+    void grabAll();
+
+signals:
+    void countChanged();
+    void currentChanged();
+
+private:
+    void deviceChanged(DeviceConnection *device);
+
+    ScreenshotStore *m_store {};
+    QVector<DeviceConnection *> m_devices;
+    int m_currentIndex = -1;
+};
@@ -0,0 +1,248 @@
+#include "diffmodel.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QPointer>
+#include <QThreadPool>
+
+DiffModel::DiffModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int DiffModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !m_result)
+    {
+        return 0;
+    }
+    return m_result->changes.size();
+}
+
+QVariant DiffModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || !m_result || index.row() >= m_result->changes.size())
+    {
+        return QVariant();
+    }
+
+    const TreeDiff::Change &change = m_result->changes.at(index.row());
+    const TreeDiff::Tree &tree = change.left >= 0 ? m_result->left : m_result->right;
+    const int position = change.left >= 0 ? change.left : change.right;
+
+    switch (role)
+    {
+    case KindRole:
+        return TreeDiff::kindName(change.kind);
+    case ClassnameRole:
+        return tree.nodes.at(position).data.value(QLatin1String("classname")).toString();
+    case LabelRole:
+        return tree.label(position);
+    case LeftPathRole:
+        return change.left >= 0 ? m_result->left.path(change.left) : QString();
+    case RightPathRole:
+        return change.right >= 0 ? m_result->right.path(change.right) : QString();
+    case LeftRectRole:
+        return m_leftRects.at(index.row());
+    case RightRectRole:
+        return m_rightRects.at(index.row());
+    case PropertiesRole:
+    {
+        QVariantList properties;
+        for (const TreeDiff::PropertyChange &property : change.properties)
+        {
+            properties.append(QVariantMap {
+                { QStringLiteral("name"), property.name },
+                { QStringLiteral("left"), property.left.toVariant() },
+                { QStringLiteral("right"), property.right.toVariant() },
+            });
+        }
+        return properties;
+    }
+    case NodesRole:
+        return tree.nodes.at(position).subtreeSize + 1;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> DiffModel::roleNames() const
+{
+    return {
+        { KindRole, "kind" },
+        { ClassnameRole, "classname" },
+        { LabelRole, "label" },
+        { LeftPathRole, "leftPath" },
+        { RightPathRole, "rightPath" },
+        { LeftRectRole, "leftRect" },
+        { RightRectRole, "rightRect" },
+        { PropertiesRole, "properties" },
+        { NodesRole, "nodes" },
+    };
+}
+
+bool DiffModel::running() const
+{
+    return m_running;
+}
+
+QString DiffModel::leftLocation() const
+{
+    return m_leftLocation;
+}
+
+QString DiffModel::rightLocation() const
+{
+    return m_rightLocation;
+}
+
+QVariantMap DiffModel::summary() const
+{
+    return m_summary;
+}
+
+QString DiffModel::error() const
+{
+    return m_error;
+}
+
+void DiffModel::compare(const QString &left, const QString &right)
+{
+    const quint64 generation = ++m_generation;
+    if (!m_running)
+    {
+        m_running = true;
+        emit runningChanged();
+    }
+
+    // The model goes away with its window, possibly while the task runs. The
+    // result is posted to the application object and the pointer checked
+    // there, on the GUI thread, where the model is destroyed.
+    const QPointer<DiffModel> model(this);
+    QThreadPool::globalInstance()->start(
+        [model, generation, left, right]()
+        {
+            QAI_TRACE_SCOPE("diff", "compare");
+
+            QElapsedTimer timer;
+            timer.start();
+
+            QString error;
+            const QJsonObject leftDump = readDump(left, &error);
+            const QJsonObject rightDump = error.isEmpty() ? readDump(right, &error) : QJsonObject();
+            const qint64 parsed = timer.nsecsElapsed();
+
+            auto result = std::make_shared<TreeDiff::Result>(
+                error.isEmpty() ? TreeDiff::diff(leftDump, rightDump) : TreeDiff::Result());
+
+            QVector<QRect> leftRects;
+            QVector<QRect> rightRects;
+            leftRects.reserve(result->changes.size());
+            rightRects.reserve(result->changes.size());
+            for (const TreeDiff::Change &change : result->changes)
+            {
+                leftRects.append(change.left >= 0 ? result->left.rect(change.left) : QRect());
+                rightRects.append(change.right >= 0 ? result->right.rect(change.right) : QRect());
+            }
+
+            QVariantMap summary {
+                { QStringLiteral("identical"), result->identical },
+                { QStringLiteral("leftNodes"), result->left.nodes.size() },
+                { QStringLiteral("rightNodes"), result->right.nodes.size() },
+                { QStringLiteral("parseElapsed"), parsed / 1e6 },
+                { QStringLiteral("diffElapsed"), (timer.nsecsElapsed() - parsed) / 1e6 },
+            };
+            for (const TreeDiff::Change &change : result->changes)
+            {
+                const QString kind = TreeDiff::kindName(change.kind);
+                summary.insert(kind, summary.value(kind).toInt() + 1);
+            }
+
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [model, generation, left, right, result, leftRects, rightRects, summary, error]()
+                {
+                    if (!model || generation != model->m_generation)
+                    {
+                        return;
+                    }
+
+                    model->beginResetModel();
+                    model->m_result = result;
+                    model->m_leftRects = leftRects;
+                    model->m_rightRects = rightRects;
+                    model->m_leftLocation = left;
+                    model->m_rightLocation = right;
+                    model->m_summary = summary;
+                    model->m_error = error;
+                    model->endResetModel();
+
+                    model->m_running = false;
+                    emit model->runningChanged();
+                    emit model->finished();
+                },
+                Qt::QueuedConnection);
+        });
+}
+
+void DiffModel::clear()
+{
+    ++m_generation;
+
+    beginResetModel();
+    m_result.reset();
+    m_leftRects.clear();
+    m_rightRects.clear();
+    m_leftLocation.clear();
+    m_rightLocation.clear();
+    m_summary.clear();
+    m_error.clear();
+    endResetModel();
+
+    if (m_running)
+    {
+        m_running = false;
+        emit runningChanged();
+    }
+    emit finished();
+}
+
+const QVector<QRect> &DiffModel::rects(Side side) const
+{
+    return side == Left ? m_leftRects : m_rightRects;
+}
+
+TreeDiff::Kind DiffModel::kindAt(int row) const
+{
+    return m_result ? m_result->changes.at(row).kind : TreeDiff::Kind::Changed;
+}
+
+QJsonObject DiffModel::readDump(const QString &location, QString *error)
+{
+    const QString fileName = QFileInfo(location).isDir()
+        ? location + QStringLiteral("/dump.json")
+        : location;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        *error = QStringLiteral("Failed to open %1").arg(fileName);
+        qWarning() << Q_FUNC_INFO << *error;
+        return QJsonObject();
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+    {
+        *error = QStringLiteral("Invalid dump %1: %2").arg(fileName, parseError.errorString());
+        qWarning() << Q_FUNC_INFO << *error;
+        return QJsonObject();
+    }
+    return doc.object();
+}
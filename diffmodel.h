@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QRect>
+#include <QVariantMap>
+
+#include <memory>
+
+#include "treediff.h"
+
+// Side-by-side view of a TreeDiff between two recordings. Dumps are read,
+// flattened and compared on the thread pool; each row is one added, removed,
+// changed or moved node with its rect on both screenshots.
+class DiffModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(QString leftLocation READ leftLocation NOTIFY finished)
+    Q_PROPERTY(QString rightLocation READ rightLocation NOTIFY finished)
+    Q_PROPERTY(QVariantMap summary READ summary NOTIFY finished)
+    Q_PROPERTY(QString error READ error NOTIFY finished)
+public:
+    enum Roles
+    {
+        KindRole = Qt::UserRole + 1,
+        ClassnameRole,
+        LabelRole,
+        LeftPathRole,
+        RightPathRole,
+        LeftRectRole,
+        RightRectRole,
+        PropertiesRole,
+        NodesRole,
+    };
+
+    enum Side
+    {
+        Left,
+        Right,
+    };
+    Q_ENUM(Side)
+
+    explicit DiffModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    bool running() const;
+    QString leftLocation() const;
+    QString rightLocation() const;
+    QVariantMap summary() const;
+    QString error() const;
+
+    // Locations are recording directories holding dump.json, or dump files.
+    Q_INVOKABLE void compare(const QString &left, const QString &right);
+    Q_INVOKABLE void clear();
+
+    static QJsonObject readDump(const QString &location, QString *error);
+
+    // Columns indexed by row, for overlays that draw every change at once:
+    // the rect of each change on one side, empty when its node is not on
+    // that side, and its kind.
+    const QVector<QRect> &rects(Side side) const;
+    TreeDiff::Kind kindAt(int row) const;
+
+signals:
+    void runningChanged();
+    void finished();
+
+private:
+    std::shared_ptr<const TreeDiff::Result> m_result;
+    QVector<QRect> m_leftRects;
+    QVector<QRect> m_rightRects;
+    QString m_leftLocation;
+    QString m_rightLocation;
+    QVariantMap m_summary;
+    QString m_error;
+    quint64 m_generation = 0;
+    bool m_running = false;
+};
@@ -0,0 +1,271 @@
+#include "diffoverlay.h"
+#include "overlayboxes.h"
+#include "tracer.h"
+
+#include <QMatrix4x4>
+#include <QSGGeometryNode>
+#include <QSGTransformNode>
+#include <QSGVertexColorMaterial>
+
+DiffOverlay::DiffOverlay(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents);
+}
+
+DiffModel *DiffOverlay::model() const
+{
+    return m_model;
+}
+
+void DiffOverlay::setModel(DiffModel *model)
+{
+    if (m_model == model)
+    {
+        return;
+    }
+
+    if (m_model)
+    {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model)
+    {
+        connect(m_model, &QAbstractItemModel::modelReset, this, &DiffOverlay::rebuild);
+    }
+
+    rebuild();
+    emit modelChanged();
+}
+
+DiffModel::Side DiffOverlay::side() const
+{
+    return m_side;
+}
+
+void DiffOverlay::setSide(DiffModel::Side side)
+{
+    if (m_side == side)
+    {
+        return;
+    }
+    m_side = side;
+    rebuild();
+    emit sideChanged();
+}
+
+QSizeF DiffOverlay::sourceSize() const
+{
+    return m_sourceSize;
+}
+
+void DiffOverlay::setSourceSize(const QSizeF &size)
+{
+    if (m_sourceSize == size)
+    {
+        return;
+    }
+    m_sourceSize = size;
+    update();
+    emit sourceSizeChanged();
+}
+
+int DiffOverlay::currentRow() const
+{
+    return m_currentRow;
+}
+
+void DiffOverlay::setCurrentRow(int row)
+{
+    if (m_currentRow == row)
+    {
+        return;
+    }
+    const int previous = m_currentRow;
+    m_currentRow = row;
+    recolor(previous);
+    recolor(row);
+    emit currentRowChanged();
+}
+
+void DiffOverlay::setAddedColor(const QColor &color)
+{
+    m_addedColor = color;
+    m_rebuildPending = true;
+    update();
+    emit colorsChanged();
+}
+
+void DiffOverlay::setRemovedColor(const QColor &color)
+{
+    m_removedColor = color;
+    m_rebuildPending = true;
+    update();
+    emit colorsChanged();
+}
+
+void DiffOverlay::setChangedColor(const QColor &color)
+{
+    m_changedColor = color;
+    m_rebuildPending = true;
+    update();
+    emit colorsChanged();
+}
+
+void DiffOverlay::setMovedColor(const QColor &color)
+{
+    m_movedColor = color;
+    m_rebuildPending = true;
+    update();
+    emit colorsChanged();
+}
+
+void DiffOverlay::setCurrentColor(const QColor &color)
+{
+    m_currentColor = color;
+    recolor(m_currentRow);
+    emit colorsChanged();
+}
+
+int DiffOverlay::count() const
+{
+    return m_rows.size();
+}
+
+QSGNode *DiffOverlay::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *transform = static_cast<QSGTransformNode *>(oldNode);
+    QSGGeometryNode *node = nullptr;
+    if (!transform)
+    {
+        transform = new QSGTransformNode;
+
+        auto *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawLines);
+        geometry->setLineWidth(1);
+        geometry->setVertexDataPattern(QSGGeometry::StaticPattern);
+
+        node = new QSGGeometryNode;
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGVertexColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+        transform->appendChildNode(node);
+
+        m_rebuildPending = true;
+    }
+    else
+    {
+        node = static_cast<QSGGeometryNode *>(transform->firstChild());
+    }
+
+    QMatrix4x4 matrix;
+    if (!m_sourceSize.isEmpty())
+    {
+        matrix.scale(width() / m_sourceSize.width(), height() / m_sourceSize.height());
+    }
+    transform->setMatrix(matrix);
+
+    QSGGeometry *geometry = node->geometry();
+    if (m_rebuildPending)
+    {
+        QAI_TRACE_SCOPE("diff", "buildVertices");
+
+        geometry->allocate(m_rows.size() * OverlayBoxes::VerticesPerBox);
+        QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+        const QVector<QRect> &rects = m_model ? m_model->rects(m_side) : QVector<QRect>();
+        for (int slot = 0; slot < m_rows.size(); ++slot)
+        {
+            const int row = m_rows.at(slot);
+            OverlayBoxes::setBox(vertices + slot * OverlayBoxes::VerticesPerBox, rects.at(row));
+            OverlayBoxes::setBoxColor(vertices + slot * OverlayBoxes::VerticesPerBox, colorFor(row));
+        }
+        geometry->markVertexDataDirty();
+        node->markDirty(QSGNode::DirtyGeometry);
+    }
+    else if (!m_recolorPending.isEmpty())
+    {
+        QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
+        for (int row : std::as_const(m_recolorPending))
+        {
+            const int slot = m_slots.value(row, -1);
+            if (slot >= 0)
+            {
+                OverlayBoxes::setBoxColor(vertices + slot * OverlayBoxes::VerticesPerBox, colorFor(row));
+            }
+        }
+        geometry->markVertexDataDirty();
+        node->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    m_rebuildPending = false;
+    m_recolorPending.clear();
+    return transform;
+}
+
+void DiffOverlay::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+    {
+        update();
+    }
+}
+
+void DiffOverlay::rebuild()
+{
+    m_rows.clear();
+    m_slots.clear();
+
+    if (m_model)
+    {
+        // Nodes missing on this side have an empty rect and are not drawn.
+        const QVector<QRect> &rects = m_model->rects(m_side);
+        m_slots.fill(-1, rects.size());
+        for (int row = 0; row < rects.size(); ++row)
+        {
+            if (!rects.at(row).isEmpty())
+            {
+                m_slots[row] = m_rows.size();
+                m_rows.append(row);
+            }
+        }
+    }
+
+    m_rebuildPending = true;
+    m_recolorPending.clear();
+    update();
+    emit countChanged();
+}
+
+void DiffOverlay::recolor(int row)
+{
+    if (row < 0 || m_slots.value(row, -1) < 0)
+    {
+        return;
+    }
+    m_recolorPending.append(row);
+    update();
+}
+
+QColor DiffOverlay::colorFor(int row) const
+{
+    if (row == m_currentRow)
+    {
+        return m_currentColor;
+    }
+
+    switch (m_model ? m_model->kindAt(row) : TreeDiff::Kind::Changed)
+    {
+    case TreeDiff::Kind::Added:
+        return m_addedColor;
+    case TreeDiff::Kind::Removed:
+        return m_removedColor;
+    case TreeDiff::Kind::Moved:
+        return m_movedColor;
+    case TreeDiff::Kind::Changed:
+        break;
+    }
+    return m_changedColor;
+}
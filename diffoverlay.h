@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QColor>
+#include <QPointer>
+#include <QQuickItem>
+
+#include "diffmodel.h"
+
+// Draws the rects of all changes of a DiffModel over one side's screenshot.
+// Like BoundsOverlay, the boxes are line segments of one QSGGeometryNode in
+// device coordinates under a transform node; a change of the current row
+// only recolours the previous and the new current box.
+class DiffOverlay : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(DiffModel *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(DiffModel::Side side READ side WRITE setSide NOTIFY sideChanged)
+    Q_PROPERTY(QSizeF sourceSize READ sourceSize WRITE setSourceSize NOTIFY sourceSizeChanged)
+    Q_PROPERTY(int currentRow READ currentRow WRITE setCurrentRow NOTIFY currentRowChanged)
+    Q_PROPERTY(QColor addedColor MEMBER m_addedColor WRITE setAddedColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor removedColor MEMBER m_removedColor WRITE setRemovedColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor changedColor MEMBER m_changedColor WRITE setChangedColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor movedColor MEMBER m_movedColor WRITE setMovedColor NOTIFY colorsChanged)
+    Q_PROPERTY(QColor currentColor MEMBER m_currentColor WRITE setCurrentColor NOTIFY colorsChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+public:
+    explicit DiffOverlay(QQuickItem *parent = nullptr);
+
+    DiffModel *model() const;
+    void setModel(DiffModel *model);
+
+    DiffModel::Side side() const;
+    void setSide(DiffModel::Side side);
+
+    // Size of the screenshot the change rects refer to.
+    QSizeF sourceSize() const;
+    void setSourceSize(const QSizeF &size);
+
+    int currentRow() const;
+    void setCurrentRow(int row);
+
+    void setAddedColor(const QColor &color);
+    void setRemovedColor(const QColor &color);
+    void setChangedColor(const QColor &color);
+    void setMovedColor(const QColor &color);
+    void setCurrentColor(const QColor &color);
+
+    int count() const;
+
+signals:
+    void modelChanged();
+    void sideChanged();
+    void sourceSizeChanged();
+    void currentRowChanged();
+    void colorsChanged();
+    void countChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private:
+    void rebuild();
+    void recolor(int row);
+    QColor colorFor(int row) const;
+
+    QPointer<DiffModel> m_model;
+    DiffModel::Side m_side = DiffModel::Left;
+    QSizeF m_sourceSize;
+    int m_currentRow = -1;
+    QColor m_addedColor = QColor(0x2d, 0xa4, 0x4e);
+    QColor m_removedColor = QColor(0xcf, 0x22, 0x2e);
+    QColor m_changedColor = QColor(0xd4, 0xa7, 0x2c);
+    QColor m_movedColor = QColor(0x09, 0x69, 0xda);
+    QColor m_currentColor = QColor(0xff, 0xde, 0x21);
+
+    // Rows drawn, those with a rect on this side, and the slot of every row
+    // in that list (-1 when not drawn).
+    QVector<int> m_rows;
+    QVector<int> m_slots;
+
+    // Pending scene graph work: a full vertex rebuild, or the rows whose
+    // box only needs a new colour.
+    bool m_rebuildPending = true;
+    QVector<int> m_recolorPending;
+};
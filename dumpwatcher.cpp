@@ -0,0 +1,406 @@
+#include "dumpwatcher.h"
+#include "mytreemodel2.h"
+#include "screenprovider.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <utility>
+
+namespace {
+
+// Nodes of right whose own properties differ from left, skipping subtrees
+// with equal hashes. False when the trees are not shaped alike, in which
+// case positions of the two trees do not correspond.
+bool changedNodes(const TreeDiff::Tree &left, const TreeDiff::Tree &right, QVector<QPair<int, QJsonObject>> *changed)
+{
+    if (left.nodes.size() != right.nodes.size())
+    {
+        return false;
+    }
+
+    for (int position = 0; position < right.nodes.size();)
+    {
+        const TreeDiff::Tree::Node &a = left.nodes.at(position);
+        const TreeDiff::Tree::Node &b = right.nodes.at(position);
+        if (a.parent != b.parent || a.subtreeSize != b.subtreeSize)
+        {
+            return false;
+        }
+        if (a.subtreeHash == b.subtreeHash)
+        {
+            position += b.subtreeSize + 1;
+            continue;
+        }
+        if (a.hash != b.hash)
+        {
+            changed->append({position, b.data});
+        }
+        ++position;
+    }
+    return true;
+}
+
+} // namespace
+
+DumpWatcher::DumpWatcher(SocketConnector *connector, ScreenshotStore *store, QObject *parent)
+    : QObject(parent)
+    , m_connector(connector)
+    , m_store(store)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &DumpWatcher::poll);
+    connect(m_connector, &SocketConnector::connectedChanged, this,
+            [this](bool connected)
+            {
+                forget();
+                m_screenshotDigest = 0;
+                m_screenshotFormat.clear();
+                if (!connected)
+                {
+                    setRunning(false);
+                }
+            });
+    // The analyze stream takes over the connection.
+    connect(m_connector, &SocketConnector::analyzingChanged, this,
+            [this](bool analyzing)
+            {
+                if (analyzing)
+                {
+                    setRunning(false);
+                }
+            });
+}
+
+bool DumpWatcher::isRunning() const
+{
+    return m_running;
+}
+
+void DumpWatcher::setRunning(bool running)
+{
+    if (m_running == running || (running && m_connector->isAnalyzing()))
+    {
+        return;
+    }
+
+    // Replies and parse results of an earlier run are dropped by generation;
+    // replies still on their way are not even decoded.
+    ++m_generation;
+    for (quint64 id : std::as_const(m_requests))
+    {
+        m_connector->cancelRequest(id);
+    }
+    m_requests.clear();
+    m_outstanding = 0;
+    m_running = running;
+    if (m_running)
+    {
+        m_interval = m_minInterval;
+        m_timer->start(0);
+    }
+    else
+    {
+        m_timer->stop();
+    }
+    emit runningChanged();
+    emit statsChanged();
+}
+
+MyTreeModel2 *DumpWatcher::model() const
+{
+    return m_model;
+}
+
+void DumpWatcher::setModel(MyTreeModel2 *model)
+{
+    if (m_model == model)
+    {
+        return;
+    }
+
+    if (m_model)
+    {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model)
+    {
+        connect(m_model, &QAbstractItemModel::modelReset, this, &DumpWatcher::onModelReset);
+    }
+
+    forget();
+    emit modelChanged();
+}
+
+int DumpWatcher::interval() const
+{
+    return m_interval;
+}
+
+int DumpWatcher::polls() const
+{
+    return m_polls;
+}
+
+int DumpWatcher::skipped() const
+{
+    return m_skipped;
+}
+
+int DumpWatcher::patched() const
+{
+    return m_patched;
+}
+
+int DumpWatcher::reloaded() const
+{
+    return m_reloaded;
+}
+
+bool DumpWatcher::isApplying() const
+{
+    return m_applying;
+}
+
+void DumpWatcher::resetStats()
+{
+    m_polls = 0;
+    m_skipped = 0;
+    m_patched = 0;
+    m_reloaded = 0;
+    emit statsChanged();
+}
+
+void DumpWatcher::poll()
+{
+    if (!m_running || m_outstanding > 0)
+    {
+        return;
+    }
+    if (!m_connector->isConnected() || !m_model)
+    {
+        setRunning(false);
+        return;
+    }
+
+    const quint64 generation = m_generation;
+    m_outstanding = 1;
+    m_cycleChanged = false;
+    ++m_polls;
+
+    m_requests.clear();
+    m_requests.append(m_connector->sendRequest(
+        SocketConnector::dumpTreeRequest(m_filter),
+        [this, generation](const SocketConnector::Reply &reply)
+        {
+            if (generation == m_generation)
+            {
+                onDump(reply);
+            }
+        },
+        m_dumpDigest));
+
+    if (m_screenshots && m_store)
+    {
+        ++m_outstanding;
+        const QJsonObject request = m_connector->liveScreenshotRequest();
+        m_requestedFormat = m_connector->screenshotFormat();
+        m_requests.append(m_connector->sendRequest(
+            request,
+            [this, generation](const SocketConnector::Reply &reply)
+            {
+                if (generation == m_generation)
+                {
+                    onScreenshot(reply);
+                }
+            },
+            m_screenshotDigest));
+    }
+}
+
+void DumpWatcher::onModelReset()
+{
+    // Someone else loaded the model, so neither the digest nor the tree
+    // describe what it shows any more.
+    if (!m_applying)
+    {
+        forget();
+    }
+}
+
+void DumpWatcher::onDump(const SocketConnector::Reply &reply)
+{
+    if (reply.status() != 0)
+    {
+        qWarning() << Q_FUNC_INFO << "Dump request failed:" << reply.object.value(QStringLiteral("value"));
+        replyDone(false);
+        return;
+    }
+    if (reply.unchanged)
+    {
+        ++m_skipped;
+        replyDone(false);
+        return;
+    }
+
+    const quint64 generation = m_generation;
+    const TreePtr previous = m_tree;
+    // The watcher is destroyed at exit before the pool finishes, so the
+    // result goes to the application object and the pointer is checked on
+    // the GUI thread.
+    const QPointer<DumpWatcher> watcher(this);
+    QThreadPool::globalInstance()->start(
+        [watcher, generation, reply, previous]()
+        {
+            QAI_TRACE_SCOPE("watcher", "parse");
+
+            QJsonParseError error;
+            const QJsonObject root = QJsonDocument::fromJson(SocketConnector::decodeDump(reply), &error).object();
+            if (error.error != QJsonParseError::NoError)
+            {
+                qWarning() << Q_FUNC_INFO << "Failed to parse dump:" << error.errorString();
+            }
+
+            auto tree = std::make_shared<const TreeDiff::Tree>(TreeDiff::Tree::fromJson(root));
+            QVector<QPair<int, QJsonObject>> changed;
+            const bool reset = !previous || !changedNodes(*previous, *tree, &changed);
+
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [watcher, generation, digest = reply.digest, root, tree, changed, reset]()
+                {
+                    if (watcher)
+                    {
+                        watcher->apply(generation, digest, root, tree, changed, reset);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+}
+
+void DumpWatcher::onScreenshot(const SocketConnector::Reply &reply)
+{
+    if (reply.status() != 0)
+    {
+        qWarning() << Q_FUNC_INFO << "Screenshot request failed:" << reply.object.value(QStringLiteral("value"));
+        replyDone(false);
+        return;
+    }
+    if (reply.unchanged)
+    {
+        ++m_skipped;
+        replyDone(false);
+        return;
+    }
+
+    // A frame in another format than the last one, like the tiers' periodic
+    // probe, never matches the digest. It is shown, but does not count as a
+    // change of the screen.
+    const QString format = ScreenshotTiers::replyFormat(reply.object);
+    const bool sameFormat = format == m_screenshotFormat;
+    m_screenshotFormat = format;
+
+    m_screenshotDigest = reply.digest;
+    m_store->setData(SocketConnector::decodeScreenshot(reply));
+    replyDone(sameFormat);
+}
+
+void DumpWatcher::requestLosslessScreenshot()
+{
+    if (!m_screenshots || !m_store || m_requestedFormat == QLatin1String("png"))
+    {
+        return;
+    }
+
+    const quint64 generation = m_generation;
+    ++m_outstanding;
+    m_requests.append(m_connector->sendRequest(
+        m_connector->losslessScreenshotRequest(),
+        [this, generation](const SocketConnector::Reply &reply)
+        {
+            if (generation != m_generation)
+            {
+                return;
+            }
+            // Only shown until the next live frame; the history keeps it.
+            if (reply.status() == 0)
+            {
+                m_store->setData(SocketConnector::decodeScreenshot(reply));
+            }
+            replyDone(false);
+        }));
+}
+
+void DumpWatcher::apply(quint64 generation, size_t digest, const QJsonObject &root, const TreePtr &tree,
+                        const QVector<QPair<int, QJsonObject>> &changed, bool reset)
+{
+    if (generation != m_generation)
+    {
+        return;
+    }
+    if (!m_model || root.isEmpty())
+    {
+        replyDone(false);
+        return;
+    }
+
+    QAI_TRACE_SCOPE("watcher", "apply");
+
+    m_dumpDigest = digest;
+    m_tree = tree;
+
+    if (reset)
+    {
+        m_applying = true;
+        m_model->fillModel(root);
+        m_applying = false;
+        ++m_reloaded;
+        emit updated(true, tree->nodes.size());
+        emit treeApplied(tree);
+    }
+    else if (!changed.isEmpty())
+    {
+        m_applying = true;
+        m_model->updateNodes(changed);
+        m_applying = false;
+        ++m_patched;
+        emit updated(false, changed.size());
+        emit treeApplied(tree);
+    }
+    // Otherwise the bytes differed but the tree did not, e.g. property order.
+    if (reset || !changed.isEmpty())
+    {
+        requestLosslessScreenshot();
+    }
+    replyDone(reset || !changed.isEmpty());
+}
+
+void DumpWatcher::replyDone(bool changed)
+{
+    m_cycleChanged = m_cycleChanged || changed;
+    if (--m_outstanding > 0)
+    {
+        return;
+    }
+
+    m_interval = m_cycleChanged ? m_minInterval : qMin(m_maxInterval, qMax(m_minInterval, m_interval * 3 / 2));
+    emit statsChanged();
+
+    if (m_running)
+    {
+        m_timer->start(m_interval);
+    }
+}
+
+void DumpWatcher::forget()
+{
+    m_dumpDigest = 0;
+    m_tree.reset();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+
+#include <memory>
+
+#include "socketconnector.h"
+#include "treediff.h"
+
+class MyTreeModel2;
+class QTimer;
+class ScreenshotStore;
+
+// Refreshes the dump and the screenshot while running. Replies are hashed
+// as received and compared with the digest of the previous one, so an
+// unchanged payload still crosses the wire but is dropped before it is
+// decompressed or parsed. Changed dumps are compared
+// by subtree hash against the previous one: when only properties changed
+// the affected nodes are patched in place, otherwise the model is refilled.
+// The poll interval grows by half towards maxInterval while nothing changes
+// and falls back to minInterval on the first change.
+//
+// Live screenshots come in whatever tier the connector picks. When the dump
+// changed and the frame was not PNG, a lossless one is fetched as well, so
+// the snapshot history has one to keep.
+class DumpWatcher : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning WRITE setRunning NOTIFY runningChanged)
+    Q_PROPERTY(MyTreeModel2 *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(QString filter MEMBER m_filter NOTIFY filterChanged)
+    Q_PROPERTY(bool screenshots MEMBER m_screenshots NOTIFY screenshotsChanged)
+    Q_PROPERTY(int minInterval MEMBER m_minInterval NOTIFY intervalsChanged)
+    Q_PROPERTY(int maxInterval MEMBER m_maxInterval NOTIFY intervalsChanged)
+    Q_PROPERTY(int interval READ interval NOTIFY statsChanged)
+    Q_PROPERTY(int polls READ polls NOTIFY statsChanged)
+    Q_PROPERTY(int skipped READ skipped NOTIFY statsChanged)
+    Q_PROPERTY(int patched READ patched NOTIFY statsChanged)
+    Q_PROPERTY(int reloaded READ reloaded NOTIFY statsChanged)
+public:
+    DumpWatcher(SocketConnector *connector, ScreenshotStore *store, QObject *parent = nullptr);
+
+    bool isRunning() const;
+    void setRunning(bool running);
+
+    MyTreeModel2 *model() const;
+    void setModel(MyTreeModel2 *model);
+
+    int interval() const;
+    int polls() const;
+    // Replies of either kind dropped because their digest was unchanged.
+    int skipped() const;
+    int patched() const;
+    int reloaded() const;
+
+    // While the model is refilled or patched from a poll.
+    bool isApplying() const;
+
+public slots:
+    void resetStats();
+
+signals:
+    void runningChanged();
+    void modelChanged();
+    void filterChanged();
+    void screenshotsChanged();
+    void intervalsChanged();
+    void statsChanged();
+    // The model was refilled or patched; reset tells which.
+    void updated(bool reset, int nodes);
+    // The tree the model shows after an update, hashed off the GUI thread.
+    void treeApplied(const std::shared_ptr<const TreeDiff::Tree> &tree);
+
+private slots:
+    void poll();
+    void onModelReset();
+
+private:
+    using TreePtr = std::shared_ptr<const TreeDiff::Tree>;
+
+    void onDump(const SocketConnector::Reply &reply);
+    void onScreenshot(const SocketConnector::Reply &reply);
+    void requestLosslessScreenshot();
+    void apply(quint64 generation, size_t digest, const QJsonObject &root, const TreePtr &tree,
+               const QVector<QPair<int, QJsonObject>> &changed, bool reset);
+    void replyDone(bool changed);
+    void forget();
+
+    SocketConnector *m_connector {};
+    ScreenshotStore *m_store {};
+    QPointer<MyTreeModel2> m_model;
+    QTimer *m_timer {};
+
+    bool m_running = false;
+    QString m_filter;
+    bool m_screenshots = true;
+    int m_minInterval = 250;
+    int m_maxInterval = 4000;
+    int m_interval = 250;
+
+    size_t m_dumpDigest = 0;
+    size_t m_screenshotDigest = 0;
+    QString m_screenshotFormat;
+    // Format the screenshot of the current poll was asked for in.
+    QString m_requestedFormat;
+    TreePtr m_tree;
+    quint64 m_generation = 0;
+    bool m_applying = false;
+
+    int m_outstanding = 0;
+    QVector<quint64> m_requests;
+    bool m_cycleChanged = false;
+
+    int m_polls = 0;
+    int m_skipped = 0;
+    int m_patched = 0;
+    int m_reloaded = 0;
+};
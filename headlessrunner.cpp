@@ -0,0 +1,326 @@
+#include "headlessrunner.h"
+#include "diffmodel.h"
+#include "mytreemodel2.h"
+#include "selector.h"
+#include "socketconnector.h"
+#include "tracer.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QTextStream>
+
+namespace {
+
+QJsonObject error(const QString &message)
+{
+    return QJsonObject {
+        { QStringLiteral("status"), 1 },
+        { QStringLiteral("error"), message },
+    };
+}
+
+QJsonObject success(const QJsonValue &value)
+{
+    return QJsonObject {
+        { QStringLiteral("status"), 0 },
+        { QStringLiteral("value"), value },
+    };
+}
+
+// Query values are given as JSON scalars when they parse as one, so that
+// "visible true" or "width 540" compare against the dumped types.
+QVariant parseValue(const QString &text)
+{
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(QByteArray("[") + text.toUtf8() + "]", &parseError);
+    if (parseError.error == QJsonParseError::NoError && doc.array().size() == 1)
+    {
+        return doc.array().at(0).toVariant();
+    }
+    return text;
+}
+
+bool writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
+} // namespace
+
+HeadlessRunner::HeadlessRunner(SocketConnector *connector, MyTreeModel2 *model, const QString &filter)
+    : m_connector(connector)
+    , m_model(model)
+    , m_filter(filter)
+{
+}
+
+int HeadlessRunner::run(const QStringList &commands)
+{
+    QTextStream out(stdout);
+    int exitCode = 0;
+
+    auto process = [&](const QString &line)
+    {
+        const QStringList args = QProcess::splitCommand(line);
+        if (args.isEmpty())
+        {
+            return true;
+        }
+        if (args.first() == QLatin1String("quit"))
+        {
+            return false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QJsonObject reply = execute(args);
+        reply.insert(QStringLiteral("cmd"), args.first());
+        reply.insert(QStringLiteral("elapsed"), timer.nsecsElapsed() / 1e6);
+        if (reply.value(QStringLiteral("status")).toInt() != 0)
+        {
+            exitCode = 1;
+        }
+
+        out << QJsonDocument(reply).toJson(QJsonDocument::Compact) << '\n';
+        out.flush();
+        return true;
+    };
+
+    if (!commands.isEmpty())
+    {
+        for (const QString &command : commands)
+        {
+            if (!process(command))
+            {
+                break;
+            }
+        }
+        return exitCode;
+    }
+
+    QTextStream in(stdin);
+    QString line;
+    while (in.readLineInto(&line))
+    {
+        if (!process(line))
+        {
+            break;
+        }
+    }
+    return exitCode;
+}
+
+QString HeadlessRunner::usage()
+{
+    return QStringLiteral(
+        "Commands:\n"
+        "  dump [file]             fetch the tree, print it or save it to file\n"
+        "  screenshot [file]       save a PNG screenshot, screenshot.png by default\n"
+        "  find <key> <value>      elements whose property equals value\n"
+        "  contains <key> <text>   elements whose property contains text\n"
+        "  hit <x> <y>             topmost element at the coordinates\n"
+        "  query <selector>        elements matching a selector, e.g.\n"
+        "                          'ListView[objectName=feed] QQuickText[visible=1]'\n"
+        "  diff <left> <right>     structural diff of two recordings or dump files\n"
+        "  quit                    stop reading commands\n");
+}
+
+QJsonObject HeadlessRunner::execute(const QStringList &args)
+{
+    const QString &command = args.first();
+    if (command == QLatin1String("dump"))
+    {
+        return dump(args);
+    }
+    if (command == QLatin1String("screenshot"))
+    {
+        return screenshot(args);
+    }
+    if (command == QLatin1String("find"))
+    {
+        return find(args, false);
+    }
+    if (command == QLatin1String("contains"))
+    {
+        return find(args, true);
+    }
+    if (command == QLatin1String("hit"))
+    {
+        return hit(args);
+    }
+    if (command == QLatin1String("query"))
+    {
+        return query(args);
+    }
+    if (command == QLatin1String("diff"))
+    {
+        return diff(args);
+    }
+    return error(QStringLiteral("Unknown command: %1").arg(command));
+}
+
+QJsonObject HeadlessRunner::dump(const QStringList &args)
+{
+    QAI_TRACE_SCOPE("headless", "dump");
+
+    const QString dump = m_connector->getDumpTree(m_filter);
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(dump.toUtf8(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+    {
+        return error(QStringLiteral("Invalid dump: %1").arg(parseError.errorString()));
+    }
+
+    m_model->fillModel(doc.object());
+    m_hasDump = true;
+
+    if (args.size() > 1)
+    {
+        if (!writeFile(args.at(1), dump.toUtf8()))
+        {
+            return error(QStringLiteral("Failed to write %1").arg(args.at(1)));
+        }
+        return success(args.at(1));
+    }
+    return success(doc.object());
+}
+
+QJsonObject HeadlessRunner::screenshot(const QStringList &args)
+{
+    QAI_TRACE_SCOPE("headless", "screenshot");
+
+    const QString fileName = args.size() > 1 ? args.at(1) : QStringLiteral("screenshot.png");
+    const QByteArray data = m_connector->getGrabWindow();
+    if (data.isEmpty())
+    {
+        return error(QStringLiteral("Empty screenshot"));
+    }
+    if (!writeFile(fileName, data))
+    {
+        return error(QStringLiteral("Failed to write %1").arg(fileName));
+    }
+    return success(fileName);
+}
+
+QJsonObject HeadlessRunner::find(const QStringList &args, bool partial)
+{
+    QAI_TRACE_SCOPE("headless", "find");
+
+    if (args.size() < 3)
+    {
+        return error(QStringLiteral("Usage: %1 <key> <value>").arg(args.first()));
+    }
+    if (!ensureDump())
+    {
+        return error(QStringLiteral("No dump available"));
+    }
+
+    const QString &key = args.at(1);
+    const QVariant value = partial ? QVariant(args.at(2)) : parseValue(args.at(2));
+
+    QJsonArray matches;
+    const int count = m_model->nodeCount();
+    for (int position = 0; position < count; ++position)
+    {
+        const QJsonObject item = m_model->itemAt(position)->data();
+        const QVariant property = item.value(key).toVariant();
+        const bool match = partial
+            ? property.toString().contains(value.toString())
+            : property == value;
+        if (match)
+        {
+            matches.append(item);
+        }
+    }
+    return success(matches);
+}
+
+QJsonObject HeadlessRunner::hit(const QStringList &args)
+{
+    QAI_TRACE_SCOPE("headless", "hit");
+
+    bool xOk = false;
+    bool yOk = false;
+    const qreal x = args.value(1).toDouble(&xOk);
+    const qreal y = args.value(2).toDouble(&yOk);
+    if (!xOk || !yOk)
+    {
+        return error(QStringLiteral("Usage: hit <x> <y>"));
+    }
+    if (!ensureDump())
+    {
+        return error(QStringLiteral("No dump available"));
+    }
+
+    const QModelIndex index = m_model->searchByCoordinates(x, y);
+    if (!index.isValid())
+    {
+        return success(QJsonValue::Null);
+    }
+    return success(m_model->getData(index));
+}
+
+QJsonObject HeadlessRunner::query(const QStringList &args)
+{
+    QAI_TRACE_SCOPE("headless", "query");
+
+    if (args.size() < 2)
+    {
+        return error(QStringLiteral("Usage: query <selector>"));
+    }
+
+    QString message;
+    const Selector selector = Selector::compile(args.mid(1).join(QLatin1Char(' ')), &message);
+    if (!selector.isValid())
+    {
+        return error(message);
+    }
+    if (!ensureDump())
+    {
+        return error(QStringLiteral("No dump available"));
+    }
+
+    QJsonArray matches;
+    for (int position : selector.evaluate(m_model))
+    {
+        matches.append(m_model->itemAt(position)->data());
+    }
+    return success(matches);
+}
+
+QJsonObject HeadlessRunner::diff(const QStringList &args)
+{
+    QAI_TRACE_SCOPE("headless", "diff");
+
+    if (args.size() < 3)
+    {
+        return error(QStringLiteral("Usage: diff <left> <right>"));
+    }
+
+    QString message;
+    const QJsonObject left = DiffModel::readDump(args.at(1), &message);
+    const QJsonObject right = message.isEmpty() ? DiffModel::readDump(args.at(2), &message) : QJsonObject();
+    if (!message.isEmpty())
+    {
+        return error(message);
+    }
+    return success(TreeDiff::toJson(TreeDiff::diff(left, right)));
+}
+
+bool HeadlessRunner::ensureDump()
+{
+    if (!m_hasDump)
+    {
+        dump({QStringLiteral("dump")});
+    }
+    return m_hasDump;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QStringList>
+
+class MyTreeModel2;
+class QTextStream;
+class SocketConnector;
+
+// Batch front end used by --headless. Every command produces exactly one
+// JSON line on stdout shaped like a device reply:
+//   {"cmd":"find","status":0,"elapsed":0.42,"value":[...]}
+// Queries run against the last dump, which is only fetched again by "dump".
+class HeadlessRunner
+{
+public:
+    HeadlessRunner(SocketConnector *connector, MyTreeModel2 *model, const QString &filter);
+
+    // Runs the given commands, or commands read line by line from stdin
+    // when the list is empty. Returns the process exit code.
+    int run(const QStringList &commands);
+
+    static QString usage();
+
+private:
+    QJsonObject execute(const QStringList &args);
+
+    QJsonObject dump(const QStringList &args);
+    QJsonObject screenshot(const QStringList &args);
+    QJsonObject find(const QStringList &args, bool partial);
+    QJsonObject hit(const QStringList &args);
+    QJsonObject query(const QStringList &args);
+    QJsonObject diff(const QStringList &args);
+
+    bool ensureDump();
+
+    SocketConnector *m_connector {};
+    MyTreeModel2 *m_model {};
+    QString m_filter;
+    bool m_hasDump = false;
+};
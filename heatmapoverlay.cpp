@@ -0,0 +1,348 @@
+#include "heatmapoverlay.h"
+#include "tapstatistics.h"
+#include "tracer.h"
+
+#include <QColor>
+#include <QDebug>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+
+#ifdef QAINSPECTOR_HAVE_RHI
+#include <QSGDynamicTexture>
+#include <rhi/qrhi.h>
+#endif
+
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// Beyond this many recoloured cells per frame one upload of the whole image
+// is cheaper.
+const int s_maxDirtyCells = 1024;
+
+// The image is RGBA8888, which maps onto an RGBA8 texture as is.
+void setPixel(QImage *image, int column, int row, QRgb color)
+{
+    uchar *pixel = image->scanLine(row) + column * 4;
+    pixel[0] = uchar(qRed(color));
+    pixel[1] = uchar(qGreen(color));
+    pixel[2] = uchar(qBlue(color));
+    pixel[3] = uchar(qAlpha(color));
+}
+
+quint32 nextPowerOfTwo(quint32 value)
+{
+    quint32 power = 1;
+    while (power < value && power < (1u << 31))
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+#ifdef QAINSPECTOR_HAVE_RHI
+
+// One texture for the lifetime of the node. A new image is uploaded whole,
+// a recoloured cell as a single texel; both are queued here on the render
+// thread during sync and recorded when the material is prepared.
+class HeatmapTexture : public QSGDynamicTexture
+{
+public:
+    ~HeatmapTexture() override
+    {
+        if (m_texture)
+        {
+            m_texture->deleteLater();
+        }
+    }
+
+    void setImage(const QImage &image)
+    {
+        m_image = image;
+        m_size = image.size();
+        m_texels.clear();
+    }
+
+    void setTexel(const QPoint &position, const QImage &image)
+    {
+        const uchar *pixel = image.constScanLine(position.y()) + position.x() * 4;
+        m_texels.append({position, {pixel[0], pixel[1], pixel[2], pixel[3]}});
+    }
+
+    qint64 comparisonKey() const override
+    {
+        return qint64(quintptr(this));
+    }
+
+    QRhiTexture *rhiTexture() const override
+    {
+        return m_texture;
+    }
+
+    QSize textureSize() const override
+    {
+        return m_size;
+    }
+
+    bool hasAlphaChannel() const override
+    {
+        return true;
+    }
+
+    bool hasMipmaps() const override
+    {
+        return false;
+    }
+
+    bool updateTexture() override
+    {
+        return false;
+    }
+
+    void commitTextureOperations(QRhi *rhi, QRhiResourceUpdateBatch *updates) override
+    {
+        if (!m_image.isNull())
+        {
+            if (!m_texture || m_texture->pixelSize() != m_size)
+            {
+                if (m_texture)
+                {
+                    m_texture->deleteLater();
+                }
+                m_texture = rhi->newTexture(QRhiTexture::RGBA8, m_size);
+                if (!m_texture->create())
+                {
+                    qWarning() << Q_FUNC_INFO << "Failed to create texture of" << m_size;
+                    delete std::exchange(m_texture, nullptr);
+                    return;
+                }
+            }
+            updates->uploadTexture(m_texture, m_image);
+            // Let the overlay write its image without detaching a copy.
+            m_image = QImage();
+        }
+
+        if (m_texels.isEmpty() || !m_texture)
+        {
+            return;
+        }
+
+        QVarLengthArray<QRhiTextureUploadEntry, 16> entries;
+        for (const Texel &texel : std::as_const(m_texels))
+        {
+            QRhiTextureSubresourceUploadDescription description(texel.rgba, sizeof(texel.rgba));
+            description.setSourceSize(QSize(1, 1));
+            description.setDestinationTopLeft(texel.position);
+            entries.append(QRhiTextureUploadEntry(0, 0, description));
+        }
+        QRhiTextureUploadDescription upload;
+        upload.setEntries(entries.cbegin(), entries.cend());
+        updates->uploadTexture(m_texture, upload);
+        m_texels.clear();
+    }
+
+private:
+    struct Texel
+    {
+        QPoint position;
+        uchar rgba[4];
+    };
+
+    QRhiTexture *m_texture {};
+    QSize m_size;
+    QImage m_image;
+    QVector<Texel> m_texels;
+};
+
+#endif
+
+} // namespace
+
+HeatmapOverlay::HeatmapOverlay(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents);
+}
+
+TapStatistics *HeatmapOverlay::statistics() const
+{
+    return m_statistics;
+}
+
+void HeatmapOverlay::setStatistics(TapStatistics *statistics)
+{
+    if (m_statistics == statistics)
+    {
+        return;
+    }
+
+    if (m_statistics)
+    {
+        disconnect(m_statistics, nullptr, this, nullptr);
+    }
+    m_statistics = statistics;
+    if (m_statistics)
+    {
+        connect(m_statistics, &TapStatistics::gridReset, this, &HeatmapOverlay::rebuild);
+        connect(m_statistics, &TapStatistics::cellChanged, this, &HeatmapOverlay::updateCell);
+    }
+
+    rebuild();
+    emit statisticsChanged();
+}
+
+QSizeF HeatmapOverlay::sourceSize() const
+{
+    return m_sourceSize;
+}
+
+void HeatmapOverlay::setSourceSize(const QSizeF &size)
+{
+    if (m_sourceSize == size)
+    {
+        return;
+    }
+    m_sourceSize = size;
+    update();
+    emit sourceSizeChanged();
+}
+
+QSGNode *HeatmapOverlay::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *node = static_cast<QSGSimpleTextureNode *>(oldNode);
+    if (m_image.isNull() || !m_statistics)
+    {
+        delete node;
+        return nullptr;
+    }
+
+    if (!node)
+    {
+        node = new QSGSimpleTextureNode;
+        node->setOwnsTexture(true);
+        node->setFiltering(QSGTexture::Linear);
+#ifdef QAINSPECTOR_HAVE_RHI
+        node->setTexture(new HeatmapTexture);
+#endif
+        m_textureDirty = true;
+    }
+
+#ifdef QAINSPECTOR_HAVE_RHI
+    auto *texture = static_cast<HeatmapTexture *>(node->texture());
+    if (m_textureDirty)
+    {
+        QAI_TRACE_SCOPE("heatmap", "upload");
+        texture->setImage(m_image);
+        node->markDirty(QSGNode::DirtyMaterial);
+        m_textureDirty = false;
+    }
+    if (!m_dirtyCells.isEmpty())
+    {
+        const int width = m_image.width();
+        for (int index : std::as_const(m_dirtyCells))
+        {
+            texture->setTexel(QPoint(index % width, index / width), m_image);
+        }
+        node->markDirty(QSGNode::DirtyMaterial);
+    }
+#else
+    if (m_textureDirty || !m_dirtyCells.isEmpty())
+    {
+        QAI_TRACE_SCOPE("heatmap", "upload");
+        node->setTexture(window()->createTextureFromImage(m_image));
+        m_textureDirty = false;
+    }
+#endif
+    m_dirtyCells.clear();
+
+    // The grid covers whole cells of device pixels, so it may reach past
+    // the screen's right and bottom edges.
+    const QSizeF grid = QSizeF(m_image.size()) * m_statistics->cellSize();
+    const QSizeF source = m_sourceSize.isEmpty() ? grid : m_sourceSize;
+    node->setRect(0, 0, grid.width() * width() / source.width(), grid.height() * height() / source.height());
+    return node;
+}
+
+void HeatmapOverlay::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+    {
+        update();
+    }
+}
+
+void HeatmapOverlay::rebuild()
+{
+    QAI_TRACE_SCOPE("heatmap", "rebuild");
+
+    const QSize size = m_statistics ? m_statistics->gridSize() : QSize();
+    if (size.isEmpty())
+    {
+        m_image = QImage();
+        update();
+        return;
+    }
+
+    m_scale = nextPowerOfTwo(quint32(qMax(1, m_statistics->maxCount())));
+    if (m_image.size() != size)
+    {
+        m_image = QImage(size, QImage::Format_RGBA8888_Premultiplied);
+    }
+
+    const QVector<quint32> &cells = m_statistics->cells();
+    for (int row = 0; row < size.height(); ++row)
+    {
+        for (int column = 0; column < size.width(); ++column)
+        {
+            setPixel(&m_image, column, row, colorFor(cells.at(row * size.width() + column)));
+        }
+    }
+
+    m_textureDirty = true;
+    m_dirtyCells.clear();
+    update();
+}
+
+void HeatmapOverlay::updateCell(int index)
+{
+    if (!m_statistics || m_image.isNull())
+    {
+        return;
+    }
+
+    const quint32 count = m_statistics->cells().value(index);
+    if (count > m_scale)
+    {
+        rebuild();
+        return;
+    }
+
+    const int width = m_image.width();
+    setPixel(&m_image, index % width, index / width, colorFor(count));
+    if (!m_textureDirty)
+    {
+        m_dirtyCells.append(index);
+        if (m_dirtyCells.size() > s_maxDirtyCells)
+        {
+            m_textureDirty = true;
+            m_dirtyCells.clear();
+        }
+    }
+    update();
+}
+
+QRgb HeatmapOverlay::colorFor(quint32 count) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // Logarithmic, so a few hot spots do not wash out everything else; from
+    // a faint blue for single taps to an opaque red at the scale.
+    const double t = std::log2(1.0 + count) / std::log2(1.0 + m_scale);
+    const QColor color = QColor::fromHsvF(float((1.0 - t) * 2.0 / 3.0), 1.0f, 1.0f, float(0.25 + 0.6 * t));
+    return qPremultiply(color.rgba());
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QImage>
+#include <QPointer>
+#include <QQuickItem>
+
+class TapStatistics;
+
+// Draws TapStatistics' grid over the screenshot as one texture with a pixel
+// per cell, stretched to the item and filtered linearly. A new tap recolours
+// a single pixel and, where QRhi is available, only that texel is uploaded
+// with the next frame; otherwise the texture is replaced. The whole image is
+// only recoloured and uploaded when the grid is reset or the highest count
+// passes the next power of two, which the colour scale is normalised to.
+class HeatmapOverlay : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(TapStatistics *statistics READ statistics WRITE setStatistics NOTIFY statisticsChanged)
+    Q_PROPERTY(QSizeF sourceSize READ sourceSize WRITE setSourceSize NOTIFY sourceSizeChanged)
+public:
+    explicit HeatmapOverlay(QQuickItem *parent = nullptr);
+
+    TapStatistics *statistics() const;
+    void setStatistics(TapStatistics *statistics);
+
+    // Size of the device screen the tap coordinates refer to.
+    QSizeF sourceSize() const;
+    void setSourceSize(const QSizeF &size);
+
+signals:
+    void statisticsChanged();
+    void sourceSizeChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private:
+    void rebuild();
+    void updateCell(int index);
+    QRgb colorFor(quint32 count) const;
+
+    QPointer<TapStatistics> m_statistics;
+    QSizeF m_sourceSize;
+
+    QImage m_image;
+    quint32 m_scale = 1;
+    bool m_textureDirty = true;
+    // Cells recoloured since the last frame, while the texture is current.
+    QVector<int> m_dirtyCells;
+};
@@ -1,24 +1,138 @@
+#include <QCommandLineParser>
 #include <QGuiApplication>
+#include <QLoggingCategory>
 #include <QQmlApplicationEngine>
+#include <QQuickWindow>
 
+#include "boundsoverlay.h"
+#include "devicemanager.h"
+#include "diffmodel.h"
+#include "diffoverlay.h"
+#include "dumpwatcher.h"
+#include "headlessrunner.h"
+#include "heatmapoverlay.h"
 #include "socketconnector.h"
 #include "mytreemodel2.h"
+#include "propertylistmodel.h"
+#include "replayengine.h"
+#include "screenmirror.h"
+#include "screenprovider.h"
+#include "selectormodel.h"
+#include "snapshothistory.h"
+#include "startupprofile.h"
+#include "tapstatistics.h"
+#include "tracer.h"
+
+namespace {
+
+bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (qstrcmp(argv[i], "--headless") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs without a GUI application or QML engine: connect, execute commands
+// from the command line or stdin, print one JSON line per command.
+int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("qainspector");
+    app.setOrganizationName("coderus");
+    app.setOrganizationDomain("org.coderus");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Headless qainspector.\n\n") + HeadlessRunner::usage());
+    parser.addHelpOption();
+    parser.addOptions({
+        {"headless", "Run without GUI."},
+        {{"H", "host"}, "Host to connect to.", "host", "127.0.0.1"},
+        {{"p", "port"}, "Port to connect to.", "port", "8888"},
+        {"filter", "Dump filter JSON.", "json", ""},
+        {{"c", "command"}, "Command to run, may be repeated. Commands are read from stdin otherwise.", "command"},
+        {"verbose", "Keep debug output on stderr."},
+    });
+    parser.process(app);
+
+    if (!parser.isSet("verbose"))
+    {
+        QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+    }
+
+    SocketConnector connector;
+    connector.setProperty("hostname", parser.value("host"));
+    connector.setProperty("port", parser.value("port"));
+    connector.setProperty("applicationName", "inspector");
+    connector.setConnected(true);
+
+    if (!connector.isConnected())
+    {
+        qWarning() << "Failed to connect to" << parser.value("host") << parser.value("port");
+        return 2;
+    }
+
+    MyTreeModel2 model;
+    HeadlessRunner runner(&connector, &model, parser.value("filter"));
+    const int exitCode = runner.run(parser.values("command"));
+
+    connector.setConnected(false);
+    return exitCode;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
+    if (isHeadless(argc, argv))
+    {
+        return runHeadless(argc, argv);
+    }
+
+    QScopedPointer<StartupProfile> startup(new StartupProfile);
+
     QGuiApplication app(argc, argv);
     app.setApplicationName("qainspector");
     app.setOrganizationName("coderus");
     app.setOrganizationDomain("org.coderus");
+    startup->mark("application");
 
     QScopedPointer<SocketConnector> connector(new SocketConnector);
     connector->setProperty("applicationName", "inspector");
+    QScopedPointer<ScreenshotStore> screenshot(new ScreenshotStore);
+    QScopedPointer<ScreenMirror> mirror(new ScreenMirror(connector.get(), screenshot.get()));
+    QScopedPointer<ReplayEngine> replay(new ReplayEngine(connector.get()));
+    QScopedPointer<DeviceManager> devices(new DeviceManager(screenshot.get()));
+    QScopedPointer<DumpWatcher> watcher(new DumpWatcher(connector.get(), screenshot.get()));
+    QScopedPointer<SnapshotHistory> history(new SnapshotHistory(screenshot.get(), watcher.get()));
+    QScopedPointer<TapStatistics> taps(new TapStatistics(connector->manager()));
     qmlRegisterUncreatableType<AnalyzeManager>("org.qaengine.qainspector", 1, 0, "AnalyzeManager", "AnalyzeManager");
     qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "SocketConnector", connector.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "Tracer", Tracer::instance());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "ScreenMirror", mirror.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "ScreenshotStore", screenshot.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "ReplayEngine", replay.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "DeviceManager", devices.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "StartupProfile", startup.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "DumpWatcher", watcher.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "SnapshotHistory", history.get());
+    qmlRegisterSingletonInstance("org.qaengine.qainspector", 1, 0, "TapStatistics", taps.get());
+    qmlRegisterUncreatableType<DeviceConnection>("org.qaengine.qainspector", 1, 0, "DeviceConnection", "DeviceConnection");
 
     qmlRegisterType<MyTreeModel2>("org.qaengine.qainspector", 1, 0, "TreeModel");
+    qmlRegisterType<BoundsOverlay>("org.qaengine.qainspector", 1, 0, "BoundsOverlay");
+    qmlRegisterType<DiffModel>("org.qaengine.qainspector", 1, 0, "DiffModel");
+    qmlRegisterType<DiffOverlay>("org.qaengine.qainspector", 1, 0, "DiffOverlay");
+    qmlRegisterType<SelectorModel>("org.qaengine.qainspector", 1, 0, "SelectorModel");
+    qmlRegisterType<PropertyListModel>("org.qaengine.qainspector", 1, 0, "PropertyListModel");
+    qmlRegisterType<HeatmapOverlay>("org.qaengine.qainspector", 1, 0, "HeatmapOverlay");
 
     QQmlApplicationEngine engine;
+    engine.addImageProvider(QStringLiteral("screen"), new ScreenProvider(screenshot.get()));
     QObject::connect(
         &engine,
         &QQmlApplicationEngine::objectCreationFailed,
@@ -26,6 +140,8 @@ int main(int argc, char *argv[])
         []() { QCoreApplication::exit(-1); },
         Qt::QueuedConnection);
     engine.loadFromModule("qainspector-qt6", "Main");
+    startup->mark("qml");
+    startup->watch(qobject_cast<QQuickWindow *>(engine.rootObjects().value(0)));
 
     return app.exec();
 }
@@ -1,5 +1,7 @@
 // Copyright (c) 2019-2020 Open Mobile Platform LLC.
 #include "mytreemodel2.h"
+#include "parallelfor.h"
+#include "tracer.h"
 
 #include <QDebug>
 #include <QJsonArray>
@@ -8,9 +10,65 @@
 #include <QClipboard>
 #include <QFile>
 #include <QGuiApplication>
+#include <QThreadPool>
 
 #include <QJsonValue>
 
+namespace {
+
+bool flagValue(const QJsonObject &data, QLatin1String key)
+{
+    const QJsonValue value = data.value(key);
+    return value.isUndefined() ? true : value.toVariant().toBool();
+}
+
+int nodeFlags(const QJsonObject &data)
+{
+    const QJsonValue opacity = data.value(QLatin1String("opacity"));
+    const bool visible = flagValue(data, QLatin1String("active")) &&
+        flagValue(data, QLatin1String("visible")) &&
+        flagValue(data, QLatin1String("enabled")) &&
+        (opacity.isUndefined() || opacity.toVariant().toFloat() != 0.0f);
+    if (!visible)
+    {
+        return 0;
+    }
+
+    const QString classname = data.value(QLatin1String("classname")).toString();
+    if (classname.endsWith(QLatin1String("DropArea")))
+    {
+        return MyTreeModel2::NodeVisible | MyTreeModel2::NodeDropArea;
+    }
+
+    const bool hitTestable =
+        !classname.endsWith(QLatin1String("Loader")) &&
+        classname != QLatin1String("DeclarativeTouchBlocker") &&
+        classname != QLatin1String("QQuickItem") &&
+        classname != QLatin1String("RotatingItem") &&
+        classname != QLatin1String("QQuickShaderEffect") &&
+        classname != QLatin1String("QQuickOverlay") &&
+        classname != QLatin1String("QQuickRectangle") &&
+        classname != QLatin1String("QQuickMouseArea") &&
+        classname != QLatin1String("InformationManager") &&
+        classname != QLatin1String("QQuickShaderEffectSource") &&
+        classname != QLatin1String("HwcImage") &&
+        !classname.endsWith(QLatin1String("Gradient")) &&
+        !classname.endsWith(QLatin1String("Effect"));
+
+    return hitTestable ? MyTreeModel2::NodeVisible | MyTreeModel2::NodeHitTestable
+                       : MyTreeModel2::NodeVisible;
+}
+
+QRect nodeRect(const QJsonObject &data)
+{
+    return QRect(data.value(QLatin1String("abs_x")).toVariant().toInt(),
+                 data.value(QLatin1String("abs_y")).toVariant().toInt(),
+                 data.value(QLatin1String("width")).toVariant().toInt(),
+                 data.value(QLatin1String("height")).toVariant().toInt());
+}
+
+} // namespace
+
 MyTreeModel2::MyTreeModel2(QObject* parent)
     : QAbstractItemModel(parent)
 {
@@ -42,8 +100,15 @@ MyTreeModel2::MyTreeModel2(QObject* parent)
 
 void MyTreeModel2::fillModel(const QJsonObject& object)
 {
+    QAI_TRACE_SCOPE("model", "fillModel");
     beginResetModel();
 
+    const bool hadSelection = m_selectedItem;
+    m_selectedItem = nullptr;
+    m_nodes.clear();
+    m_rects.clear();
+    m_classIds.clear();
+    m_propertyColumns.clear();
     m_rootItem->genocide();
 
     QJsonObject data = object;
@@ -52,13 +117,131 @@ void MyTreeModel2::fillModel(const QJsonObject& object)
     TreeItem2* firstItem = new TreeItem2(data, m_rootItem);
     m_rootItem->appendChild(firstItem);
 
-    QList<TreeItem2*> childs = processChilds(childsData, firstItem);
-    for (TreeItem2* child : childs)
+    if (m_buildThreshold > 0 && QThreadPool::globalInstance()->maxThreadCount() > 1)
     {
-        firstItem->appendChild(child);
+        QAI_TRACE_SCOPE("model", "buildParallel");
+
+        QVector<BuildTask> tasks;
+        splitChilds(childsData, firstItem, &tasks);
+        parallelFor(tasks.size(),
+                    [this, &tasks](int i)
+                    {
+                        QAI_TRACE_SCOPE("model", "buildSubtree");
+                        const BuildTask& task = tasks.at(i);
+                        for (TreeItem2* child : processChilds(task.data, task.item))
+                        {
+                            task.item->appendChild(child);
+                        }
+                    });
     }
+    else
+    {
+        QAI_TRACE_SCOPE("model", "processChilds");
+        for (TreeItem2* child : processChilds(childsData, firstItem))
+        {
+            firstItem->appendChild(child);
+        }
+    }
+
+    rebuildNodes();
 
     endResetModel();
+    emit nodeCountChanged();
+    if (hadSelection)
+    {
+        emit selectedIndexChanged();
+    }
+}
+
+void MyTreeModel2::rebuildNodes()
+{
+    QAI_TRACE_SCOPE("model", "rebuildNodes");
+
+    m_nodes.clear();
+
+    // Iterative pre-order walk; subtree sizes are known once the walk has
+    // left a node, which is when the next sibling or an ancestor's sibling
+    // is reached.
+    struct Entry
+    {
+        TreeItem2 *item;
+        int parent;
+        int depth;
+    };
+    QVector<Entry> stack;
+    for (int i = m_rootItem->childCount() - 1; i >= 0; --i)
+    {
+        stack.append({m_rootItem->child(i), -1, 0});
+    }
+
+    while (!stack.isEmpty())
+    {
+        const Entry entry = stack.takeLast();
+        const int position = m_nodes.size();
+        entry.item->setPosition(position);
+        m_nodes.append({entry.item, entry.parent, entry.depth, 0});
+
+        for (int i = entry.item->childCount() - 1; i >= 0; --i)
+        {
+            stack.append({entry.item->child(i), position, entry.depth + 1});
+        }
+    }
+
+    // Children follow their parent, so a reverse pass accumulates sizes.
+    // The same pass fills the geometry column.
+    m_rects.resize(m_nodes.size());
+    for (int position = m_nodes.size() - 1; position >= 0; --position)
+    {
+        const FlatNode &node = m_nodes.at(position);
+        updateNodeColumns(position, node.item->data());
+        if (node.parent >= 0)
+        {
+            m_nodes[node.parent].subtreeSize += node.subtreeSize + 1;
+        }
+    }
+}
+
+void MyTreeModel2::updateNodeColumns(int position, const QJsonObject& data)
+{
+    FlatNode &node = m_nodes[position];
+    node.flags = nodeFlags(data);
+    m_rects[position] = nodeRect(data);
+
+    const QString classname = data.value(QLatin1String("classname")).toString();
+    auto classId = m_classIds.constFind(classname);
+    if (classId == m_classIds.constEnd())
+    {
+        classId = m_classIds.insert(classname, m_classIds.size());
+    }
+    node.classId = classId.value();
+}
+
+void MyTreeModel2::updateNodes(const QVector<QPair<int, QJsonObject>>& nodes)
+{
+    QAI_TRACE_SCOPE("model", "updateNodes");
+
+    if (nodes.isEmpty())
+    {
+        return;
+    }
+    m_propertyColumns.clear();
+
+    for (const auto &[position, data] : nodes)
+    {
+        TreeItem2* item = itemAt(position);
+        if (!item)
+        {
+            qWarning() << Q_FUNC_INFO << "No node at" << position;
+            continue;
+        }
+
+        item->setData(data);
+        updateNodeColumns(position, data);
+
+        const int row = item->row();
+        emit dataChanged(createIndex(row, 0, item), createIndex(row, columnCount() - 1, item), {Qt::DisplayRole});
+    }
+    emit nodesUpdated();
 }
 
 void MyTreeModel2::loadDump(const QString& dump)
@@ -66,7 +249,11 @@ void MyTreeModel2::loadDump(const QString& dump)
     qDebug() << Q_FUNC_INFO << dump.length();
 
     QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(dump.toUtf8(), &error);
+    QJsonDocument doc;
+    {
+        QAI_TRACE_SCOPE("model", "parse");
+        doc = QJsonDocument::fromJson(dump.toUtf8(), &error);
+    }
     if (error.error == QJsonParseError::NoError)
     {
         fillModel(doc.object());
@@ -94,6 +281,53 @@ void MyTreeModel2::loadFile(const QString &location)
     loadDump(data);
 }
 
+int MyTreeModel2::buildThreshold() const
+{
+    return m_buildThreshold;
+}
+
+void MyTreeModel2::setBuildThreshold(int threshold)
+{
+    if (m_buildThreshold == threshold)
+    {
+        return;
+    }
+    m_buildThreshold = threshold;
+    emit buildThresholdChanged();
+}
+
+void MyTreeModel2::splitChilds(const QJsonArray& data, TreeItem2* parentItem, QVector<BuildTask>* tasks) const
+{
+    // Children are created here, in order, so only their subtrees are built
+    // concurrently and the result is the same as processChilds'.
+    for (const QJsonValue& value : data)
+    {
+        QJsonObject childData = value.toObject();
+        const QJsonArray childsData = childData.take(QStringLiteral("children")).toArray();
+        TreeItem2* child = new TreeItem2(childData, parentItem);
+        parentItem->appendChild(child);
+
+        if (countNodes(childsData, m_buildThreshold) >= m_buildThreshold)
+        {
+            splitChilds(childsData, child, tasks);
+        }
+        else if (!childsData.isEmpty())
+        {
+            tasks->append({childsData, child});
+        }
+    }
+}
+
+int MyTreeModel2::countNodes(const QJsonArray& data, int limit)
+{
+    int count = data.size();
+    for (int i = 0; i < data.size() && count < limit; ++i)
+    {
+        count += countNodes(data.at(i).toObject().value(QLatin1String("children")).toArray(), limit - count);
+    }
+    return count;
+}
+
 QList<TreeItem2*> MyTreeModel2::processChilds(const QJsonArray& data, TreeItem2* parentItem)
 {
     QList<TreeItem2*> childs;
@@ -117,6 +351,12 @@ QVariant MyTreeModel2::data(const QModelIndex& index, int role) const
     if (!index.isValid())
         return QVariant();
 
+    if (role == SelectedCellRole)
+        return m_selectedItem == index.internalPointer() && m_selectedColumn == index.column();
+
+    if (role == SameItemRole)
+        return m_selectedItem == index.internalPointer();
+
     if (role != Qt::DisplayRole)
         return QVariant();
 
@@ -230,6 +470,63 @@ int MyTreeModel2::columnCount(const QModelIndex& parent) const
     return m_headers.count();
 }
 
+QHash<int, QByteArray> MyTreeModel2::roleNames() const
+{
+    return {
+        { Qt::DisplayRole, "display" },
+        { SelectedCellRole, "selectedCell" },
+        { SameItemRole, "sameItem" },
+    };
+}
+
+QModelIndex MyTreeModel2::selectedIndex() const
+{
+    if (!m_selectedItem)
+    {
+        return QModelIndex();
+    }
+    return createIndex(m_selectedItem->row(), m_selectedColumn, m_selectedItem);
+}
+
+void MyTreeModel2::setSelectedIndex(const QModelIndex& index)
+{
+    TreeItem2* item = index.isValid() && index.model() == this
+        ? static_cast<TreeItem2*>(index.internalPointer())
+        : nullptr;
+    const int column = item ? index.column() : 0;
+    if (item == m_rootItem)
+    {
+        item = nullptr;
+    }
+
+    if (item == m_selectedItem && column == m_selectedColumn)
+    {
+        return;
+    }
+
+    TreeItem2* previous = m_selectedItem;
+    m_selectedItem = item;
+    m_selectedColumn = column;
+
+    emitRowChanged(previous);
+    if (item != previous)
+    {
+        emitRowChanged(item);
+    }
+    emit selectedIndexChanged();
+}
+
+void MyTreeModel2::emitRowChanged(TreeItem2* item)
+{
+    if (!item)
+    {
+        return;
+    }
+    emit dataChanged(createIndex(item->row(), 0, item),
+                     createIndex(item->row(), m_headers.count() - 1, item),
+                     { SelectedCellRole, SameItemRole });
+}
+
 QModelIndex MyTreeModel2::rootIndex() const
 {
     return createIndex(0, 0, reinterpret_cast<quintptr>(m_rootItem));
@@ -244,6 +541,10 @@ QRect MyTreeModel2::getRect(const QModelIndex& index)
     }
 
     TreeItem2* item = static_cast<TreeItem2*>(index.internalPointer());
+    if (item->position() >= 0)
+    {
+        return m_rects.at(item->position());
+    }
     rect.setX(item->data("abs_x").toInt());
     rect.setY(item->data("abs_y").toInt());
     rect.setWidth(item->data("width").toInt());
@@ -286,22 +587,136 @@ QStringList MyTreeModel2::headers() const
     return m_headers;
 }
 
-QVariantList MyTreeModel2::getChildrenIndexes(TreeItem2* node)
+int MyTreeModel2::nodeCount() const
 {
-    QVariantList indexes;
-    TreeItem2* parent = node ? node : m_rootItem;
+    return m_nodes.size();
+}
 
-    for (int i = 0; i != parent->childCount(); ++i)
+TreeItem2* MyTreeModel2::itemAt(int position) const
+{
+    if (position < 0 || position >= m_nodes.size())
     {
-        TreeItem2* child = parent->child(i);
-        indexes.push_back(createIndex(i, 0, reinterpret_cast<quintptr>(child)));
+        return nullptr;
+    }
+    return m_nodes.at(position).item;
+}
+
+QModelIndex MyTreeModel2::indexAt(int position) const
+{
+    TreeItem2* item = itemAt(position);
+    if (!item)
+    {
+        return QModelIndex();
+    }
+    return createIndex(item->row(), 0, item);
+}
+
+int MyTreeModel2::positionOf(const QModelIndex& index) const
+{
+    if (!index.isValid())
+    {
+        return -1;
+    }
+    return static_cast<TreeItem2*>(index.internalPointer())->position();
+}
+
+int MyTreeModel2::depthAt(int position) const
+{
+    return itemAt(position) ? m_nodes.at(position).depth : -1;
+}
+
+int MyTreeModel2::subtreeSizeAt(int position) const
+{
+    return itemAt(position) ? m_nodes.at(position).subtreeSize : 0;
+}
+
+const QVector<QRect>& MyTreeModel2::rects() const
+{
+    return m_rects;
+}
+
+QRect MyTreeModel2::rectAt(int position) const
+{
+    return itemAt(position) ? m_rects.at(position) : QRect();
+}
+
+int MyTreeModel2::flagsAt(int position) const
+{
+    return itemAt(position) ? m_nodes.at(position).flags : 0;
+}
+
+int MyTreeModel2::classIdAt(int position) const
+{
+    return itemAt(position) ? m_nodes.at(position).classId : -1;
+}
+
+int MyTreeModel2::classId(const QString& classname) const
+{
+    return m_classIds.value(classname, -1);
+}
+
+QVector<QJsonValue> MyTreeModel2::propertyColumn(const QString& key) const
+{
+    auto column = m_propertyColumns.find(key);
+    if (column == m_propertyColumns.end())
+    {
+        QAI_TRACE_SCOPE("model", "propertyColumn");
+
+        QVector<QJsonValue> values;
+        values.reserve(m_nodes.size());
+        for (const FlatNode& node : m_nodes)
+        {
+            values.append(node.item->data().value(key));
+        }
+        column = m_propertyColumns.insert(key, values);
+    }
+    return column.value();
+}
+
+int MyTreeModel2::parentAt(int position) const
+{
+    return itemAt(position) ? m_nodes.at(position).parent : -1;
+}
 
-        indexes.append(getChildrenIndexes(child));
+QString MyTreeModel2::idAt(int position) const
+{
+    TreeItem2* item = itemAt(position);
+    return item ? item->data().value(QStringLiteral("id")).toString() : QString();
+}
+
+QVariantList MyTreeModel2::indexRange(int first, int count) const
+{
+    QVariantList indexes;
+    const int begin = qMax(0, first);
+    const int end = qMin<int>(m_nodes.size(), count < 0 ? m_nodes.size() : first + count);
+    if (begin >= end)
+    {
+        return indexes;
     }
 
+    indexes.reserve(end - begin);
+    for (int position = begin; position < end; ++position)
+    {
+        TreeItem2* item = m_nodes.at(position).item;
+        indexes.append(createIndex(item->row(), 0, item));
+    }
     return indexes;
 }
 
+QVariantList MyTreeModel2::subtreeIndexes(const QModelIndex& index, int offset, int count) const
+{
+    const int position = positionOf(index);
+    if (position < 0)
+    {
+        return QVariantList();
+    }
+
+    const int size = subtreeSizeAt(position);
+    const int first = qBound(0, offset, size);
+    const int available = size - first;
+    return indexRange(position + 1 + first, count < 0 ? available : qMin(count, available));
+}
+
 QModelIndex MyTreeModel2::searchIndex(const QString& key,
                                       const QVariant& value,
                                       bool partialSearch,
@@ -387,84 +802,40 @@ QModelIndex MyTreeModel2::searchByCoordinates(qreal posx, qreal posy, TreeItem2*
         qDebug() << Q_FUNC_INFO << posx << posy;
     }
 
-    TreeItem2* parent = node ? node : m_rootItem;
-    QModelIndex childIndex;
-
-    for (int i = 0; i != parent->childCount(); ++i)
+    if (node && node->position() < 0)
     {
-        TreeItem2* child = parent->child(i);
-
-        bool canProcess = true;
-
-        const QVariant activeVariant = child->data(QStringLiteral("active"));
-        const bool active = activeVariant.isValid() ? activeVariant.toBool() : true;
-        if (!active)
-        {
-            canProcess = false;
-        }
-
-        const QVariant visibleVariant = child->data(QStringLiteral("visible"));
-        const bool visible = visibleVariant.isValid() ? visibleVariant.toBool() : true;
-        if (!visible)
-        {
-            canProcess = false;
-        }
-
-        const QVariant enabledVariant = child->data(QStringLiteral("enabled"));
-        const bool enabled = enabledVariant.isValid() ? enabledVariant.toBool() : true;
-        if (!enabled)
-        {
-            canProcess = false;
-        }
+        node = nullptr;
+    }
+    const int first = node ? node->position() + 1 : 0;
+    const int last = node ? node->position() + m_nodes.at(node->position()).subtreeSize : m_nodes.size() - 1;
 
-        const QVariant opacityVariant = child->data(QStringLiteral("opacity"));
-        const float opacity = opacityVariant.isValid() ? opacityVariant.toFloat() : 1.0f;
-        if (opacity == 0.0f)
-        {
-            canProcess = false;
-        }
+    return indexAt(hitTest(QPointF(posx, posy), first, last));
+}
 
-        const QString classname = child->data(QStringLiteral("classname")).toString();
-        const int itemx = child->data(QStringLiteral("abs_x")).toInt();
-        const int itemy = child->data(QStringLiteral("abs_y")).toInt();
-        const int itemw = child->data(QStringLiteral("width")).toInt();
-        const int itemh = child->data(QStringLiteral("height")).toInt();
-
-        if (canProcess &&
-            !classname.endsWith(QLatin1String("Loader")) &&
-            classname != QLatin1String("DeclarativeTouchBlocker") &&
-            classname != QLatin1String("QQuickItem") &&
-            classname != QLatin1String("RotatingItem") &&
-            classname != QLatin1String("QQuickShaderEffect") &&
-            classname != QLatin1String("QQuickOverlay") &&
-            classname != QLatin1String("QQuickRectangle") &&
-            classname != QLatin1String("QQuickMouseArea") &&
-            classname != QLatin1String("InformationManager") &&
-            classname != QLatin1String("QQuickShaderEffectSource") &&
-            classname != QLatin1String("HwcImage") &&
-            !classname.endsWith(QLatin1String("Gradient")) &&
-            !classname.endsWith(QLatin1String("DropArea")) &&
-            !classname.endsWith(QLatin1String("Effect")) &&
-            posx >= itemx &&
-            posx <= (itemx + itemw) && posy >= itemy && posy <= (itemy + itemh))
+int MyTreeModel2::hitTest(const QPointF& pos, int first, int last) const
+{
+    // Pre-order scan where the last match wins, which picks the topmost
+    // item; drop areas hide their whole subtree.
+    int found = -1;
+    last = qMin(last, int(m_nodes.size()) - 1);
+    for (int position = qMax(first, 0); position <= last; ++position)
+    {
+        const int flags = m_nodes.at(position).flags;
+        if (flags & NodeHitTestable)
         {
-            childIndex = createIndex(i, 0, reinterpret_cast<quintptr>(child));
-        } else
-
-        if (canProcess &&
-            classname.endsWith(QLatin1String("DropArea"))
-        ) {
-            continue;
+            const QRect& rect = m_rects.at(position);
+            if (pos.x() >= rect.x() && pos.x() <= rect.x() + rect.width() &&
+                pos.y() >= rect.y() && pos.y() <= rect.y() + rect.height())
+            {
+                found = position;
+            }
         }
-
-        QModelIndex someIndex = searchByCoordinates(posx, posy, child);
-        if (someIndex.isValid())
+        else if (flags & NodeDropArea)
         {
-            childIndex = someIndex;
+            position += m_nodes.at(position).subtreeSize;
         }
     }
-
-    return childIndex;
+    return found;
 }
 
 QModelIndex MyTreeModel2::searchByCoordinates(const QPointF& pos, TreeItem2* node)
@@ -485,6 +856,7 @@ TreeItem2::~TreeItem2()
 
 void TreeItem2::appendChild(TreeItem2* child)
 {
+    child->m_row = m_childs.size();
     m_childs.append(child);
 }
 
@@ -524,6 +896,11 @@ QJsonObject TreeItem2::data() const
     return m_data;
 }
 
+void TreeItem2::setData(const QJsonObject& data)
+{
+    m_data = data;
+}
+
 int TreeItem2::columnCount() const
 {
     return m_data.count();
@@ -531,12 +908,7 @@ int TreeItem2::columnCount() const
 
 int TreeItem2::row()
 {
-    if (!m_parent)
-    {
-        return 0;
-    }
-
-    return m_parent->row(this);
+    return m_row;
 }
 
 int TreeItem2::row(TreeItem2* child)
@@ -548,3 +920,13 @@ TreeItem2* TreeItem2::parent()
 {
     return m_parent;
 }
+
+int TreeItem2::position() const
+{
+    return m_position;
+}
+
+void TreeItem2::setPosition(int position)
+{
+    m_position = position;
+}
@@ -3,8 +3,11 @@
 
 #include <QAbstractItemModel>
 #include <QJsonObject>
+#include <QPointF>
 #include <QRect>
 
+#include <climits>
+
 class TreeItem2
 {
 public:
@@ -20,6 +23,7 @@ public:
 
     QVariant data(const QString &roleName) const;
     QJsonObject data() const;
+    void setData(const QJsonObject &data);
     int columnCount() const;
 
     int row();
@@ -27,17 +31,26 @@ public:
 
     TreeItem2 *parent();
 
+    // Pre-order position in MyTreeModel2::m_nodes, -1 for the header item.
+    int position() const;
+    void setPosition(int position);
+
 private:
 
     QVector<TreeItem2*> m_childs;
     QJsonObject m_data;
     TreeItem2 *m_parent = nullptr;
+    int m_row = 0;
+    int m_position = -1;
 
 };
 
 class MyTreeModel2 : public QAbstractItemModel
 {
     Q_OBJECT
+    Q_PROPERTY(int nodeCount READ nodeCount NOTIFY nodeCountChanged)
+    Q_PROPERTY(QModelIndex selectedIndex READ selectedIndex WRITE setSelectedIndex NOTIFY selectedIndexChanged)
+    Q_PROPERTY(int buildThreshold READ buildThreshold WRITE setBuildThreshold NOTIFY buildThresholdChanged)
 public:
     explicit MyTreeModel2(QObject *parent = nullptr);
 
@@ -47,6 +60,23 @@ public:
         ObjectName
     };
 
+    // selectedCell is true for the selected index only, sameItem for every
+    // column of the selected node. Changing the selection only emits
+    // dataChanged for the previously and newly selected rows.
+    enum Roles {
+        SelectedCellRole = Qt::UserRole + 1,
+        SameItemRole,
+    };
+
+    enum NodeFlag {
+        // Active, visible, enabled and not fully transparent.
+        NodeVisible = 0x1,
+        // Visible and of a class searchByCoordinates can pick.
+        NodeHitTestable = 0x2,
+        // A visible drop area; its subtree is skipped by hit testing.
+        NodeDropArea = 0x4,
+    };
+
     QVariant data(const QModelIndex &index, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     QVariant headerData(int section, Qt::Orientation orientation,
@@ -56,6 +86,15 @@ public:
     QModelIndex parent(const QModelIndex &index) const override;
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    QModelIndex selectedIndex() const;
+    void setSelectedIndex(const QModelIndex &index);
+
+    // fillModel builds subtrees of at most this many nodes on the thread
+    // pool and everything above them serially; 0 builds on one thread.
+    int buildThreshold() const;
+    void setBuildThreshold(int threshold);
 
     Q_INVOKABLE QModelIndex rootIndex() const;
 
@@ -66,20 +105,94 @@ public:
 
     Q_INVOKABLE QStringList headers() const;
 
+    // Flat pre-order view of the tree, rebuilt by fillModel. The subtree of
+    // the node at position p occupies positions p + 1 .. p + subtreeSizeAt(p).
+    int nodeCount() const;
+    TreeItem2 *itemAt(int position) const;
+    Q_INVOKABLE QModelIndex indexAt(int position) const;
+    Q_INVOKABLE int positionOf(const QModelIndex &index) const;
+    Q_INVOKABLE int depthAt(int position) const;
+    Q_INVOKABLE int subtreeSizeAt(int position) const;
+    Q_INVOKABLE int parentAt(int position) const;
+    // Object id of a node without converting its data to a QVariantMap.
+    Q_INVOKABLE QString idAt(int position) const;
+    Q_INVOKABLE QVariantList indexRange(int first, int count) const;
+    Q_INVOKABLE QVariantList subtreeIndexes(const QModelIndex &index, int offset = 0, int count = -1) const;
+
+    // Geometry column in device coordinates, indexed by position, so that
+    // overlays and hit testing never go through the JSON data.
+    const QVector<QRect> &rects() const;
+    QRect rectAt(int position) const;
+    int flagsAt(int position) const;
+    // Position of the topmost hit testable node at pos among positions
+    // first..last, or -1.
+    Q_INVOKABLE int hitTest(const QPointF &pos, int first = 0, int last = INT_MAX) const;
+
+    // Class column: classnames are interned to ids when the tree is built.
+    int classIdAt(int position) const;
+    int classId(const QString &classname) const;
+
+    // Values of one property for every position, extracted on first use and
+    // kept until the next fillModel. Not thread safe; fetch columns before
+    // handing them to worker threads. Columns are implicitly shared.
+    QVector<QJsonValue> propertyColumn(const QString &key) const;
+
+signals:
+    void nodeCountChanged();
+    void selectedIndexChanged();
+    void buildThresholdChanged();
+    // Emitted once after updateNodes; consumers of the flat columns refresh
+    // here rather than on every dataChanged.
+    void nodesUpdated();
+
 public slots:
     void fillModel(const QJsonObject &object);
+    // Replaces the properties of existing nodes without touching the tree
+    // shape, so views keep their expansion and selection. Data is given
+    // without children.
+    void updateNodes(const QVector<QPair<int, QJsonObject>> &nodes);
     void loadDump(const QString &dump);
     void loadFile(const QString &location);
 
-    QVariantList getChildrenIndexes(TreeItem2 *node = nullptr);
     QModelIndex searchIndex(const QString &key, const QVariant &value, bool partialSearch, const QModelIndex &currentIndex, TreeItem2 *node = nullptr);
     QModelIndex searchIndex(SearchType key, const QVariant &value, bool partialSearch, const QModelIndex &currentIndex, TreeItem2 *node = nullptr);
     QModelIndex searchByCoordinates(qreal posx, qreal posy, TreeItem2 *node = nullptr);
     QModelIndex searchByCoordinates(const QPointF &pos, TreeItem2 *node = nullptr);
 
 private:
+    struct FlatNode
+    {
+        TreeItem2 *item = nullptr;
+        int parent = -1;
+        int depth = 0;
+        int subtreeSize = 0;
+        int flags = 0;
+        int classId = -1;
+    };
+
+    struct BuildTask
+    {
+        QJsonArray data;
+        TreeItem2 *item = nullptr;
+    };
+
     QList<TreeItem2*> processChilds(const QJsonArray &data, TreeItem2 *parentItem);
+    void splitChilds(const QJsonArray &data, TreeItem2 *parentItem, QVector<BuildTask> *tasks) const;
+    // Nodes below data, counting stops once limit is reached.
+    static int countNodes(const QJsonArray &data, int limit);
+    void rebuildNodes();
+    void updateNodeColumns(int position, const QJsonObject &data);
+    void emitRowChanged(TreeItem2 *item);
 
     QStringList m_headers;
     TreeItem2 *m_rootItem = nullptr;
+    QVector<FlatNode> m_nodes;
+    QVector<QRect> m_rects;
+    QHash<QString, int> m_classIds;
+    mutable QHash<QString, QVector<QJsonValue>> m_propertyColumns;
+
+    int m_buildThreshold = 8192;
+
+    TreeItem2 *m_selectedItem = nullptr;
+    int m_selectedColumn = 0;
 };
@@ -0,0 +1,35 @@
+#include "overlayboxes.h"
+
+namespace OverlayBoxes {
+
+void setBox(QSGGeometry::ColoredPoint2D *vertices, const QRect &rect)
+{
+    const float left = rect.x();
+    const float top = rect.y();
+    const float right = rect.x() + rect.width();
+    const float bottom = rect.y() + rect.height();
+
+    vertices[0].x = left;  vertices[0].y = top;
+    vertices[1].x = right; vertices[1].y = top;
+    vertices[2].x = right; vertices[2].y = top;
+    vertices[3].x = right; vertices[3].y = bottom;
+    vertices[4].x = right; vertices[4].y = bottom;
+    vertices[5].x = left;  vertices[5].y = bottom;
+    vertices[6].x = left;  vertices[6].y = bottom;
+    vertices[7].x = left;  vertices[7].y = top;
+}
+
+void setBoxColor(QSGGeometry::ColoredPoint2D *vertices, const QColor &color)
+{
+    // QSGVertexColorMaterial expects premultiplied colours.
+    const QColor premultiplied = QColor::fromRgba(qPremultiply(color.rgba()));
+    for (int i = 0; i < VerticesPerBox; ++i)
+    {
+        vertices[i].r = uchar(premultiplied.red());
+        vertices[i].g = uchar(premultiplied.green());
+        vertices[i].b = uchar(premultiplied.blue());
+        vertices[i].a = uchar(premultiplied.alpha());
+    }
+}
+
+} // namespace OverlayBoxes
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <QColor>
+#include <QRect>
+#include <QSGGeometry>
+
+// Vertices of the box outlines BoundsOverlay and DiffOverlay draw: each box
+// is four line segments of a DrawLines geometry with per-vertex colours.
+namespace OverlayBoxes {
+
+constexpr int VerticesPerBox = 8;
+
+void setBox(QSGGeometry::ColoredPoint2D *vertices, const QRect &rect);
+void setBoxColor(QSGGeometry::ColoredPoint2D *vertices, const QColor &color);
+
+} // namespace OverlayBoxes
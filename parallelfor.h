@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <atomic>
+
+// Calls fn(i) for every i in [0, count) on the global thread pool and
+// returns when all calls are done. The calling thread takes work too, so at
+// most maxThreadCount() threads run, and helpers are only added while the
+// pool has idle threads; a busy pool degrades to a serial loop instead of
+// blocking.
+template <typename Fn>
+void parallelFor(int count, Fn &&fn)
+{
+    std::atomic<int> next {0};
+    auto work = [&]()
+    {
+        for (int i = next++; i < count; i = next++)
+        {
+            fn(i);
+        }
+    };
+
+    QSemaphore done;
+    int helpers = 0;
+    const int threads = qMin(QThreadPool::globalInstance()->maxThreadCount(), count);
+    for (int i = 1; i < threads; ++i)
+    {
+        if (!QThreadPool::globalInstance()->tryStart(
+                [&]()
+                {
+                    work();
+                    done.release();
+                }))
+        {
+            break;
+        }
+        ++helpers;
+    }
+    work();
+    done.acquire(helpers);
+}
@@ -0,0 +1,270 @@
+#include "payloadcodec.h"
+#include "tracer.h"
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QtEndian>
+
+#include <cstring>
+
+#ifdef QAINSPECTOR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef QAINSPECTOR_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+
+const char s_magic[4] = {'Q', 'A', 'I', 'F'};
+
+// Payloads above this are rejected rather than allocated.
+const quint32 s_maxFrameSize = 512 * 1024 * 1024;
+
+#ifdef QAINSPECTOR_HAVE_ZSTD
+const int s_zstdLevel = 3;
+#endif
+
+} // namespace
+
+namespace PayloadCodec {
+
+QStringList supportedCodecs()
+{
+    QStringList codecs;
+#ifdef QAINSPECTOR_HAVE_ZSTD
+    codecs.append(QStringLiteral("zstd"));
+#endif
+#ifdef QAINSPECTOR_HAVE_LZ4
+    codecs.append(QStringLiteral("lz4"));
+#endif
+    codecs.append(QStringLiteral("zlib"));
+    codecs.append(QStringLiteral("none"));
+    return codecs;
+}
+
+Codec codecFromName(const QString &name, bool *ok)
+{
+    if (ok)
+    {
+        *ok = supportedCodecs().contains(name);
+    }
+    if (name == QLatin1String("zstd"))
+    {
+        return Zstd;
+    }
+    if (name == QLatin1String("lz4"))
+    {
+        return Lz4;
+    }
+    if (name == QLatin1String("zlib"))
+    {
+        return Zlib;
+    }
+    return None;
+}
+
+QString codecName(Codec codec)
+{
+    switch (codec)
+    {
+    case Zlib:
+        return QStringLiteral("zlib");
+    case Zstd:
+        return QStringLiteral("zstd");
+    case Lz4:
+        return QStringLiteral("lz4");
+    case None:
+        break;
+    }
+    return QStringLiteral("none");
+}
+
+QByteArray compress(Codec codec, const QByteArray &data)
+{
+    QAI_TRACE_SCOPE("codec", "compress");
+
+    switch (codec)
+    {
+    case Zlib:
+        return qCompress(data);
+#ifdef QAINSPECTOR_HAVE_ZSTD
+    case Zstd:
+    {
+        QByteArray out(qsizetype(ZSTD_compressBound(size_t(data.size()))), Qt::Uninitialized);
+        const size_t size = ZSTD_compress(out.data(), size_t(out.size()), data.constData(), size_t(data.size()), s_zstdLevel);
+        if (ZSTD_isError(size))
+        {
+            qWarning() << Q_FUNC_INFO << ZSTD_getErrorName(size);
+            return {};
+        }
+        out.resize(qsizetype(size));
+        return out;
+    }
+#endif
+#ifdef QAINSPECTOR_HAVE_LZ4
+    case Lz4:
+    {
+        QByteArray out(LZ4_compressBound(int(data.size())), Qt::Uninitialized);
+        const int size = LZ4_compress_default(data.constData(), out.data(), int(data.size()), int(out.size()));
+        if (size <= 0)
+        {
+            qWarning() << Q_FUNC_INFO << "LZ4 compression failed";
+            return {};
+        }
+        out.resize(size);
+        return out;
+    }
+#endif
+    default:
+        return data;
+    }
+}
+
+QByteArray decompress(Codec codec, const QByteArray &data, qsizetype rawSize, bool *ok)
+{
+    QAI_TRACE_SCOPE("codec", "decompress");
+
+    if (ok)
+    {
+        *ok = true;
+    }
+
+    switch (codec)
+    {
+    case None:
+        return data;
+    case Zlib:
+    {
+        QByteArray out = qUncompress(data);
+        if (out.size() == rawSize)
+        {
+            return out;
+        }
+        qWarning() << Q_FUNC_INFO << "zlib: size mismatch";
+        break;
+    }
+#ifdef QAINSPECTOR_HAVE_ZSTD
+    case Zstd:
+    {
+        QByteArray out(rawSize, Qt::Uninitialized);
+        const size_t size = ZSTD_decompress(out.data(), size_t(out.size()), data.constData(), size_t(data.size()));
+        if (!ZSTD_isError(size) && qsizetype(size) == rawSize)
+        {
+            return out;
+        }
+        qWarning() << Q_FUNC_INFO << "zstd:" << (ZSTD_isError(size) ? ZSTD_getErrorName(size) : "size mismatch");
+        break;
+    }
+#endif
+#ifdef QAINSPECTOR_HAVE_LZ4
+    case Lz4:
+    {
+        QByteArray out(rawSize, Qt::Uninitialized);
+        const int size = LZ4_decompress_safe(data.constData(), out.data(), int(data.size()), int(out.size()));
+        if (size == rawSize)
+        {
+            return out;
+        }
+        qWarning() << Q_FUNC_INFO << "LZ4 decompression failed";
+        break;
+    }
+#endif
+    default:
+        qWarning() << Q_FUNC_INFO << "Unsupported codec:" << codec;
+        break;
+    }
+
+    if (ok)
+    {
+        *ok = false;
+    }
+    return {};
+}
+
+QByteArray encodeFrame(const QJsonObject &header, const QByteArray &payload, Codec codec)
+{
+    const QByteArray packed = payload.isEmpty() ? QByteArray() : compress(codec, payload);
+    return encodePackedFrame(header, packed, packed.isEmpty() ? None : codec, payload.size());
+}
+
+QByteArray encodePackedFrame(const QJsonObject &header, const QByteArray &packed, Codec codec, qsizetype rawSize)
+{
+    const QByteArray json = QJsonDocument(header).toJson(QJsonDocument::Compact);
+
+    QByteArray frame(FrameHeaderSize, '\0');
+    char *data = frame.data();
+    memcpy(data, s_magic, sizeof(s_magic));
+    data[4] = char(codec);
+    qToLittleEndian<quint32>(quint32(json.size()), data + 8);
+    qToLittleEndian<quint32>(quint32(packed.size()), data + 12);
+    qToLittleEndian<quint32>(quint32(rawSize), data + 16);
+
+    frame.append(json);
+    frame.append(packed);
+    return frame;
+}
+
+qsizetype frameSize(const QByteArray &buffer)
+{
+    if (buffer.size() < qsizetype(sizeof(s_magic)))
+    {
+        return 0;
+    }
+    if (memcmp(buffer.constData(), s_magic, sizeof(s_magic)) != 0)
+    {
+        return -1;
+    }
+    if (buffer.size() < FrameHeaderSize)
+    {
+        return 0;
+    }
+
+    const quint32 jsonSize = qFromLittleEndian<quint32>(buffer.constData() + 8);
+    const quint32 payloadSize = qFromLittleEndian<quint32>(buffer.constData() + 12);
+    if (jsonSize > s_maxFrameSize || payloadSize > s_maxFrameSize)
+    {
+        return -1;
+    }
+    return FrameHeaderSize + qsizetype(jsonSize) + qsizetype(payloadSize);
+}
+
+bool decodeFrame(const QByteArray &data, Frame *frame, bool decodePayload)
+{
+    const qsizetype size = frameSize(data);
+    if (size <= 0 || data.size() < size)
+    {
+        return false;
+    }
+
+    const Codec codec = Codec(quint8(data.at(4)));
+    const quint32 jsonSize = qFromLittleEndian<quint32>(data.constData() + 8);
+    const quint32 payloadSize = qFromLittleEndian<quint32>(data.constData() + 12);
+    const quint32 rawSize = qFromLittleEndian<quint32>(data.constData() + 16);
+    if (rawSize > s_maxFrameSize)
+    {
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument header = QJsonDocument::fromJson(data.mid(FrameHeaderSize, jsonSize), &error);
+    if (error.error != QJsonParseError::NoError)
+    {
+        qWarning() << Q_FUNC_INFO << "Invalid frame header:" << error.errorString();
+        return false;
+    }
+
+    bool ok = true;
+    frame->header = header.object();
+    frame->codec = codec;
+    frame->rawSize = rawSize;
+    if (!decodePayload || payloadSize == 0)
+    {
+        frame->payload.clear();
+        return true;
+    }
+    frame->payload = decompress(codec, data.mid(FrameHeaderSize + jsonSize, payloadSize), rawSize, &ok);
+    return ok;
+}
+
+} // namespace PayloadCodec
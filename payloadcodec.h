@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QStringList>
+
+// Binary framing negotiated during initialize. Once both sides agreed on it,
+// every reply is sent as
+//
+//   offset  size  field
+//        0     4  magic "QAIF"
+//        4     1  codec of the payload
+//        5     3  reserved, zero
+//        8     4  size of the JSON header
+//       12     4  size of the (compressed) payload
+//       16     4  size of the payload after decompression
+//       20     -  JSON header, then payload
+//
+// with all integers little-endian. The JSON header carries "status" and any
+// small fields; the payload replaces the base64 "value" of dumps and
+// screenshots. Requests and the analyze event stream are unchanged.
+//
+// Over a local transport the payload may instead sit in a SharedRing. Such
+// a frame has an empty payload section, keeps codec and raw size in the
+// binary header and names the ring data with "ring": [offset, size] in the
+// JSON header.
+namespace PayloadCodec {
+
+enum Codec : quint8 {
+    None = 0,
+    Zlib = 1,
+    Zstd = 2,
+    Lz4 = 3,
+};
+
+struct Frame
+{
+    QJsonObject header;
+    QByteArray payload;
+    Codec codec = None;
+    qsizetype rawSize = 0;
+};
+
+constexpr int FrameHeaderSize = 20;
+
+// Codecs compiled in, in order of preference.
+QStringList supportedCodecs();
+Codec codecFromName(const QString &name, bool *ok = nullptr);
+QString codecName(Codec codec);
+
+QByteArray compress(Codec codec, const QByteArray &data);
+QByteArray decompress(Codec codec, const QByteArray &data, qsizetype rawSize, bool *ok = nullptr);
+
+QByteArray encodeFrame(const QJsonObject &header, const QByteArray &payload, Codec codec);
+// Frame for a payload that was already compressed with codec. An empty
+// packed payload with a raw size describes a payload sent out of band.
+QByteArray encodePackedFrame(const QJsonObject &header, const QByteArray &packed, Codec codec, qsizetype rawSize);
+
+// Returns the total size of the frame at the start of buffer, 0 when more
+// data is needed and -1 when the buffer does not start with a frame.
+qsizetype frameSize(const QByteArray &buffer);
+// Without decodePayload, or for a payload sent out of band, only the header
+// is parsed and payload stays empty.
+bool decodeFrame(const QByteArray &data, Frame *frame, bool decodePayload = true);
+
+} // namespace PayloadCodec
@@ -0,0 +1,316 @@
+#include "propertylistmodel.h"
+#include "mytreemodel2.h"
+#include "tracer.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <utility>
+
+PropertyListModel::PropertyListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int PropertyListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+QVariant PropertyListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+    {
+        return QVariant();
+    }
+
+    const Row &row = m_rows.at(index.row());
+    switch (role)
+    {
+    case Qt::DisplayRole:
+    case NameRole:
+        return row.name;
+    case ValueRole:
+        return format(row.value);
+    case PreviousRole:
+        return row.change == Unchanged ? QString() : format(row.previous);
+    case ChangeRole:
+        return row.change;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> PropertyListModel::roleNames() const
+{
+    return {
+        { Qt::DisplayRole, "display" },
+        { NameRole, "name" },
+        { ValueRole, "value" },
+        { PreviousRole, "previous" },
+        { ChangeRole, "change" },
+    };
+}
+
+MyTreeModel2 *PropertyListModel::model() const
+{
+    return m_model;
+}
+
+void PropertyListModel::setModel(MyTreeModel2 *model)
+{
+    if (m_model == model)
+    {
+        return;
+    }
+
+    if (m_model)
+    {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model)
+    {
+        connect(m_model, &MyTreeModel2::selectedIndexChanged, this, &PropertyListModel::onSelectedIndexChanged);
+        connect(m_model, &QAbstractItemModel::modelReset, this, &PropertyListModel::onModelReset);
+        connect(m_model, &QAbstractItemModel::dataChanged, this, &PropertyListModel::onDataChanged);
+    }
+
+    emit modelChanged();
+    setIndex(m_model && m_followSelection ? m_model->selectedIndex() : QModelIndex());
+}
+
+bool PropertyListModel::followSelection() const
+{
+    return m_followSelection;
+}
+
+void PropertyListModel::setFollowSelection(bool follow)
+{
+    if (m_followSelection == follow)
+    {
+        return;
+    }
+
+    m_followSelection = follow;
+    emit followSelectionChanged();
+    onSelectedIndexChanged();
+}
+
+QModelIndex PropertyListModel::index() const
+{
+    return m_index;
+}
+
+void PropertyListModel::setIndex(const QModelIndex &index)
+{
+    const QModelIndex node = index.isValid() && index.model() == m_model ? index.siblingAtColumn(0) : QModelIndex();
+    if (node == m_index && m_index.isValid())
+    {
+        return;
+    }
+
+    m_index = node;
+    m_data = node.isValid() ? m_model->getData(node) : QJsonObject();
+    m_previous = QJsonObject();
+    m_hasPrevious = false;
+    rebuild();
+    emit indexChanged();
+}
+
+QString PropertyListModel::title() const
+{
+    return m_data.value(QLatin1String("classname")).toString();
+}
+
+QString PropertyListModel::filter() const
+{
+    return m_filter;
+}
+
+void PropertyListModel::setFilter(const QString &filter)
+{
+    if (m_filter == filter)
+    {
+        return;
+    }
+
+    m_filter = filter;
+    rebuild();
+    emit filterChanged();
+}
+
+bool PropertyListModel::changedFirst() const
+{
+    return m_changedFirst;
+}
+
+void PropertyListModel::setChangedFirst(bool changedFirst)
+{
+    if (m_changedFirst == changedFirst)
+    {
+        return;
+    }
+
+    m_changedFirst = changedFirst;
+    rebuild();
+    emit changedFirstChanged();
+}
+
+int PropertyListModel::changes() const
+{
+    return m_changes;
+}
+
+QString PropertyListModel::format(const QJsonValue &value)
+{
+    switch (value.type())
+    {
+    case QJsonValue::Array:
+        return QString::fromUtf8(QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact));
+    case QJsonValue::Object:
+        return QString::fromUtf8(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact));
+    case QJsonValue::Undefined:
+        return QString();
+    default:
+        return value.toVariant().toString();
+    }
+}
+
+void PropertyListModel::onSelectedIndexChanged()
+{
+    // A reload clears the selection; the node is found again in
+    // onModelReset, so only a new selection replaces it.
+    if (!m_followSelection || !m_model)
+    {
+        return;
+    }
+    const QModelIndex selected = m_model->selectedIndex();
+    if (selected.isValid())
+    {
+        setIndex(selected);
+    }
+}
+
+void PropertyListModel::onModelReset()
+{
+    if (m_data.isEmpty())
+    {
+        return;
+    }
+
+    QAI_TRACE_SCOPE("properties", "relocate");
+
+    const QJsonValue objectId = m_data.value(QLatin1String("objectId"));
+    QModelIndex found;
+    if (!objectId.toString().isEmpty())
+    {
+        const QVector<QJsonValue> column = m_model->propertyColumn(QStringLiteral("objectId"));
+        const auto it = std::find(column.cbegin(), column.cend(), objectId);
+        if (it != column.cend())
+        {
+            found = m_model->indexAt(int(it - column.cbegin()));
+        }
+    }
+
+    if (!found.isValid())
+    {
+        setIndex(QModelIndex());
+        return;
+    }
+
+    m_index = found;
+    m_previous = m_data;
+    m_hasPrevious = true;
+    m_data = m_model->getData(found);
+    rebuild();
+    emit indexChanged();
+}
+
+void PropertyListModel::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (!m_index.isValid() || topLeft.parent() != m_index.parent() ||
+        m_index.row() < topLeft.row() || m_index.row() > bottomRight.row())
+    {
+        return;
+    }
+
+    const QJsonObject data = m_model->getData(m_index);
+    if (data == m_data)
+    {
+        return;
+    }
+
+    m_previous = m_data;
+    m_hasPrevious = true;
+    m_data = data;
+    rebuild();
+}
+
+void PropertyListModel::rebuild()
+{
+    QAI_TRACE_SCOPE("properties", "rebuild");
+
+    const auto accepted = [this](const QString &name, const QJsonValue &value)
+    {
+        return m_filter.isEmpty() || name.contains(m_filter, Qt::CaseInsensitive) ||
+               format(value).contains(m_filter, Qt::CaseInsensitive);
+    };
+
+    beginResetModel();
+    m_rows.clear();
+    m_changes = 0;
+
+    // Keys of both objects iterate in sorted order, so rows come out sorted
+    // by name once removed properties are merged in.
+    for (auto it = m_data.constBegin(); it != m_data.constEnd(); ++it)
+    {
+        Row row {it.key(), it.value(), QJsonValue(QJsonValue::Undefined), Unchanged};
+        if (m_hasPrevious)
+        {
+            const auto previous = m_previous.constFind(it.key());
+            if (previous == m_previous.constEnd())
+            {
+                row.change = Added;
+            }
+            else if (previous.value() != it.value())
+            {
+                row.previous = previous.value();
+                row.change = Changed;
+            }
+        }
+        if (accepted(row.name, row.value))
+        {
+            m_rows.append(row);
+        }
+    }
+    if (m_hasPrevious)
+    {
+        const qsizetype present = m_rows.size();
+        for (auto it = m_previous.constBegin(); it != m_previous.constEnd(); ++it)
+        {
+            if (!m_data.contains(it.key()) && accepted(it.key(), it.value()))
+            {
+                m_rows.append({it.key(), QJsonValue(QJsonValue::Undefined), it.value(), Removed});
+            }
+        }
+        std::inplace_merge(m_rows.begin(), m_rows.begin() + present, m_rows.end(),
+                           [](const Row &a, const Row &b) { return a.name < b.name; });
+    }
+
+    for (const Row &row : std::as_const(m_rows))
+    {
+        if (row.change != Unchanged)
+        {
+            ++m_changes;
+        }
+    }
+    if (m_changedFirst)
+    {
+        std::stable_partition(m_rows.begin(), m_rows.end(), [](const Row &row) { return row.change != Unchanged; });
+    }
+
+    endResetModel();
+    emit rowsChanged();
+}
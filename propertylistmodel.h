@@ -0,0 +1,106 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QJsonObject>
+#include <QPersistentModelIndex>
+#include <QPointer>
+
+class MyTreeModel2;
+
+// Properties of one node of a tree model, one row per property. Values stay
+// QJsonValues and are only turned into text for the rows a view asks for.
+// The node follows the model's selection; when the node is patched, or the
+// tree is reloaded and a node with the same objectId exists, rows compare
+// the new values with the ones shown before.
+class PropertyListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(MyTreeModel2 *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(bool followSelection READ followSelection WRITE setFollowSelection NOTIFY followSelectionChanged)
+    Q_PROPERTY(QModelIndex index READ index WRITE setIndex NOTIFY indexChanged)
+    Q_PROPERTY(QString title READ title NOTIFY indexChanged)
+    Q_PROPERTY(QString filter READ filter WRITE setFilter NOTIFY filterChanged)
+    Q_PROPERTY(bool changedFirst READ changedFirst WRITE setChangedFirst NOTIFY changedFirstChanged)
+    Q_PROPERTY(int count READ rowCount NOTIFY rowsChanged)
+    Q_PROPERTY(int changes READ changes NOTIFY rowsChanged)
+public:
+    enum Roles
+    {
+        NameRole = Qt::UserRole + 1,
+        ValueRole,
+        PreviousRole,
+        ChangeRole,
+    };
+
+    enum Change
+    {
+        Unchanged,
+        Changed,
+        Added,
+        Removed,
+    };
+    Q_ENUM(Change)
+
+    explicit PropertyListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    MyTreeModel2 *model() const;
+    void setModel(MyTreeModel2 *model);
+
+    bool followSelection() const;
+    void setFollowSelection(bool follow);
+
+    QModelIndex index() const;
+    void setIndex(const QModelIndex &index);
+    QString title() const;
+
+    QString filter() const;
+    void setFilter(const QString &filter);
+
+    bool changedFirst() const;
+    void setChangedFirst(bool changedFirst);
+
+    int changes() const;
+
+    static QString format(const QJsonValue &value);
+
+signals:
+    void modelChanged();
+    void followSelectionChanged();
+    void indexChanged();
+    void filterChanged();
+    void changedFirstChanged();
+    void rowsChanged();
+
+private slots:
+    void onSelectedIndexChanged();
+    void onModelReset();
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+private:
+    struct Row
+    {
+        QString name;
+        QJsonValue value;
+        QJsonValue previous;
+        Change change = Unchanged;
+    };
+
+    void rebuild();
+
+    QPointer<MyTreeModel2> m_model;
+    bool m_followSelection = true;
+    QPersistentModelIndex m_index;
+    QJsonObject m_data;
+    QJsonObject m_previous;
+    bool m_hasPrevious = false;
+
+    QString m_filter;
+    bool m_changedFirst = false;
+
+    QVector<Row> m_rows;
+    int m_changes = 0;
+};
@@ -19,11 +19,22 @@ Window {
     minimumWidth: 600
     minimumHeight: 300
 
-    property bool loaded: false
+    // Set once the restored layout has been presented and startup events
+    // are processed; column widths only follow the window from then on.
+    readonly property bool loaded: StartupProfile.interactive
     property string filters: ""
 
+    // The tree shown is either the one of the primary connection or the one of
+    // the device selected in the devices window.
+    property var treeModel: DeviceManager.currentModel ? DeviceManager.currentModel : localTreeModel
+
+    onTreeModelChanged: treeView.forceLayout()
+
     onClosing: {
-        analyzeWindow.close()
+        if (analyzeLoader.item)
+            analyzeLoader.item.close()
+        if (devicesLoader.item)
+            devicesLoader.item.close()
 
         appSettings.width = width
         appSettings.height = height
@@ -64,13 +75,6 @@ Window {
             filters = filterSettings.value
     }
 
-    Timer {
-        running: true
-        repeat: false
-        interval: 1000
-        onTriggered: loaded = true
-    }
-
     Settings {
         id: appSettings
         category: "MainWindow"
@@ -122,18 +126,94 @@ Window {
         return maxW
     }
 
+    // Secondary windows are only created when first opened.
+    function openWindow(loader) {
+        loader.active = true
+        return loader.item
+    }
+
+    function refreshDump() {
+        if (DeviceManager.current) {
+            DeviceManager.current.dump(filters)
+            DeviceManager.current.grabWindow()
+            return
+        }
+        treeModel.loadDump(SocketConnector.getDumpTree(filters))
+        const start = Tracer.now()
+        treeView.forceLayout()
+        Tracer.complete("relayout", start)
+    }
+
+    TreeModel {
+        id: localTreeModel
+    }
+
+    Binding {
+        target: DumpWatcher
+        property: "model"
+        value: localTreeModel
+    }
+
+    Binding {
+        target: SnapshotHistory
+        property: "model"
+        value: localTreeModel
+    }
+
+    Binding {
+        target: DumpWatcher
+        property: "filter"
+        value: filters
+    }
+
+    Connections {
+        target: DumpWatcher
+
+        function onUpdated(reset, nodes) {
+            if (reset) {
+                treeView.forceLayout()
+            }
+        }
+    }
+
+    Connections {
+        target: DeviceManager
+
+        // Mirror, watch, analyze and replay only work on the primary
+        // connection and the local tree, not on a device from the list.
+        function onCurrentChanged() {
+            if (DeviceManager.current) {
+                DumpWatcher.running = false
+                ScreenMirror.stop()
+                ReplayEngine.stop()
+                SocketConnector.stopAnalyze()
+                if (analyzeLoader.item)
+                    analyzeLoader.item.close()
+            }
+        }
+    }
+
+    Connections {
+        target: DeviceManager.current
+
+        function onDumped(elapsed) {
+            console.log("Device dump:", DeviceManager.current.name, elapsed, "ms")
+            treeView.forceLayout()
+        }
+    }
+
     Connections {
         target: SocketConnector
 
         function onConnectedChanged() {
             if (SocketConnector.connected) {
-                treeModel.loadDump(SocketConnector.getDumpTree(filters))
+                refreshDump()
                 SocketConnector.getGrabWindow()
             }
         }
 
-        function onImageData(b64) {
-            screenshot.setFromB64(b64)
+        function onImageData(data) {
+            ScreenshotStore.setData(data)
         }
     }
 
@@ -210,11 +290,12 @@ Window {
 
         Button {
             text: "Dump tree"
-            enabled: SocketConnector.connected
+            enabled: DeviceManager.current ? DeviceManager.current.connected : SocketConnector.connected
 
             onClicked: {
-                treeModel.loadDump(SocketConnector.getDumpTree(filters))
-                SocketConnector.getGrabWindow()
+                refreshDump()
+                if (!DeviceManager.current)
+                    SocketConnector.getGrabWindow()
             }
         }
 
@@ -223,16 +304,89 @@ Window {
             enabled: SocketConnector.connected
 
             onClicked: {
-                filtersPopup.show()
+                openWindow(filtersLoader).show()
+            }
+        }
+
+        Button {
+            text: DeviceManager.current ? DeviceManager.current.name : "Devices"
+
+            onClicked: {
+                openWindow(devicesLoader).show()
             }
         }
 
         Button {
             text: "Analyze"
-            // enabled: SocketConnector.connected
+            enabled: !DeviceManager.current
+
+            onClicked: {
+                openWindow(analyzeLoader).show()
+            }
+        }
+
+        Button {
+            text: "Mirror"
+            checkable: true
+            checked: ScreenMirror.running
+            enabled: SocketConnector.connected && !DeviceManager.current
+
+            onToggled: {
+                if (checked) {
+                    ScreenMirror.start()
+                } else {
+                    ScreenMirror.stop()
+                }
+            }
+        }
+
+        Button {
+            text: DumpWatcher.running
+                  ? "Watch (" + DumpWatcher.interval + " ms, " + DumpWatcher.skipped + " skipped, "
+                    + SocketConnector.screenshotFormat + ")"
+                  : "Watch"
+            checkable: true
+            checked: DumpWatcher.running
+            enabled: SocketConnector.connected && !DeviceManager.current
+
+            onToggled: {
+                DumpWatcher.running = checked
+            }
+        }
+
+        Button {
+            id: boxesButton
+            text: "Boxes"
+            checkable: true
+        }
+
+        Button {
+            id: heatmapButton
+            text: TapStatistics.loaded ? "Heatmap (" + TapStatistics.taps + " taps)" : "Heatmap"
+            checkable: true
+
+            onToggled: {
+                if (checked && !TapStatistics.loaded)
+                    TapStatistics.reload()
+            }
+        }
+
+        Button {
+            text: "Trace"
+            checkable: true
+            checked: Tracer.enabled
+
+            onToggled: {
+                Tracer.enabled = checked
+            }
+        }
+
+        Button {
+            text: "Save trace"
+            enabled: Tracer.enabled
 
             onClicked: {
-                analyzeWindow.show()
+                console.log("Trace saved:", Tracer.exportChromeTrace())
             }
         }
 
@@ -241,7 +395,7 @@ Window {
             text: "Expand tree"
 
             onClicked: {
-                treeView.expandRecursively()
+                treeView.expandAll()
             }
         }
     }
@@ -276,40 +430,188 @@ Window {
             SplitView.minimumWidth: 300
             SplitView.preferredWidth: 600
 
-            Image {
-                id: screenshot
+            Flickable {
+                id: screenshotFlick
                 anchors.fill: parent
-                fillMode: Image.PreserveAspectFit
-                property real scaleX: sourceSize.width / paintedWidth
-                property real scaleY: sourceSize.height / paintedHeight
+                clip: true
+                boundsBehavior: Flickable.StopAtBounds
+                interactive: zoom > 1 && !ScreenMirror.running
+
+                property real zoom: 1
 
-                function setFromB64(b64) {
-                    source = "data:image/png;base64," + b64
+                contentWidth: width * zoom
+                contentHeight: height * zoom
+
+                WheelHandler {
+                    acceptedModifiers: Qt.ControlModifier
+                    onWheel: event => {
+                        const factor = event.angleDelta.y > 0 ? 1.25 : 0.8
+                        screenshotFlick.zoom = Math.max(1, Math.min(8, screenshotFlick.zoom * factor))
+                    }
                 }
 
-                MouseArea {
-                    anchors.centerIn: parent
-                    width: parent.paintedWidth
-                    height: parent.paintedHeight
-                    onClicked: {
-                        const newIndex = treeModel.searchByCoordinates(mouseX * screenshot.scaleX, mouseY * screenshot.scaleY)
-                        if (newIndex) {
-                            treeView.selectByIndex(newIndex)
+                Image {
+                    id: screenshot
+                    width: screenshotFlick.contentWidth
+                    height: screenshotFlick.contentHeight
+                    fillMode: Image.PreserveAspectFit
+                    cache: false
+                    asynchronous: !ScreenMirror.running
+                    source: ScreenshotStore.source
+
+                    // Decode only as many pixels as are painted; the store never upscales,
+                    // so the full resolution image is decoded once the zoom needs it.
+                    sourceSize: Qt.size(width * Screen.devicePixelRatio, height * Screen.devicePixelRatio)
+
+                    property real scaleX: ScreenshotStore.imageSize.width / paintedWidth
+                    property real scaleY: ScreenshotStore.imageSize.height / paintedHeight
+
+                    Binding {
+                        target: ScreenMirror
+                        property: "decodeSize"
+                        value: screenshot.sourceSize
+                    }
+
+                    MouseArea {
+                        anchors.centerIn: parent
+                        width: parent.paintedWidth
+                        height: parent.paintedHeight
+
+                        function devicePoint(mouse) {
+                            return Qt.point(mouse.x * screenshot.scaleX, mouse.y * screenshot.scaleY)
+                        }
+
+                        onPressed: mouse => {
+                            if (ScreenMirror.running)
+                                SocketConnector.mousePressed(devicePoint(mouse))
+                        }
+                        onPositionChanged: mouse => {
+                            if (ScreenMirror.running)
+                                SocketConnector.mouseMoved(devicePoint(mouse))
+                        }
+                        onReleased: mouse => {
+                            if (ScreenMirror.running)
+                                SocketConnector.mouseReleased(devicePoint(mouse))
+                        }
+                        onClicked: {
+                            if (ScreenMirror.running)
+                                return
+                            const newIndex = treeModel.searchByCoordinates(mouseX * screenshot.scaleX, mouseY * screenshot.scaleY)
+                            if (newIndex) {
+                                treeView.selectByIndex(newIndex)
+                            }
+                        }
+
+                        HeatmapOverlay {
+                            id: heatmapOverlay
+                            anchors.fill: parent
+                            clip: true
+                            visible: heatmapButton.checked
+                            statistics: TapStatistics
+                            sourceSize: ScreenshotStore.imageSize
+
+                            // Element under the pointer, whether or not the boxes are shown.
+                            property string hoveredId
+
+                            HoverHandler {
+                                id: heatmapHover
+                                onPointChanged: {
+                                    if (!hovered)
+                                        return
+                                    const position = treeModel.hitTest(Qt.point(point.position.x * screenshot.scaleX,
+                                                                                point.position.y * screenshot.scaleY))
+                                    heatmapOverlay.hoveredId = treeModel.idAt(position)
+                                }
+                            }
+
+                            ToolTip.visible: heatmapHover.hovered
+                            ToolTip.text: hoveredId ? TapStatistics.hitsFor(hoveredId) + " of " + TapStatistics.refinedTaps
+                                                      + " refined taps" : "Not a refined element"
+                        }
+
+                        BoundsOverlay {
+                            id: boundsOverlay
+                            anchors.fill: parent
+                            visible: boxesButton.checked && !ScreenMirror.running
+                            model: treeModel
+                            sourceSize: ScreenshotStore.imageSize
+                        }
+
+                        Rectangle {
+                            id: selectionRect
+                            visible: !boundsOverlay.visible
+
+                            color: "transparent"
+                            border.width: 1
+                            border.color: "#80ffde21"
+
+                            property rect deviceRect
+
+                            x: deviceRect.x / screenshot.scaleX
+                            y: deviceRect.y / screenshot.scaleY
+                            width: deviceRect.width / screenshot.scaleX
+                            height: deviceRect.height / screenshot.scaleY
+
+                            function setRect(sRect) {
+                                deviceRect = sRect
+                            }
                         }
                     }
+                }
+            }
 
-                    Rectangle {
-                        id: selectionRect
+            Rectangle {
+                anchors.left: parent.left
+                anchors.top: parent.top
+                anchors.margins: 8
+                width: mirrorStats.width + 16
+                height: mirrorStats.height + 16
+                radius: 4
+                color: "#c0000000"
+                visible: ScreenMirror.running
+
+                Text {
+                    id: mirrorStats
+                    anchors.centerIn: parent
+                    color: "white"
+                    font.pixelSize: 11
+                    font.family: "monospace"
+                    text: ScreenMirror.achievedFps.toFixed(0) + "/" + ScreenMirror.targetFps + " fps, "
+                          + ScreenMirror.latency.toFixed(0) + " ms, dropped " + ScreenMirror.droppedFrames
+                }
+            }
 
-                        color: "transparent"
-                        border.width: 1
-                        border.color: "#80ffde21"
+            Rectangle {
+                id: traceOverlay
+                anchors.right: parent.right
+                anchors.bottom: parent.bottom
+                anchors.margins: 8
+                width: traceColumn.width + 16
+                height: traceColumn.height + 16
+                radius: 4
+                color: "#c0000000"
+                visible: Tracer.enabled
+
+                property var events: []
+
+                Timer {
+                    running: traceOverlay.visible
+                    repeat: true
+                    interval: 500
+                    onTriggered: traceOverlay.events = Tracer.recent(10)
+                }
+
+                Column {
+                    id: traceColumn
+                    anchors.centerIn: parent
 
-                        function setRect(sRect) {
-                            x = sRect.x / screenshot.scaleX
-                            y = sRect.y / screenshot.scaleY
-                            width = sRect.width / screenshot.scaleX
-                            height = sRect.height / screenshot.scaleY
+                    Repeater {
+                        model: traceOverlay.events
+                        Text {
+                            color: "white"
+                            font.pixelSize: 11
+                            font.family: "monospace"
+                            text: modelData.category + "/" + modelData.name + ": " + modelData.duration.toFixed(2) + " ms"
                         }
                     }
                 }
@@ -376,7 +678,7 @@ Window {
                 Layout.fillHeight: true
                 clip: true
 
-                property var selectedIndex: null
+                readonly property var selectedIndex: treeModel.selectedIndex
                 property int searchIndex: 0
 
                 onSelectedIndexChanged: {
@@ -399,13 +701,49 @@ Window {
                     treeView.expandToIndex(newIndex)
                     treeView.forceLayout()
                     treeView.positionViewAtRow(treeView.rowAtIndex(newIndex), Qt.AlignVCenter)
-                    treeView.selectedIndex = newIndex
+                    treeModel.selectedIndex = newIndex
+                }
+
+                // Expand-all walks the flat pre-order view one page per
+                // frame, so a large tree does not block the GUI thread.
+                // Parents come before their children, so every row is
+                // already in the view when it is expanded.
+                property int expandPosition: 0
+
+                function expandAll() {
+                    expandPosition = 0
+                    expandTimer.restart()
                 }
 
-                model: TreeModel {
-                    id: treeModel
+                Timer {
+                    id: expandTimer
+                    interval: 0
+                    repeat: true
+                    onTriggered: {
+                        const first = treeView.expandPosition
+                        const indexes = treeModel.indexRange(first, 256)
+                        for (let i = 0; i < indexes.length; ++i) {
+                            if (treeModel.subtreeSizeAt(first + i) > 0) {
+                                const row = treeView.rowAtIndex(indexes[i])
+                                if (row >= 0)
+                                    treeView.expand(row)
+                            }
+                        }
+                        treeView.expandPosition = first + indexes.length
+                        if (indexes.length === 0)
+                            stop()
+                    }
                 }
 
+                Connections {
+                    target: treeModel
+                    function onNodeCountChanged() {
+                        expandTimer.stop()
+                    }
+                }
+
+                model: treeModel
+
                 delegate: TreeViewDelegate {
                     id: delegate
                     clip: true
@@ -414,13 +752,7 @@ Window {
 
                     Rectangle {
                         anchors.fill: parent
-                        color: treeView.selectedIndex
-                               ? treeView.selectedIndex === delegate.modelIndex
-                                 ? "#cce5ff"
-                                 : treeView.selectedIndex.internalId == delegate.modelIndex.internalId
-                                   ? "#e2eeff"
-                                   : "transparent"
-                               : "transparent"
+                        color: model.selectedCell ? "#cce5ff" : model.sameItem ? "#e2eeff" : "transparent"
                     }
 
                     MouseArea {
@@ -428,18 +760,12 @@ Window {
                         acceptedButtons: Qt.LeftButton | Qt.RightButton
 
                         onClicked: mouse => {
-                            treeView.selectedIndex = delegate.modelIndex
+                            treeModel.selectedIndex = delegate.modelIndex
                             if (mouse.button === Qt.RightButton) {
-                                const props = treeModel.getDataVariant(delegate.modelIndex)
-                                propsPopup.showData(props)
-                            } else {
-                                if (analyzeWindow.visible && analyzeWindow.refineIndex >= 0) {
-                                    const m = treeModel.getDataVariant(delegate.modelIndex)
-                                    const loc = analyzeModel.get(analyzeWindow.refineIndex).location
-                                    SocketConnector.manager.refine(loc, m.id)
-                                    analyzeModel.setProperty(analyzeWindow.refineIndex, "id", m.id)
-                                    analyzeWindow.refineIndex = -1
-                                }
+                                // The properties window follows the selection.
+                                openWindow(propsLoader).show()
+                            } else if (analyzeLoader.item) {
+                                analyzeLoader.item.refine(treeModel.getDataVariant(delegate.modelIndex).id)
                             }
                         }
 
@@ -498,6 +824,35 @@ Window {
         width: parent.width
         spacing: 10
 
+        Slider {
+            id: historySlider
+            Layout.leftMargin: 10
+            Layout.preferredWidth: 160
+            // The history is of the local tree; a listed device has its own model.
+            visible: SnapshotHistory.count > 1 && !DeviceManager.current
+            from: 0
+            to: Math.max(0, SnapshotHistory.count - 1)
+            stepSize: 1
+            snapMode: Slider.SnapAlways
+            value: SnapshotHistory.current
+
+            ToolTip.visible: hovered || pressed
+            ToolTip.text: Qt.formatTime(SnapshotHistory.timeAt(value), "hh:mm:ss.zzz")
+                          + "\n" + SnapshotHistory.storedNodes + " of " + SnapshotHistory.totalNodes + " nodes stored"
+
+            onMoved: {
+                // Live updates would jump straight back to the newest version.
+                DumpWatcher.running = false
+                SnapshotHistory.current = value
+                treeView.forceLayout()
+            }
+        }
+
+        Label {
+            visible: historySlider.visible
+            text: (SnapshotHistory.current + 1) + "/" + SnapshotHistory.count
+        }
+
         TextField {
             id: searchField
 
@@ -546,6 +901,24 @@ Window {
             onClicked: treeView.searchIndex = 3
         }
 
+        RadioButton {
+            id: selectorRadio
+            text: "Selector"
+            ToolTip.visible: hovered
+            ToolTip.text: "e.g. ListView[objectName=feed] QQuickText[visible=1]"
+        }
+
+        SelectorModel {
+            id: selectorModel
+            model: treeModel
+        }
+
+        Label {
+            visible: selectorRadio.checked && selectorModel.query
+            color: selectorModel.error ? "red" : palette.text
+            text: selectorModel.error ? selectorModel.error : selectorModel.count + " matches"
+        }
+
         Button {
             id: searchButton
             Layout.rightMargin: 10
@@ -553,418 +926,813 @@ Window {
             enabled: treeView.rows && searchField.text
 
             onClicked: {
-                const nextIndex = treeModel.searchIndex(
-                                    treeView.searchIndex,
-                                    searchField.text,
-                                    partialCheckbox.checked,
-                                    treeView.selectedIndex ? treeView.selectedIndex : treeView.rootIndex)
-                if (nextIndex) {
+                let nextIndex
+                if (selectorRadio.checked) {
+                    selectorModel.query = searchField.text
+                    nextIndex = selectorModel.next(treeView.selectedIndex)
+                } else {
+                    nextIndex = treeModel.searchIndex(
+                                treeView.searchIndex,
+                                searchField.text,
+                                partialCheckbox.checked,
+                                treeView.selectedIndex ? treeView.selectedIndex : treeView.rootIndex)
+                }
+                if (nextIndex && nextIndex.valid) {
                     treeView.expandToIndex(nextIndex)
                     treeView.forceLayout()
                     treeView.positionViewAtRow(treeView.rowAtIndex(nextIndex), Qt.AlignVCenter)
-                    treeView.selectedIndex = nextIndex
+                    treeModel.selectedIndex = nextIndex
                 }
             }
         }
     }
 
-    Window {
-        id: filtersPopup
-        title: "Filters"
+    Loader {
+        id: filtersLoader
+        active: false
 
-        width: 400
-        height: minimumHeight
+        sourceComponent: Window {
+            id: filtersPopup
+            title: "Filters"
 
-        minimumWidth: 300
-        minimumHeight: filtersView.count * 30
+            width: 400
+            height: minimumHeight
 
-        onVisibleChanged: {
-            if (!visible)
-                return
+            minimumWidth: 300
+            minimumHeight: filtersView.count * 30
 
-            filtersModel.printModelAsJson()
-        }
+            onVisibleChanged: {
+                if (!visible)
+                    return
+
+                filtersModel.printModelAsJson()
+            }
 
-        ListModel {
-            id: filtersModel
+            ListModel {
+                id: filtersModel
 
-            Component.onCompleted: {
-                const jsonString = '[ \
-                    { "key": "visible", "op": "eq", "value": "1" }, \
-                    { "key": "enabled", "op": "eq", "value": "1" }, \
-                    { "key": "opacity", "op": "gt", "value": "0" } \
-                ]';
+                Component.onCompleted: {
+                    const jsonString = '[ \
+                        { "key": "visible", "op": "eq", "value": "1" }, \
+                        { "key": "enabled", "op": "eq", "value": "1" }, \
+                        { "key": "opacity", "op": "gt", "value": "0" } \
+                    ]';
 
-                const data = JSON.parse(filters ? filters : jsonString);
+                    const data = JSON.parse(filters ? filters : jsonString);
 
-                for (let i = 0; i < data.length; i++) {
-                    append(data[i]);
+                    for (let i = 0; i < data.length; i++) {
+                        append(data[i]);
+                    }
+                }
+
+                function printModelAsJson() {
+                    let result = [];
+                    for (let i = 0; i < count; i++) {
+                        result.push(get(i));
+                    }
+                    filters = JSON.stringify(result);
+                    if (SocketConnector.connected) {
+                        refreshDump()
+                    }
                 }
             }
 
-            function printModelAsJson() {
-                let result = [];
-                for (let i = 0; i < count; i++) {
-                    result.push(get(i));
+            ListView {
+                id: filtersView
+                anchors.fill: parent
+
+                model: filtersModel
+
+                header: Button {
+                    text: "Disable filters"
+                    padding: 8
+                    onClicked: {
+                        filtersPopup.close()
+                        filters = ""
+                        refreshDump()
+                    }
                 }
-                filters = JSON.stringify(result);
-                if (SocketConnector.connected) {
-                    treeModel.loadDump(SocketConnector.getDumpTree(filters))
+
+                delegate: RowLayout {
+                    width: ListView.view.width
+                    implicitHeight: 30
+
+                    TextField {
+                        id: filterKey
+                        Layout.fillWidth: true
+                        padding: 4
+                        text: key
+                        Keys.onReleased: {
+                            filtersModel.setProperty(index, "key", text);
+                            filtersModel.printModelAsJson();
+                        }
+                    }
+
+                    ComboBox {
+                        id: filterOperation
+                        Layout.preferredWidth: 100
+                        model: ListModel {
+                            ListElement { text: "eq" }
+                            ListElement { text: "ne" }
+                            ListElement { text: "gt" }
+                            ListElement { text: "lt" }
+                        }
+                        currentIndex: find(op)
+
+                        Component.onCompleted: {
+                            currentIndex = find(op)
+                        }
+                        onActivated: idx => {
+                            filtersModel.setProperty(index, "op", currentText);
+                            filtersModel.printModelAsJson();
+                        }
+                    }
+
+                    TextField {
+                        id: filterValue
+                        Layout.fillWidth: true
+                        padding: 4
+                        text: value
+                        Keys.onReleased: {
+                            filtersModel.setProperty(index, "value", text);
+                            filtersModel.printModelAsJson();
+                        }
+                    }
                 }
             }
         }
+    }
 
-        ListView {
-            id: filtersView
-            anchors.fill: parent
+    Loader {
+        id: propsLoader
+        active: false
 
-            model: filtersModel
+        sourceComponent: Window {
+            id: propsPopup
+            title: properties.title ? properties.title + " properties" : "item properties"
 
-            header: Button {
-                text: "Disable filters"
-                padding: 8
-                onClicked: {
-                    filtersPopup.close()
-                    filters = ""
-                    treeModel.loadDump(SocketConnector.getDumpTree(filters))
-                }
+            width: 350
+            height: 600
+
+            PropertyListModel {
+                id: properties
+                model: treeModel
+                filter: propsFilter.text
+                changedFirst: changedFirstBox.checked
             }
 
-            delegate: RowLayout {
-                width: ListView.view.width
-                implicitHeight: 30
+            ColumnLayout {
+                anchors.fill: parent
+                spacing: 0
 
-                TextField {
-                    id: filterKey
+                RowLayout {
                     Layout.fillWidth: true
-                    padding: 4
-                    text: key
-                    Keys.onReleased: {
-                        filtersModel.setProperty(index, "key", text);
-                        filtersModel.printModelAsJson();
-                    }
-                }
+                    Layout.margins: 4
 
-                ComboBox {
-                    id: filterOperation
-                    Layout.preferredWidth: 100
-                    model: ListModel {
-                        ListElement { text: "eq" }
-                        ListElement { text: "ne" }
-                        ListElement { text: "gt" }
-                        ListElement { text: "lt" }
+                    TextField {
+                        id: propsFilter
+                        Layout.fillWidth: true
+                        leftPadding: 4
+                        rightPadding: 4
+                        placeholderText: "Filter properties"
                     }
-                    currentIndex: find(op)
 
-                    Component.onCompleted: {
-                        currentIndex = find(op)
-                    }
-                    onActivated: idx => {
-                        filtersModel.setProperty(index, "op", currentText);
-                        filtersModel.printModelAsJson();
+                    CheckBox {
+                        id: changedFirstBox
+                        text: properties.changes ? "Changed first (" + properties.changes + ")" : "Changed first"
                     }
                 }
 
-                TextField {
-                    id: filterValue
+                ListView {
+                    id: propsView
                     Layout.fillWidth: true
-                    padding: 4
-                    text: value
-                    Keys.onReleased: {
-                        filtersModel.setProperty(index, "value", text);
-                        filtersModel.printModelAsJson();
+                    Layout.fillHeight: true
+                    clip: true
+                    boundsBehavior: Flickable.StopAtBounds
+                    model: properties
+
+                    ScrollBar.vertical: ScrollBar {
+                        policy: ScrollBar.AsNeeded
+                    }
+
+                    delegate: RowLayout {
+                        id: propsRow
+                        width: propsView.width
+                                - (propsView.ScrollBar.vertical.visible ? propsView.ScrollBar.vertical.width : 0)
+                        spacing: 0
+
+                        required property string name
+                        required property string value
+                        required property string previous
+                        required property int change
+
+                        readonly property color changeColor: change === PropertyListModel.Changed ? "#fff3cd"
+                                                           : change === PropertyListModel.Added ? "#d4edda"
+                                                           : change === PropertyListModel.Removed ? "#f8d7da"
+                                                           : "transparent"
+
+                        TextField {
+                            Layout.preferredWidth: 150
+                            readOnly: true
+                            text: propsRow.name
+                            leftPadding: 4
+                            rightPadding: 4
+                            background: Rectangle {
+                                color: propsRow.changeColor
+                                border.color: "#d0d0d0"
+                            }
+
+                            onTextChanged: cursorPosition = 0
+
+                            onFocusChanged: {
+                                if (focus) {
+                                    selectAll()
+                                }
+                            }
+                        }
+
+                        TextField {
+                            Layout.fillWidth: true
+                            readOnly: true
+                            text: propsRow.change === PropertyListModel.Removed ? propsRow.previous : propsRow.value
+                            font.strikeout: propsRow.change === PropertyListModel.Removed
+                            leftPadding: 4
+                            rightPadding: 4
+                            background: Rectangle {
+                                color: propsRow.changeColor
+                                border.color: "#d0d0d0"
+                            }
+
+                            ToolTip.visible: hovered && propsRow.change === PropertyListModel.Changed
+                            ToolTip.text: "was: " + propsRow.previous
+
+                            onTextChanged: cursorPosition = 0
+
+                            onFocusChanged: {
+                                if (focus) {
+                                    selectAll()
+                                }
+                            }
+                        }
                     }
                 }
             }
         }
     }
 
-    Window {
-        id: propsPopup
-        title: "item properties"
-
-        width: 350
-        height: 600
+    Loader {
+        id: devicesLoader
+        active: false
 
-        property var props: ({})
-        property var keys: []
+        sourceComponent: Window {
+            id: devicesWindow
 
-        function showData(d) {
-            keys = []
-            props = d
-            keys = Object.keys(d)
-
-            show()
-        }
+            width: 400
+            height: 400
+            minimumWidth: 300
 
-        Flickable {
-            id: flick
-            anchors.fill: parent
-            clip: true
-            flickableDirection: Flickable.VerticalFlick
-            boundsBehavior: Flickable.StopAtBounds
+            title: "Devices"
 
-            contentWidth: flick.width
-            contentHeight: split.height
+            transientParent: null
 
-            ScrollBar.vertical: ScrollBar {
-                policy: ScrollBar.AsNeeded
-            }
+            ColumnLayout {
+                anchors.fill: parent
+                anchors.margins: 4
 
-            SplitView {
-                id: split
-                orientation: Qt.Horizontal
-                width: flick.width
+                RowLayout {
+                    Layout.fillWidth: true
 
-                implicitHeight: Math.max(...contentChildren.map(c => c.implicitHeight))
+                    Button {
+                        text: "Add"
+                        enabled: ipField.text && portField.text
+                        ToolTip.visible: hovered
+                        ToolTip.text: "Add the address from the main window"
+                        onClicked: DeviceManager.addDevice(ipField.text, portField.text)
+                    }
 
-                handle: Item {
-                    id: handlePropsDelegate
-                    width: 0
-                    height: 0
+                    Button {
+                        text: "Connect all"
+                        onClicked: DeviceManager.connectAll()
+                    }
 
-                    Rectangle {
-                        implicitWidth: split.orientation === Qt.Horizontal ? 1 : split.width
-                        implicitHeight: split.orientation === Qt.Horizontal ? split.height : 1
-                        color: "black"
-                        opacity: 0.4
-                    }
-
-                    containmentMask: Item {
-                        x: (handlePropsDelegate.width - width) / 2
-                        width: 8
-                        height: handlePropsDelegate.height
-                    }
-                }
-
-                Item {
-                    implicitHeight: keysColumn.height
-                    SplitView.minimumWidth: 150
-                    SplitView.preferredWidth: 150
-
-                    Column {
-                        id: keysColumn
-                        width: parent.width
-                        Repeater {
-                            model: propsPopup.keys
-                            TextField {
-                                id: propsKey
-                                width: parent.width
-                                readOnly: false
-                                text: modelData
-                                leftPadding: 4
-                                rightPadding: 4
-
-                                onTextChanged: cursorPosition = 0
-
-                                onFocusChanged: {
-                                    if (focus) {
-                                        selectAll()
-                                    }
-                                }
-                            }
+                    Button {
+                        text: "Dump all"
+                        onClicked: {
+                            DeviceManager.dumpAll(filters)
+                            DeviceManager.grabAll()
                         }
                     }
                 }
 
-                Item {
-                    implicitHeight: valuesColumn.height
-                    SplitView.minimumWidth: 200
+                ListView {
+                    id: devicesView
+                    Layout.fillWidth: true
+                    Layout.fillHeight: true
+                    clip: true
+
+                    model: DeviceManager
+                    header: ItemDelegate {
+                        width: ListView.view.width
+                        text: "Primary connection"
+                        highlighted: DeviceManager.currentIndex === -1
+                        onClicked: DeviceManager.currentIndex = -1
+                    }
 
-                    Column {
-                        id: valuesColumn
-                        width: parent.width
-                        Repeater {
-                            model: propsPopup.keys
-                            TextField {
-                                id: propsValue
-                                width: parent.width
-                                       - (flick.ScrollBar.vertical.visible ? flick.ScrollBar.vertical.width : 0)
-                                readOnly: false
-                                text: propsPopup.props[modelData]
-                                leftPadding: 4
-                                rightPadding: 4
+                    delegate: ItemDelegate {
+                        width: ListView.view.width
+                        highlighted: DeviceManager.currentIndex === index
+                        text: model.name + (model.busy ? " …" : "")
 
-                                onTextChanged: cursorPosition = 0
+                        onClicked: DeviceManager.currentIndex = index
 
-                                onFocusChanged: {
-                                    if (focus) {
-                                        selectAll()
+                        RowLayout {
+                            anchors.right: parent.right
+                            anchors.verticalCenter: parent.verticalCenter
+
+                            Button {
+                                text: model.connected ? "Disconnect" : "Connect"
+                                onClicked: {
+                                    if (model.connected) {
+                                        model.device.disconnectDevice()
+                                    } else {
+                                        model.device.connectDevice()
                                     }
                                 }
                             }
+
+                            Button {
+                                text: "Remove"
+                                onClicked: DeviceManager.removeDevice(index)
+                            }
                         }
                     }
+
+                    ScrollBar.vertical: ScrollBar {
+                        policy: ScrollBar.AsNeeded
+                    }
                 }
             }
         }
     }
 
-    Window {
-        id: analyzeWindow
+    Loader {
+        id: analyzeLoader
+        active: false
 
-        width: minimumWidth
-        minimumWidth: 400
-        height: 800
+        sourceComponent: Window {
+            id: analyzeWindow
 
-        title: "Analyze tool"
+            width: minimumWidth
+            minimumWidth: 400
+            height: 800
 
-        transientParent: null
+            title: "Analyze tool"
 
-        property bool analyzeActive: false
-        property int refineIndex: -1
+            transientParent: null
 
-        onVisibleChanged: {
-            if (!visible)
-                return
+            readonly property bool analyzeActive: SocketConnector.analyzing
+            property int refineIndex: -1
+            property int selectedCount: 0
+            property string diffBase
 
-            analyzeModel.clear()
-            SocketConnector.manager.load()
-        }
-
-        onClosing: {
-            if (SocketConnector.connected && analyzeActive)
-                SocketConnector.stopAnalyze()
-        }
+            function selectedRows() {
+                const rows = []
+                for (let i = 0; i < analyzeModel.count; ++i) {
+                    if (analyzeModel.get(i).selected)
+                        rows.push(i)
+                }
+                return rows
+            }
 
-        Connections {
-            target: SocketConnector.manager
+            function rowOf(location) {
+                for (let i = 0; i < analyzeModel.count; ++i) {
+                    if (analyzeModel.get(i).location === location)
+                        return i
+                }
+                return -1
+            }
 
-            function onDataAdded(p) {
-                analyzeModel.append(p)
+            // Rows stay in the list, greyed out, until the manager reports
+            // each recording done or failed.
+            function markPending(rows) {
+                for (const row of rows) {
+                    if (analyzeModel.get(row).selected)
+                        --selectedCount
+                    analyzeModel.setProperty(row, "selected", false)
+                    analyzeModel.setProperty(row, "pending", true)
+                }
+                return rows.map(row => analyzeModel.get(row).location)
             }
-        }
 
-        ColumnLayout {
-            id: analyzeHeaderItem
+            function refine(elementId) {
+                if (!visible || refineIndex < 0)
+                    return
 
-            width: parent.width
-            height: 30
+                // Refining one of the selected recordings refines all of them.
+                const rows = analyzeModel.get(refineIndex).selected ? selectedRows() : [refineIndex]
+                SocketConnector.manager.refineAll(markPending(rows), elementId)
+                refineIndex = -1
+            }
 
-            RowLayout {
-                Button {
-                    text: analyzeWindow.analyzeActive ? "Stop" : "Start"
-                    enabled: SocketConnector.connected
-                    onClicked: {
-                        analyzeWindow.analyzeActive = !analyzeWindow.analyzeActive
-                        if (analyzeWindow.analyzeActive) {
-                            SocketConnector.startAnalyze()
-                        } else {
-                            SocketConnector.stopAnalyze()
-                        }
-                    }
-                }
+            function remove(rows) {
+                SocketConnector.manager.removeAll(markPending(rows))
             }
-        }
 
-        ListView {
-            id: analyzeView
-            anchors.fill: parent
-            anchors.topMargin: analyzeHeaderItem.height
-            clip: true
-            currentIndex: -1
+            onVisibleChanged: {
+                if (!visible)
+                    return
 
-            model: analyzeModel
-            spacing: 8
-            delegate: MouseArea {
-                id: analyzeDelegate
+                analyzeModel.clear()
+                selectedCount = 0
+                SocketConnector.manager.load()
+            }
 
-                width: ListView.view.width
-                height: 120
+            onClosing: {
+                if (SocketConnector.connected && analyzeActive)
+                    SocketConnector.stopAnalyze()
+            }
 
-                acceptedButtons: Qt.LeftButton | Qt.RightButton
+            Connections {
+                target: SocketConnector.manager
 
-                onClicked: mouse => {
-                    if (mouse.button === Qt.RightButton) {
-                        menu.popup()
+                function onDataAdded(p) {
+                    p.selected = false
+                    p.pending = false
+                    analyzeModel.append(p)
+                }
+
+                function onDataRemoved(location) {
+                    const row = analyzeWindow.rowOf(location)
+                    if (row < 0)
                         return
-                    }
-                    select()
+                    if (analyzeView.currentIndex === row)
+                        analyzeView.currentIndex = -1
+                    analyzeModel.remove(row)
                 }
 
-                function select(forcePoint = false) {
-                    analyzeView.currentIndex = index
-                    screenshot.source = "file:///" + model.location + "/screenshot.png"
-                    treeModel.loadFile(model.location + "/dump.json")
-                    if (model.id && !forcePoint) {
-                        console.log("search for id:", model.id, treeView.rootIndex, treeModel.rootIndex())
-                        const item = treeModel.searchIndex("id", model.id, false, treeModel.rootIndex())
-                        if (item) {
-                            treeView.selectByIndex(item)
-                            treeView.positionViewAtRow(treeView.rowAtIndex(item), Qt.AlignVCenter)
-                        }
-                    } else {
-                        const idx = treeModel.searchByCoordinates(model.x, model.y)
-                        if (idx) {
-                            treeView.selectByIndex(idx)
-                            treeView.positionViewAtRow(treeView.rowAtIndex(idx), Qt.AlignVCenter)
-                        }
-                    }
+                function onDataRefined(location, id) {
+                    const row = analyzeWindow.rowOf(location)
+                    if (row < 0)
+                        return
+                    analyzeModel.setProperty(row, "id", id)
+                    analyzeModel.setProperty(row, "pending", false)
                 }
 
-                Rectangle {
-                    anchors.fill: parent
-                    color: "#10000000"
-                    visible: analyzeView.currentIndex === index
+                function onOperationFailed(location) {
+                    const row = analyzeWindow.rowOf(location)
+                    if (row >= 0)
+                        analyzeModel.setProperty(row, "pending", false)
                 }
+            }
+
+            ColumnLayout {
+                id: analyzeHeaderItem
 
-                Menu {
-                    id: menu
+                width: parent.width
+                height: 30
 
-                    MenuItem {
-                        text: "Refine"
+                RowLayout {
+                    Button {
+                        text: analyzeWindow.analyzeActive ? "Stop" : "Start"
+                        enabled: SocketConnector.connected
                         onClicked: {
-                            analyzeWindow.refineIndex = index
-                            analyzeDelegate.select()
+                            if (analyzeWindow.analyzeActive) {
+                                SocketConnector.stopAnalyze()
+                            } else {
+                                SocketConnector.startAnalyze()
+                            }
                         }
                     }
 
-                    MenuItem {
-                        text: "Select"
+                    Button {
+                        text: ReplayEngine.running ? "Stop replay" : "Replay"
+                        enabled: SocketConnector.connected && !analyzeWindow.analyzeActive
                         onClicked: {
-                            analyzeDelegate.select(true)
+                            if (ReplayEngine.running) {
+                                ReplayEngine.stop()
+                            } else {
+                                ReplayEngine.filter = filters
+                                ReplayEngine.speed = replaySpeed.value
+                                ReplayEngine.start()
+                            }
                         }
                     }
 
-                    MenuItem {
-                        text: "Delete"
-                        onClicked: {
-                            SocketConnector.manager.remove(model.location)
-                            analyzeModel.remove(index)
-                        }
+                    SpinBox {
+                        id: replaySpeed
+                        from: 0
+                        to: 100
+                        value: 1
+                        ToolTip.visible: hovered
+                        ToolTip.text: "Replay speed, 0 for as fast as possible"
+                    }
+
+                    Label {
+                        visible: ReplayEngine.stepCount > 0
+                        text: ReplayEngine.completedSteps + "/" + ReplayEngine.stepCount
+                              + " passed " + ReplayEngine.passedSteps + " failed " + ReplayEngine.failedSteps
+                    }
+
+                    Button {
+                        text: "Delete selected (" + analyzeWindow.selectedCount + ")"
+                        visible: analyzeWindow.selectedCount > 0
+                        onClicked: analyzeWindow.remove(analyzeWindow.selectedRows())
+                    }
+
+                    ProgressBar {
+                        visible: SocketConnector.manager.busy
+                        from: 0
+                        to: Math.max(1, SocketConnector.manager.totalOperations)
+                        value: SocketConnector.manager.completedOperations
+                        ToolTip.visible: hovered
+                        ToolTip.text: SocketConnector.manager.completedOperations + "/"
+                                      + SocketConnector.manager.totalOperations + " recordings"
                     }
                 }
+            }
 
-                RowLayout {
-                    anchors.fill: parent
+            ListView {
+                id: analyzeView
+                anchors.fill: parent
+                anchors.topMargin: analyzeHeaderItem.height
+                clip: true
+                currentIndex: -1
 
-                    Text {
-                        Layout.fillWidth: true
-                        text: Qt.formatDateTime(new Date(parseInt(model.location.split('/').pop())), "yyyy-MM-dd hh:mm:ss")
-                        padding: 4
+                model: analyzeModel
+                spacing: 8
+                delegate: MouseArea {
+                    id: analyzeDelegate
+
+                    width: ListView.view.width
+                    height: 120
+
+                    acceptedButtons: Qt.LeftButton | Qt.RightButton
+                    enabled: !model.pending
+                    opacity: model.pending ? 0.4 : 1
+
+                    onClicked: mouse => {
+                        if (mouse.button === Qt.RightButton) {
+                            menu.popup()
+                            return
+                        }
+                        if (mouse.modifiers & Qt.ControlModifier) {
+                            analyzeModel.setProperty(index, "selected", !model.selected)
+                            analyzeWindow.selectedCount += model.selected ? 1 : -1
+                            return
+                        }
+                        select()
+                    }
+
+                    function select(forcePoint = false) {
+                        analyzeView.currentIndex = index
+                        ScreenshotStore.loadFile(model.location + "/screenshot.png")
+                        treeModel.loadFile(model.location + "/dump.json")
+                        if (model.id && !forcePoint) {
+                            console.log("search for id:", model.id, treeView.rootIndex, treeModel.rootIndex())
+                            const item = treeModel.searchIndex("id", model.id, false, treeModel.rootIndex())
+                            if (item) {
+                                treeView.selectByIndex(item)
+                                treeView.positionViewAtRow(treeView.rowAtIndex(item), Qt.AlignVCenter)
+                            }
+                        } else {
+                            const idx = treeModel.searchByCoordinates(model.x, model.y)
+                            if (idx) {
+                                treeView.selectByIndex(idx)
+                                treeView.positionViewAtRow(treeView.rowAtIndex(idx), Qt.AlignVCenter)
+                            }
+                        }
+                    }
+
+                    Rectangle {
+                        anchors.fill: parent
+                        color: "#10000000"
+                        visible: analyzeView.currentIndex === index
+                    }
+
+                    Rectangle {
+                        anchors.fill: parent
+                        color: "#200969da"
+                        border.color: "#0969da"
+                        visible: model.selected
+                    }
+
+                    Menu {
+                        id: menu
+
+                        MenuItem {
+                            text: "Refine"
+                            onClicked: {
+                                analyzeWindow.refineIndex = index
+                                analyzeDelegate.select()
+                            }
+                        }
+
+                        MenuItem {
+                            text: "Select"
+                            onClicked: {
+                                analyzeDelegate.select(true)
+                            }
+                        }
+
+                        MenuItem {
+                            text: "Mark for diff"
+                            onClicked: {
+                                analyzeWindow.diffBase = model.location
+                            }
+                        }
+
+                        MenuItem {
+                            text: "Diff with marked"
+                            enabled: analyzeWindow.diffBase && analyzeWindow.diffBase !== model.location
+                            onClicked: {
+                                openWindow(diffLoader).compare(analyzeWindow.diffBase, model.location)
+                            }
+                        }
+
+                        MenuItem {
+                            text: "Delete"
+                            onClicked: {
+                                analyzeWindow.remove([index])
+                            }
+                        }
                     }
 
-                    Image {
-                        Layout.preferredWidth: Math.min(sourceSize.width, parent.width / 2)
-                        Layout.preferredHeight: Math.min(sourceSize.height, parent.height)
-                        Layout.rightMargin: analyzeView.ScrollBar.vertical.visible ? analyzeView.ScrollBar.vertical.width : 4
+                    RowLayout {
+                        anchors.fill: parent
+
+                        Text {
+                            Layout.fillWidth: true
+                            text: Qt.formatDateTime(new Date(parseInt(model.location.split('/').pop())), "yyyy-MM-dd hh:mm:ss")
+                            padding: 4
+                        }
 
-                        fillMode: Image.PreserveAspectFit
-                        source: "file:///" + model.location + "/screenshot.png"
-                        cache: true
-                        horizontalAlignment: Image.AlignRight
-                        verticalAlignment: Image.AlignVCenter
+                        Image {
+                            Layout.preferredWidth: Math.min(sourceSize.width, parent.width / 2)
+                            Layout.preferredHeight: Math.min(sourceSize.height, parent.height)
+                            Layout.rightMargin: analyzeView.ScrollBar.vertical.visible ? analyzeView.ScrollBar.vertical.width : 4
+
+                            fillMode: Image.PreserveAspectFit
+                            source: "file:///" + model.location + "/screenshot.png"
+                            sourceSize.height: analyzeDelegate.height
+                            asynchronous: true
+                            cache: true
+                            horizontalAlignment: Image.AlignRight
+                            verticalAlignment: Image.AlignVCenter
+                        }
                     }
                 }
+
+                ScrollBar.vertical: ScrollBar {
+                    policy: ScrollBar.AsNeeded
+                }
             }
 
-            ScrollBar.vertical: ScrollBar {
-                policy: ScrollBar.AsNeeded
+            ListModel {
+                id: analyzeModel
             }
         }
+    }
 
-        ListModel {
-            id: analyzeModel
+    Loader {
+        id: diffLoader
+        active: false
+
+        sourceComponent: Window {
+            id: diffWindow
+
+            width: 1200
+            height: 700
+
+            title: diffModel.running ? "Diff (running)" : "Diff"
+
+            transientParent: null
+
+            property int currentRow: -1
+
+            function compare(left, right) {
+                currentRow = -1
+                diffModel.compare(left, right)
+                show()
+            }
+
+            function kindColor(kind) {
+                return kind === "added" ? "#2da44e"
+                     : kind === "removed" ? "#cf222e"
+                     : kind === "moved" ? "#0969da"
+                     : "#d4a72c"
+            }
+
+            DiffModel {
+                id: diffModel
+            }
+
+            // Screenshot of one side with the rects of all changes on it.
+            component DiffShot: Image {
+                id: shot
+
+                property string location
+                property alias side: overlay.side
+
+                fillMode: Image.PreserveAspectFit
+                asynchronous: true
+                cache: false
+                source: location ? "file:///" + location + "/screenshot.png" : ""
+
+                DiffOverlay {
+                    id: overlay
+                    anchors.centerIn: parent
+                    width: shot.paintedWidth
+                    height: shot.paintedHeight
+                    model: diffModel
+                    sourceSize: Qt.size(shot.implicitWidth, shot.implicitHeight)
+                    currentRow: diffWindow.currentRow
+                }
+            }
+
+            ColumnLayout {
+                anchors.fill: parent
+                anchors.margins: 4
+
+                Label {
+                    Layout.fillWidth: true
+                    elide: Text.ElideRight
+                    text: diffModel.error ? diffModel.error
+                        : "changed " + (diffModel.summary.changed || 0)
+                          + ", added " + (diffModel.summary.added || 0)
+                          + ", removed " + (diffModel.summary.removed || 0)
+                          + ", moved " + (diffModel.summary.moved || 0)
+                          + ", identical " + (diffModel.summary.identical || 0)
+                          + " of " + (diffModel.summary.leftNodes || 0) + "/" + (diffModel.summary.rightNodes || 0)
+                          + " nodes in " + (diffModel.summary.diffElapsed || 0).toFixed(1) + " ms"
+                }
+
+                SplitView {
+                    Layout.fillWidth: true
+                    Layout.fillHeight: true
+
+                    DiffShot {
+                        SplitView.preferredWidth: parent.width / 3
+                        location: diffModel.leftLocation
+                        side: DiffModel.Left
+                    }
+
+                    ListView {
+                        id: diffView
+                        SplitView.fillWidth: true
+                        clip: true
+                        model: diffModel
+                        currentIndex: diffWindow.currentRow
+
+                        delegate: ItemDelegate {
+                            width: ListView.view.width
+                            highlighted: ListView.isCurrentItem
+                            onClicked: diffWindow.currentRow = index
+
+                            contentItem: ColumnLayout {
+                                spacing: 2
+
+                                Label {
+                                    Layout.fillWidth: true
+                                    elide: Text.ElideMiddle
+                                    color: diffWindow.kindColor(model.kind)
+                                    text: model.kind + " " + model.classname + (model.label ? " \"" + model.label + "\"" : "")
+                                          + (model.kind === "added" || model.kind === "removed" ? " (" + model.nodes + " nodes)" : "")
+                                }
+
+                                Label {
+                                    Layout.fillWidth: true
+                                    elide: Text.ElideLeft
+                                    font.pixelSize: 11
+                                    text: model.kind === "moved" ? model.leftPath + " -> " + model.rightPath
+                                                                 : model.leftPath || model.rightPath
+                                }
+
+                                Repeater {
+                                    model: properties
+
+                                    Label {
+                                        Layout.fillWidth: true
+                                        elide: Text.ElideRight
+                                        font.pixelSize: 11
+                                        font.family: "monospace"
+                                        text: modelData.name + ": " + modelData.left + " -> " + modelData.right
+                                    }
+                                }
+                            }
+                        }
+
+                        ScrollBar.vertical: ScrollBar {
+                            policy: ScrollBar.AsNeeded
+                        }
+                    }
+
+                    DiffShot {
+                        SplitView.preferredWidth: parent.width / 3
+                        location: diffModel.rightLocation
+                        side: DiffModel.Right
+                    }
+                }
+            }
         }
     }
 }
@@ -0,0 +1,322 @@
+#include "replayengine.h"
+#include "socketconnector.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+
+bool containsId(const QJsonObject &root, const QString &id)
+{
+    QVector<QJsonObject> stack {root};
+    while (!stack.isEmpty())
+    {
+        const QJsonObject node = stack.takeLast();
+        if (node.value(QStringLiteral("id")).toString() == id)
+        {
+            return true;
+        }
+
+        const QJsonArray children = node.value(QStringLiteral("children")).toArray();
+        for (const QJsonValue &child : children)
+        {
+            stack.append(child.toObject());
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ReplayEngine::ReplayEngine(SocketConnector *connector, QObject *parent)
+    : QObject(parent)
+    , m_connector(connector)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, [this]() { sendTap(m_next++); });
+
+    connect(m_connector, &SocketConnector::connectedChanged, this,
+            [this](bool connected)
+            {
+                if (!connected)
+                {
+                    stop();
+                }
+            });
+    connect(m_connector, &SocketConnector::analyzingChanged, this,
+            [this](bool analyzing)
+            {
+                if (analyzing)
+                {
+                    stop();
+                }
+            });
+}
+
+bool ReplayEngine::isRunning() const
+{
+    return m_running;
+}
+
+int ReplayEngine::stepCount() const
+{
+    return m_steps.size();
+}
+
+int ReplayEngine::completedSteps() const
+{
+    return m_completed;
+}
+
+int ReplayEngine::passedSteps() const
+{
+    return m_passed;
+}
+
+int ReplayEngine::failedSteps() const
+{
+    return m_failed;
+}
+
+QVariantList ReplayEngine::results() const
+{
+    QVariantList results;
+    for (const Step &step : m_steps)
+    {
+        results.append(QVariantMap {
+            { "location", step.location },
+            { "id", step.id },
+            { "verdict", step.verdict },
+            { "tapLatency", step.tapLatency },
+            { "verifyLatency", step.verifyLatency },
+        });
+    }
+    return results;
+}
+
+void ReplayEngine::start()
+{
+    if (m_running || !m_connector->isConnected() || m_connector->isAnalyzing())
+    {
+        return;
+    }
+
+    m_steps.clear();
+    const QList<QVariantMap> recordings = m_connector->manager()->recordings();
+    for (const QVariantMap &recording : recordings)
+    {
+        Step step;
+        step.location = recording.value("location").toString();
+        step.point = QPoint(recording.value("x").toInt(), recording.value("y").toInt());
+        step.id = recording.value("id").toString();
+        step.timestamp = recording.value("timestamp").toLongLong();
+        m_steps.append(step);
+    }
+
+    if (m_steps.isEmpty())
+    {
+        qWarning() << Q_FUNC_INFO << "Nothing to replay";
+        return;
+    }
+
+    ++m_generation;
+    m_next = 0;
+    m_completed = 0;
+    m_passed = 0;
+    m_failed = 0;
+    m_clock.start();
+
+    m_running = true;
+    emit runningChanged(true);
+    emit progressChanged();
+
+    scheduleNext();
+}
+
+void ReplayEngine::stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    // Replies and verification results of the aborted run are ignored.
+    ++m_generation;
+    m_timer->stop();
+
+    m_running = false;
+    emit runningChanged(false);
+}
+
+void ReplayEngine::scheduleNext()
+{
+    if (m_next >= m_steps.size())
+    {
+        return;
+    }
+
+    qint64 delay = 0;
+    if (m_speed > 0 && m_next > 0)
+    {
+        const Step &previous = m_steps.at(m_next - 1);
+        const qint64 recorded = m_steps.at(m_next).timestamp - previous.timestamp;
+        const qint64 spent = m_clock.elapsed() - previous.tapSentAt;
+        delay = qMax<qint64>(0, qint64(recorded / m_speed) - spent);
+    }
+
+    m_timer->start(int(delay));
+}
+
+void ReplayEngine::sendTap(int index)
+{
+    QAI_TRACE_SCOPE("replay", "tap");
+
+    Step &step = m_steps[index];
+
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("execute")));
+    json.insert(
+        QStringLiteral("params"),
+        QJsonValue::fromVariant(QVariantList{QStringLiteral("app:click"), QVariantList{step.point.x(), step.point.y()}}));
+
+    step.tapSentAt = m_clock.elapsed();
+
+    const quint64 generation = m_generation;
+    m_connector->sendControlRequest(json,
+                                    [this, index, generation](const SocketConnector::Reply &reply)
+                                    {
+                                        if (generation != m_generation)
+                                        {
+                                            return;
+                                        }
+
+                                        Step &step = m_steps[index];
+                                        step.tapLatency = int(m_clock.elapsed() - step.tapSentAt);
+
+                                        if (reply.status() != 0)
+                                        {
+                                            qWarning() << Q_FUNC_INFO << "Tap failed:" << step.location;
+                                            finishStep(index, Failed);
+                                            scheduleNext();
+                                            return;
+                                        }
+
+                                        if (step.id.isEmpty())
+                                        {
+                                            finishStep(index, Unverified);
+                                            scheduleNext();
+                                            return;
+                                        }
+
+                                        QTimer::singleShot(m_settleDelay, this,
+                                                           [this, index, generation]()
+                                                           {
+                                                               if (generation == m_generation)
+                                                               {
+                                                                   sendDump(index);
+                                                               }
+                                                           });
+                                    });
+}
+
+void ReplayEngine::sendDump(int index)
+{
+    m_steps[index].dumpSentAt = m_clock.elapsed();
+
+    const quint64 generation = m_generation;
+    m_connector->sendRequest(SocketConnector::dumpTreeRequest(m_filter),
+                             [this, index, generation](const SocketConnector::Reply &reply)
+                             {
+                                 if (generation == m_generation)
+                                 {
+                                     verify(index, reply);
+                                 }
+                             });
+
+    // Taps use the control connection, so the next one can go out now
+    // without waiting behind this dump.
+    scheduleNext();
+}
+
+void ReplayEngine::verify(int index, const SocketConnector::Reply &reply)
+{
+    const QString id = m_steps.at(index).id;
+    const quint64 generation = m_generation;
+
+    // Like DiffModel, the result goes through the application object and
+    // the engine is looked up on the GUI thread, where it may be destroyed.
+    const QPointer<ReplayEngine> engine(this);
+    QThreadPool::globalInstance()->start(
+        [engine, index, generation, reply, id]()
+        {
+            QAI_TRACE_SCOPE("replay", "verify");
+
+            const QByteArray dump = SocketConnector::decodeDump(reply);
+            const QJsonObject root = QJsonDocument::fromJson(dump).object();
+            const bool found = !root.isEmpty() && containsId(root, id);
+
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [engine, index, generation, found]()
+                {
+                    if (engine && generation == engine->m_generation)
+                    {
+                        engine->finishStep(index, found ? Passed : Failed);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+}
+
+void ReplayEngine::finishStep(int index, Verdict verdict)
+{
+    Step &step = m_steps[index];
+    step.verdict = verdict;
+    if (step.dumpSentAt > 0)
+    {
+        step.verifyLatency = int(m_clock.elapsed() - step.dumpSentAt);
+    }
+
+    ++m_completed;
+    if (verdict == Passed)
+    {
+        ++m_passed;
+    }
+    else if (verdict == Failed)
+    {
+        ++m_failed;
+    }
+
+    emit stepFinished(index, step.location, verdict, step.tapLatency, step.verifyLatency);
+    emit progressChanged();
+
+    if (m_completed < m_steps.size())
+    {
+        return;
+    }
+
+    QVector<int> latencies;
+    for (const Step &finished : std::as_const(m_steps))
+    {
+        latencies.append(finished.tapLatency);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    qInfo() << "Replay finished:" << m_steps.size() << "steps,"
+            << m_passed << "passed," << m_failed << "failed in" << m_clock.elapsed() << "ms,"
+            << "median tap latency" << latencies.at(latencies.size() / 2) << "ms";
+
+    m_running = false;
+    emit runningChanged(false);
+    emit finished(m_passed, m_failed, m_clock.elapsed());
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "socketconnector.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPoint>
+#include <QVariantList>
+#include <QVector>
+
+class QTimer;
+
+// Replays analyze recordings against the connected device. Every step taps
+// the recorded point and, when the recording was refined to an element id,
+// requests a fresh dump and checks that the id is present. Steps are
+// pipelined: the next tap goes out as soon as the previous dump request is
+// queued, while the previous dump is still being decoded and searched on the
+// thread pool.
+class ReplayEngine : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(qreal speed MEMBER m_speed NOTIFY speedChanged)
+    Q_PROPERTY(int settleDelay MEMBER m_settleDelay NOTIFY settleDelayChanged)
+    Q_PROPERTY(QString filter MEMBER m_filter NOTIFY filterChanged)
+    Q_PROPERTY(int stepCount READ stepCount NOTIFY progressChanged)
+    Q_PROPERTY(int completedSteps READ completedSteps NOTIFY progressChanged)
+    Q_PROPERTY(int passedSteps READ passedSteps NOTIFY progressChanged)
+    Q_PROPERTY(int failedSteps READ failedSteps NOTIFY progressChanged)
+public:
+    enum Verdict {
+        Pending,
+        Passed,
+        Failed,
+        Unverified
+    };
+    Q_ENUM(Verdict)
+
+    explicit ReplayEngine(SocketConnector *connector, QObject *parent = nullptr);
+
+    bool isRunning() const;
+    int stepCount() const;
+    int completedSteps() const;
+    int passedSteps() const;
+    int failedSteps() const;
+
+    Q_INVOKABLE QVariantList results() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void runningChanged(bool running);
+    void speedChanged();
+    void settleDelayChanged();
+    void filterChanged();
+    void progressChanged();
+
+    void stepFinished(int index, const QString &location, int verdict, int tapLatency, int verifyLatency);
+    void finished(int passed, int failed, qint64 elapsed);
+
+private:
+    struct Step
+    {
+        QString location;
+        QPoint point;
+        QString id;
+        qint64 timestamp = 0;
+        qint64 tapSentAt = 0;
+        qint64 dumpSentAt = 0;
+        int tapLatency = -1;
+        int verifyLatency = -1;
+        Verdict verdict = Pending;
+    };
+
+    void scheduleNext();
+    void sendTap(int index);
+    void sendDump(int index);
+    void verify(int index, const SocketConnector::Reply &reply);
+    void finishStep(int index, Verdict verdict);
+
+    SocketConnector *m_connector {};
+    QTimer *m_timer {};
+    QElapsedTimer m_clock;
+
+    QVector<Step> m_steps;
+    int m_next = 0;
+    int m_completed = 0;
+    int m_passed = 0;
+    int m_failed = 0;
+    quint64 m_generation = 0;
+    bool m_running = false;
+
+    qreal m_speed = 1.0;
+    int m_settleDelay = 300;
+    QString m_filter;
+};
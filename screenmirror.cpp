@@ -0,0 +1,469 @@
+#include "screenmirror.h"
+#include "screenprovider.h"
+#include "socketconnector.h"
+#include "tracer.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <algorithm>
+
+MirrorWorker::MirrorWorker(MirrorFrame *frame, QObject *parent)
+    : QObject(parent)
+    , m_frame(frame)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setTimerType(Qt::PreciseTimer);
+    m_timer->setInterval(100);
+    connect(m_timer, &QTimer::timeout, this, &MirrorWorker::onTick);
+}
+
+void MirrorWorker::start(const QString &hostName, quint16 port, const QString &applicationName)
+{
+    const QString serverName = SocketConnector::localServerName(hostName);
+    if (!serverName.isEmpty() && !m_localSocket)
+    {
+        m_localSocket = new QLocalSocket(this);
+        connect(m_localSocket, &QLocalSocket::connected, this, &MirrorWorker::onConnected);
+        connect(m_localSocket, &QLocalSocket::readyRead, this, &MirrorWorker::onReadyRead);
+        connect(m_localSocket, &QLocalSocket::disconnected, this, &MirrorWorker::stop);
+        connect(m_localSocket, &QLocalSocket::errorOccurred, this,
+                [this](QLocalSocket::LocalSocketError error)
+                {
+                    qWarning() << Q_FUNC_INFO << "Mirror connection error:" << error;
+                    stop();
+                });
+    }
+    else if (serverName.isEmpty() && !m_tcpSocket)
+    {
+        m_tcpSocket = new QTcpSocket(this);
+        connect(m_tcpSocket, &QTcpSocket::connected, this, &MirrorWorker::onConnected);
+        connect(m_tcpSocket, &QTcpSocket::readyRead, this, &MirrorWorker::onReadyRead);
+        connect(m_tcpSocket, &QTcpSocket::disconnected, this, &MirrorWorker::stop);
+        connect(m_tcpSocket, &QTcpSocket::errorOccurred, this,
+                [this](QAbstractSocket::SocketError error)
+                {
+                    qWarning() << Q_FUNC_INFO << "Mirror connection error:" << error;
+                    stop();
+                });
+    }
+
+    m_applicationName = applicationName;
+    m_buffer.clear();
+    m_scanned = 0;
+    m_sentAt.clear();
+    m_clock.start();
+
+    if (!serverName.isEmpty())
+    {
+        m_socket = m_localSocket;
+        m_localSocket->connectToServer(serverName);
+    }
+    else
+    {
+        m_socket = m_tcpSocket;
+        m_tcpSocket->connectToHost(hostName, port);
+    }
+}
+
+void MirrorWorker::stop()
+{
+    if (!m_socket)
+    {
+        return;
+    }
+
+    m_timer->stop();
+    m_sentAt.clear();
+    m_buffer.clear();
+    m_scanned = 0;
+    m_initializing = false;
+
+    if (m_socket == m_localSocket)
+    {
+        m_localSocket->abort();
+    }
+    else
+    {
+        m_tcpSocket->abort();
+    }
+    emit stopped();
+}
+
+void MirrorWorker::setTargetFps(int fps)
+{
+    m_timer->setInterval(1000 / qMax(1, fps));
+}
+
+void MirrorWorker::setMaxInFlight(int maxInFlight)
+{
+    m_maxInFlight = qMax(1, maxInFlight);
+}
+
+void MirrorWorker::setScreenshotTier(const QString &tier, int quality)
+{
+    m_tiers.setMode(ScreenshotTiers::tierFromName(tier));
+    m_tiers.setQuality(quality);
+}
+
+void MirrorWorker::onConnected()
+{
+    // The mirror uses its own connection, so it has to go through the same
+    // handshake as SocketConnector before requesting frames.
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("initialize")));
+    json.insert(QStringLiteral("params"), QJsonValue::fromVariant(QStringList({m_applicationName})));
+    // Replies on this connection are JSON lines, so raw pixels would go
+    // out as uncompressed base64.
+    json.insert(QStringLiteral("screenshot"), ScreenshotTiers::offer(false));
+
+    m_socket->write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    m_socket->write("\n", 1);
+    m_initializing = true;
+}
+
+void MirrorWorker::onTick()
+{
+    if (m_initializing || m_sentAt.size() >= m_maxInFlight)
+    {
+        return;
+    }
+
+    const QJsonObject json = m_tiers.request(m_tiers.next());
+
+    m_socket->write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    m_socket->write("\n", 1);
+    m_sentAt.enqueue(m_clock.elapsed());
+}
+
+void MirrorWorker::onReadyRead()
+{
+    m_buffer.append(m_socket->readAll());
+
+    QByteArray latest;
+    qint64 latestSentAt = 0;
+
+    // A frame arrives in many chunks; only the new bytes are searched.
+    qsizetype from = 0;
+    qsizetype newline = m_buffer.indexOf('\n', m_scanned);
+    while (newline >= 0)
+    {
+        const QByteArray line = m_buffer.mid(from, newline - from);
+        from = newline + 1;
+        newline = m_buffer.indexOf('\n', from);
+
+        if (m_initializing)
+        {
+            qDebug().noquote() << Q_FUNC_INFO << line;
+            m_tiers.negotiate(QJsonDocument::fromJson(line).object(), false);
+            m_initializing = false;
+            m_timer->start();
+            continue;
+        }
+
+        if (m_sentAt.isEmpty())
+        {
+            qWarning() << Q_FUNC_INFO << "Unexpected reply of" << line.size() << "bytes";
+            continue;
+        }
+
+        // Replies arrive in request order; only the newest one is worth decoding.
+        if (!latest.isEmpty())
+        {
+            ++m_frame->dropped;
+        }
+        latest = line;
+        latestSentAt = m_sentAt.dequeue();
+    }
+    m_buffer.remove(0, from);
+    m_scanned = m_buffer.size();
+
+    if (!latest.isEmpty())
+    {
+        decode(latest, latestSentAt);
+    }
+}
+
+void MirrorWorker::decode(const QByteArray &line, qint64 sentAt)
+{
+    QAI_TRACE_SCOPE("mirror", "decode");
+
+    const SocketConnector::Reply reply = SocketConnector::parseReply(line);
+    if (reply.status() != 0)
+    {
+        qWarning() << Q_FUNC_INFO << "Screenshot request failed:" << reply.object.value(QStringLiteral("value"));
+        return;
+    }
+
+    const QByteArray data = SocketConnector::decodeScreenshot(reply);
+
+    QSize decodeSize;
+    {
+        QMutexLocker locker(&m_frame->mutex);
+        decodeSize = m_frame->decodeSize;
+    }
+
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+
+    const QSize sourceSize = reader.size();
+    if (decodeSize.isValid() && sourceSize.isValid())
+    {
+        const QSize scaled = sourceSize.scaled(decodeSize, Qt::KeepAspectRatio);
+        if (scaled.width() < sourceSize.width() && !scaled.isEmpty())
+        {
+            reader.setScaledSize(scaled);
+        }
+    }
+
+    QImage image;
+    if (!reader.read(&image))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to decode frame of" << data.size() << "bytes:" << reader.errorString();
+        return;
+    }
+
+    bool notify = false;
+    {
+        QMutexLocker locker(&m_frame->mutex);
+        if (m_frame->pending)
+        {
+            ++m_frame->dropped;
+        }
+        m_frame->image = image;
+        m_frame->sourceSize = sourceSize;
+        m_frame->latency = m_clock.elapsed() - sentAt;
+        m_tiers.addSample(reply.object.value(QStringLiteral("format")).toString(), m_frame->latency);
+        notify = !m_frame->pending;
+        m_frame->pending = true;
+    }
+
+    if (notify)
+    {
+        emit frameAvailable();
+    }
+}
+
+ScreenMirror::ScreenMirror(SocketConnector *connector, ScreenshotStore *store, QObject *parent)
+    : QObject(parent)
+    , m_connector(connector)
+    , m_store(store)
+    , m_worker(new MirrorWorker(&m_frame))
+    , m_statsTimer(new QTimer(this))
+{
+    // Frames only prune the window when they arrive, so the rate would
+    // freeze at its last value once they stop.
+    m_statsTimer->setInterval(500);
+    connect(m_statsTimer, &QTimer::timeout, this, &ScreenMirror::onStatsTick);
+
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &MirrorWorker::frameAvailable, this, &ScreenMirror::onFrameAvailable);
+    connect(m_worker, &MirrorWorker::stopped, this, &ScreenMirror::onStopped);
+
+    connect(m_connector, &SocketConnector::connectedChanged, this,
+            [this](bool connected)
+            {
+                if (!connected)
+                {
+                    stop();
+                }
+            });
+
+    m_thread.setObjectName(QStringLiteral("ScreenMirror"));
+    m_thread.start();
+
+    m_clock.start();
+}
+
+ScreenMirror::~ScreenMirror()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool ScreenMirror::isRunning() const
+{
+    return m_running;
+}
+
+int ScreenMirror::targetFps() const
+{
+    return m_targetFps;
+}
+
+void ScreenMirror::setTargetFps(int fps)
+{
+    if (m_targetFps == fps)
+    {
+        return;
+    }
+
+    m_targetFps = fps;
+    QMetaObject::invokeMethod(m_worker, [this, fps]() { m_worker->setTargetFps(fps); });
+    emit targetFpsChanged();
+}
+
+int ScreenMirror::maxInFlight() const
+{
+    return m_maxInFlight;
+}
+
+void ScreenMirror::setMaxInFlight(int maxInFlight)
+{
+    if (m_maxInFlight == maxInFlight)
+    {
+        return;
+    }
+
+    m_maxInFlight = maxInFlight;
+    QMetaObject::invokeMethod(m_worker, [this, maxInFlight]() { m_worker->setMaxInFlight(maxInFlight); });
+    emit maxInFlightChanged();
+}
+
+QSize ScreenMirror::decodeSize() const
+{
+    QMutexLocker locker(&m_frame.mutex);
+    return m_frame.decodeSize;
+}
+
+void ScreenMirror::setDecodeSize(const QSize &size)
+{
+    {
+        QMutexLocker locker(&m_frame.mutex);
+        if (m_frame.decodeSize == size)
+        {
+            return;
+        }
+        m_frame.decodeSize = size;
+    }
+
+    emit decodeSizeChanged();
+}
+
+qreal ScreenMirror::achievedFps() const
+{
+    const qint64 now = m_clock.elapsed();
+    return std::count_if(m_presented.cbegin(), m_presented.cend(),
+                         [now](qint64 presentedAt) { return now - presentedAt <= 1000; });
+}
+
+qreal ScreenMirror::latency() const
+{
+    return m_latency;
+}
+
+int ScreenMirror::droppedFrames() const
+{
+    return m_frame.dropped;
+}
+
+void ScreenMirror::start()
+{
+    if (m_running || !m_connector->isConnected())
+    {
+        return;
+    }
+
+    const QString hostName = m_connector->property("hostname").toString();
+    const quint16 port = m_connector->property("port").toString().toUShort();
+    const QString applicationName = m_connector->property("applicationName").toString();
+    const int fps = m_targetFps;
+    const int maxInFlight = m_maxInFlight;
+    const QString tier = m_connector->screenshotTier();
+    const int quality = m_connector->screenshotQuality();
+
+    m_frame.dropped = 0;
+    m_presentedCount = 0;
+    m_presented.clear();
+    m_latency = 0.0;
+
+    QMetaObject::invokeMethod(m_worker,
+                              [=]()
+                              {
+                                  m_worker->setTargetFps(fps);
+                                  m_worker->setMaxInFlight(maxInFlight);
+                                  m_worker->setScreenshotTier(tier, quality);
+                                  m_worker->start(hostName, port, applicationName);
+                              });
+
+    m_running = true;
+    m_statsTimer->start();
+    emit runningChanged(true);
+    emit statsChanged();
+}
+
+void ScreenMirror::stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_worker, &MirrorWorker::stop);
+}
+
+void ScreenMirror::onFrameAvailable()
+{
+    QImage image;
+    QSize sourceSize;
+    qint64 frameLatency = 0;
+    {
+        QMutexLocker locker(&m_frame.mutex);
+        image = m_frame.image;
+        sourceSize = m_frame.sourceSize;
+        frameLatency = m_frame.latency;
+        m_frame.pending = false;
+    }
+
+    m_store->setImage(image, sourceSize);
+
+    const qint64 now = m_clock.elapsed();
+    m_presented.enqueue(now);
+    prunePresented(now);
+    m_latency = m_presentedCount == 0 ? frameLatency : m_latency * 0.8 + frameLatency * 0.2;
+
+    ++m_presentedCount;
+    emit statsChanged();
+}
+
+void ScreenMirror::onStopped()
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    m_running = false;
+    m_statsTimer->stop();
+    m_presented.clear();
+    emit runningChanged(false);
+    emit statsChanged();
+}
+
+void ScreenMirror::onStatsTick()
+{
+    const int presented = m_presented.size();
+    prunePresented(m_clock.elapsed());
+    if (m_presented.size() != presented)
+    {
+        emit statsChanged();
+    }
+}
+
+void ScreenMirror::prunePresented(qint64 now)
+{
+    while (!m_presented.isEmpty() && now - m_presented.head() > 1000)
+    {
+        m_presented.dequeue();
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QThread>
+
+#include <atomic>
+
+#include "screenshottiers.h"
+
+class QLocalSocket;
+class QTcpSocket;
+class QTimer;
+class ScreenshotStore;
+class SocketConnector;
+
+// Hand-over point between the worker and the GUI thread. Only the most
+// recently decoded frame is kept; frames decoded while the previous one is
+// still waiting to be picked up replace it and count as dropped.
+struct MirrorFrame
+{
+    mutable QMutex mutex;
+    QImage image;
+    QSize sourceSize;
+    QSize decodeSize;
+    qint64 latency = 0;
+    bool pending = false;
+    std::atomic<int> dropped {0};
+};
+
+class MirrorWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MirrorWorker(MirrorFrame *frame, QObject *parent = nullptr);
+
+public slots:
+    void start(const QString &hostName, quint16 port, const QString &applicationName);
+    void stop();
+    void setTargetFps(int fps);
+    void setMaxInFlight(int maxInFlight);
+    void setScreenshotTier(const QString &tier, int quality);
+
+signals:
+    void frameAvailable();
+    void stopped();
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onTick();
+
+private:
+    void decode(const QByteArray &line, qint64 sentAt);
+
+    MirrorFrame *m_frame {};
+    // The same transport as SocketConnector: a Unix domain socket for
+    // unix:<path> hosts, TCP otherwise. m_socket is the one in use.
+    QTcpSocket *m_tcpSocket {};
+    QLocalSocket *m_localSocket {};
+    QIODevice *m_socket {};
+    QTimer *m_timer {};
+    QElapsedTimer m_clock;
+
+    QString m_applicationName;
+    QByteArray m_buffer;
+    // Bytes of m_buffer already searched for a newline.
+    qsizetype m_scanned = 0;
+    QQueue<qint64> m_sentAt;
+    bool m_initializing = false;
+    int m_maxInFlight = 2;
+    ScreenshotTiers m_tiers;
+};
+
+class ScreenMirror : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(int targetFps READ targetFps WRITE setTargetFps NOTIFY targetFpsChanged)
+    Q_PROPERTY(int maxInFlight READ maxInFlight WRITE setMaxInFlight NOTIFY maxInFlightChanged)
+    Q_PROPERTY(QSize decodeSize READ decodeSize WRITE setDecodeSize NOTIFY decodeSizeChanged)
+    Q_PROPERTY(qreal achievedFps READ achievedFps NOTIFY statsChanged)
+    Q_PROPERTY(qreal latency READ latency NOTIFY statsChanged)
+    Q_PROPERTY(int droppedFrames READ droppedFrames NOTIFY statsChanged)
+public:
+    ScreenMirror(SocketConnector *connector, ScreenshotStore *store, QObject *parent = nullptr);
+    ~ScreenMirror() override;
+
+    bool isRunning() const;
+
+    int targetFps() const;
+    void setTargetFps(int fps);
+
+    int maxInFlight() const;
+    void setMaxInFlight(int maxInFlight);
+
+    QSize decodeSize() const;
+    void setDecodeSize(const QSize &size);
+
+    qreal achievedFps() const;
+    qreal latency() const;
+    int droppedFrames() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void runningChanged(bool running);
+    void targetFpsChanged();
+    void maxInFlightChanged();
+    void decodeSizeChanged();
+    void statsChanged();
+
+private slots:
+    void onFrameAvailable();
+    void onStopped();
+    void onStatsTick();
+
+private:
+    void prunePresented(qint64 now);
+
+    SocketConnector *m_connector {};
+    ScreenshotStore *m_store {};
+    MirrorFrame m_frame;
+
+    QThread m_thread;
+    MirrorWorker *m_worker {};
+
+    bool m_running = false;
+    int m_targetFps = 10;
+    int m_maxInFlight = 2;
+
+    int m_presentedCount = 0;
+    QElapsedTimer m_clock;
+    QTimer *m_statsTimer {};
+    QQueue<qint64> m_presented;
+    qreal m_latency = 0.0;
+};
@@ -0,0 +1,156 @@
+#include "screenprovider.h"
+#include "tracer.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QFile>
+#include <QImageReader>
+
+ScreenshotStore::ScreenshotStore(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QSize ScreenshotStore::imageSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_imageSize;
+}
+
+QString ScreenshotStore::source() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_imageSize.isEmpty())
+    {
+        return QString();
+    }
+    return QStringLiteral("image://screen/shot/%1").arg(m_serial);
+}
+
+QImage ScreenshotStore::image(const QSize &requestedSize, QSize *originalSize) const
+{
+    QAI_TRACE_SCOPE("screenshot", "decode");
+
+    QByteArray data;
+    QImage image;
+    {
+        QMutexLocker locker(&m_mutex);
+        data = m_data;
+        image = m_image;
+        if (originalSize)
+        {
+            *originalSize = m_imageSize;
+        }
+    }
+
+    if (!image.isNull() || data.isEmpty())
+    {
+        return image;
+    }
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+
+    // Only ever scale down: zooming in past the painted size decodes the full image.
+    const QSize size = reader.size();
+    if (requestedSize.isValid() && size.isValid())
+    {
+        const QSize scaled = size.scaled(requestedSize, Qt::KeepAspectRatio);
+        if (scaled.width() < size.width() && !scaled.isEmpty())
+        {
+            reader.setScaledSize(scaled);
+        }
+    }
+
+    if (!reader.read(&image))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to decode screenshot:" << reader.errorString();
+    }
+    return image;
+}
+
+QByteArray ScreenshotStore::data() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_data;
+}
+
+void ScreenshotStore::setData(const QByteArray &data)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    const QSize size = QImageReader(&buffer).size();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_data = data;
+        m_image = QImage();
+        m_imageSize = size;
+        ++m_serial;
+    }
+
+    emit changed();
+}
+
+void ScreenshotStore::setBase64(const QString &b64)
+{
+    setData(QByteArray::fromBase64(b64.toLatin1()));
+}
+
+void ScreenshotStore::loadFile(const QString &location)
+{
+    QFile file(location);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to open file:" << file.fileName();
+        clear();
+        return;
+    }
+
+    setData(file.readAll());
+}
+
+void ScreenshotStore::setImage(const QImage &image, const QSize &originalSize)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_data.clear();
+        m_image = image;
+        m_imageSize = originalSize.isValid() ? originalSize : image.size();
+        ++m_serial;
+    }
+
+    emit changed();
+}
+
+void ScreenshotStore::clear()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_data.clear();
+        m_image = QImage();
+        m_imageSize = QSize();
+        ++m_serial;
+    }
+
+    emit changed();
+}
+
+ScreenProvider::ScreenProvider(ScreenshotStore *store)
+    : QQuickImageProvider(QQuickImageProvider::Image)
+    , m_store(store)
+{
+}
+
+QImage ScreenProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    if (!id.startsWith(QLatin1String("shot/")))
+    {
+        qWarning() << Q_FUNC_INFO << "Unknown image id:" << id;
+        return QImage();
+    }
+
+    return m_store->image(requestedSize, size);
+}
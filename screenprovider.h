@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QQuickImageProvider>
+
+// Holds the screenshot currently shown by the inspector. Encoded screenshots
+// are kept as-is and only decoded by the image provider, at the size the
+// view asks for; live mirror frames arrive already decoded.
+class ScreenshotStore : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QSize imageSize READ imageSize NOTIFY changed)
+    Q_PROPERTY(QString source READ source NOTIFY changed)
+public:
+    explicit ScreenshotStore(QObject *parent = nullptr);
+
+    QSize imageSize() const;
+    QString source() const;
+    // Encoded screenshot as received; empty for live mirror frames.
+    QByteArray data() const;
+
+    QImage image(const QSize &requestedSize, QSize *originalSize) const;
+
+public slots:
+    void setData(const QByteArray &data);
+    void setBase64(const QString &b64);
+    void loadFile(const QString &location);
+    void setImage(const QImage &image, const QSize &originalSize);
+    void clear();
+
+signals:
+    void changed();
+
+private:
+    mutable QMutex m_mutex;
+    QByteArray m_data;
+    QImage m_image;
+    QSize m_imageSize;
+    int m_serial = 0;
+};
+
+// Serves image://screen/shot/<serial> from the ScreenshotStore.
+class ScreenProvider : public QQuickImageProvider
+{
+public:
+    explicit ScreenProvider(ScreenshotStore *store);
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+private:
+    ScreenshotStore *m_store {};
+};
@@ -0,0 +1,223 @@
+#include "screenshottiers.h"
+
+#include <QImageReader>
+#include <QJsonArray>
+
+namespace {
+
+// Every this many live requests the slower interactive tier is tried again,
+// so a change in link or load is noticed.
+const int s_probeInterval = 16;
+const double s_smoothing = 0.2;
+
+const QStringList s_lossyFormats {QStringLiteral("jpeg"), QStringLiteral("webp")};
+const QLatin1String s_rawFormat("ppm");
+const QLatin1String s_losslessFormat("png");
+
+} // namespace
+
+ScreenshotTiers::ScreenshotTiers()
+{
+    reset();
+}
+
+QJsonObject ScreenshotTiers::offer(bool raw)
+{
+    const QList<QByteArray> decodable = QImageReader::supportedImageFormats();
+
+    QJsonArray formats;
+    for (const QString &format : s_lossyFormats)
+    {
+        if (decodable.contains(format.toLatin1()))
+        {
+            formats.append(format);
+        }
+    }
+    if (raw)
+    {
+        formats.append(s_rawFormat);
+    }
+    formats.append(s_losslessFormat);
+
+    return QJsonObject {{ "formats", formats }};
+}
+
+void ScreenshotTiers::negotiate(const QJsonObject &initializeReply, bool raw)
+{
+    reset();
+
+    const QJsonArray accepted =
+        initializeReply.value(QStringLiteral("screenshot")).toObject().value(QStringLiteral("formats")).toArray();
+    m_negotiated = !accepted.isEmpty();
+    if (!m_negotiated)
+    {
+        return;
+    }
+
+    for (const QString &format : s_lossyFormats)
+    {
+        if (accepted.contains(format))
+        {
+            m_formats[Lossy] = format;
+            break;
+        }
+    }
+    if (raw && accepted.contains(s_rawFormat))
+    {
+        m_formats[Raw] = s_rawFormat;
+    }
+}
+
+void ScreenshotTiers::reset()
+{
+    m_negotiated = false;
+    for (int tier = 0; tier < s_tiers; ++tier)
+    {
+        m_formats[tier].clear();
+        m_latency[tier] = 0.0;
+        m_samples[tier] = 0;
+    }
+    m_formats[Lossless] = s_losslessFormat;
+    m_requests = 0;
+}
+
+QString ScreenshotTiers::tierName(Tier tier)
+{
+    switch (tier)
+    {
+    case Lossless:
+        return QStringLiteral("lossless");
+    case Lossy:
+        return QStringLiteral("lossy");
+    case Raw:
+        return QStringLiteral("raw");
+    case Auto:
+        return QStringLiteral("auto");
+    }
+    return QString();
+}
+
+ScreenshotTiers::Tier ScreenshotTiers::tierFromName(const QString &name, bool *ok)
+{
+    for (Tier tier : {Lossless, Lossy, Raw, Auto})
+    {
+        if (name == tierName(tier))
+        {
+            if (ok)
+            {
+                *ok = true;
+            }
+            return tier;
+        }
+    }
+    if (ok)
+    {
+        *ok = false;
+    }
+    return Auto;
+}
+
+ScreenshotTiers::Tier ScreenshotTiers::mode() const
+{
+    return m_mode;
+}
+
+void ScreenshotTiers::setMode(Tier mode)
+{
+    m_mode = mode;
+}
+
+int ScreenshotTiers::quality() const
+{
+    return m_quality;
+}
+
+void ScreenshotTiers::setQuality(int quality)
+{
+    m_quality = qBound(1, quality, 100);
+}
+
+QString ScreenshotTiers::format(Tier tier) const
+{
+    return tier >= 0 && tier < s_tiers ? m_formats[tier] : QString();
+}
+
+ScreenshotTiers::Tier ScreenshotTiers::next()
+{
+    if (m_mode != Auto)
+    {
+        return m_formats[m_mode].isEmpty() ? Lossless : m_mode;
+    }
+
+    const bool lossy = !m_formats[Lossy].isEmpty();
+    const bool raw = !m_formats[Raw].isEmpty();
+    if (!lossy || !raw)
+    {
+        return lossy ? Lossy : raw ? Raw : Lossless;
+    }
+
+    // Measure both before trusting either average.
+    if (m_samples[Lossy] == 0)
+    {
+        return Lossy;
+    }
+    if (m_samples[Raw] == 0)
+    {
+        return Raw;
+    }
+
+    const Tier faster = m_latency[Lossy] <= m_latency[Raw] ? Lossy : Raw;
+    if (++m_requests % s_probeInterval == 0)
+    {
+        return faster == Lossy ? Raw : Lossy;
+    }
+    return faster;
+}
+
+QJsonObject ScreenshotTiers::request(Tier tier) const
+{
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("getScreenshot")));
+
+    const QString format = this->format(tier);
+    if (!m_negotiated || format.isEmpty())
+    {
+        json.insert(QStringLiteral("params"), QJsonValue(QString()));
+        return json;
+    }
+
+    QJsonObject params {{ "format", format }};
+    if (tier == Lossy)
+    {
+        params.insert(QStringLiteral("quality"), m_quality);
+    }
+    json.insert(QStringLiteral("params"), params);
+    return json;
+}
+
+bool ScreenshotTiers::isLossless(const QByteArray &data)
+{
+    static const QByteArray signature("\x89PNG\r\n\x1a\n", 8);
+    return data.startsWith(signature);
+}
+
+QString ScreenshotTiers::replyFormat(const QJsonObject &reply)
+{
+    return reply.value(QStringLiteral("format")).toString(s_losslessFormat);
+}
+
+void ScreenshotTiers::addSample(const QString &format, qint64 msecs)
+{
+    for (int tier = 0; tier < s_tiers; ++tier)
+    {
+        if (!format.isEmpty() && m_formats[tier] == format)
+        {
+            m_latency[tier] = m_samples[tier] == 0
+                ? double(msecs)
+                : m_latency[tier] + s_smoothing * (double(msecs) - m_latency[tier]);
+            ++m_samples[tier];
+            return;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+// Picks the format screenshots are requested in. Lossless PNG is what
+// recordings and diffs need. Live views can use a lossy JPEG or WebP, or raw
+// pixels as PPM that only the frame codec compresses; both are cheaper to
+// encode on the device and to decode here. Which of those two is faster
+// depends on the link, so in Auto mode each keeps a moving average of its
+// frame latency and the faster one is used, with the other one retried
+// every so often.
+//
+// Formats this side decodes are offered during initialize as
+// "screenshot": {"formats": [...]}. A target that answers with the subset
+// it encodes takes {"format": ..., "quality": ...} as getScreenshot params
+// and names the format in its reply. Without that answer only the legacy
+// request is sent and PNG comes back.
+class ScreenshotTiers
+{
+public:
+    enum Tier
+    {
+        Lossless,
+        Lossy,
+        Raw,
+        Auto,
+    };
+
+    ScreenshotTiers();
+
+    // Raw pixels are only worth offering when the payload is compressed.
+    static QJsonObject offer(bool raw);
+    void negotiate(const QJsonObject &initializeReply, bool raw);
+    void reset();
+
+    static QString tierName(Tier tier);
+    static Tier tierFromName(const QString &name, bool *ok = nullptr);
+
+    Tier mode() const;
+    void setMode(Tier mode);
+    int quality() const;
+    void setQuality(int quality);
+
+    // Empty when the tier is not available.
+    QString format(Tier tier) const;
+
+    // Tier for the next live screenshot, and the request for a tier.
+    Tier next();
+    QJsonObject request(Tier tier) const;
+
+    // Frame latency measured for a reply in format.
+    void addSample(const QString &format, qint64 msecs);
+
+    // Whether an encoded screenshot is PNG, the only format kept beyond the
+    // live view.
+    static bool isLossless(const QByteArray &data);
+    // Format named in a getScreenshot reply; legacy replies are PNG.
+    static QString replyFormat(const QJsonObject &reply);
+
+private:
+    static constexpr int s_tiers = Auto;
+
+    bool m_negotiated = false;
+    QString m_formats[s_tiers];
+    double m_latency[s_tiers] {};
+    int m_samples[s_tiers] {};
+    int m_requests = 0;
+
+    Tier m_mode = Auto;
+    int m_quality = 75;
+};
@@ -0,0 +1,562 @@
+#include "selector.h"
+#include "mytreemodel2.h"
+#include "parallelfor.h"
+#include "tracer.h"
+
+#include <QThreadPool>
+
+#include <algorithm>
+
+// Recursive descent over the selector text.
+class SelectorParser
+{
+public:
+    explicit SelectorParser(const QString &text)
+        : m_text(text)
+    {
+    }
+
+    bool parse(QVector<Selector::Step> *steps)
+    {
+        skipSpaces();
+        while (true)
+        {
+            const int first = steps->size();
+            if (!parseAlternative(steps))
+            {
+                return false;
+            }
+            (*steps)[first].first = true;
+            steps->last().last = true;
+
+            skipSpaces();
+            if (atEnd())
+            {
+                return true;
+            }
+            if (!expect(QLatin1Char(',')))
+            {
+                return false;
+            }
+            skipSpaces();
+        }
+    }
+
+    QString error() const
+    {
+        return m_error;
+    }
+
+private:
+    bool parseAlternative(QVector<Selector::Step> *steps)
+    {
+        bool child = false;
+        while (true)
+        {
+            Selector::Step step;
+            if (!parseCompound(&step))
+            {
+                return false;
+            }
+            step.child = child;
+            steps->append(step);
+
+            const bool spaced = skipSpaces();
+            if (atEnd() || peek() == QLatin1Char(','))
+            {
+                return true;
+            }
+            child = peek() == QLatin1Char('>');
+            if (child)
+            {
+                ++m_pos;
+                skipSpaces();
+            }
+            else if (!spaced)
+            {
+                return fail(QStringLiteral("Unexpected '%1'").arg(peek()));
+            }
+        }
+    }
+
+    bool parseCompound(Selector::Step *step)
+    {
+        const int start = m_pos;
+        if (peek() == QLatin1Char('*'))
+        {
+            ++m_pos;
+        }
+        else
+        {
+            step->classname = identifier();
+        }
+
+        while (!atEnd())
+        {
+            const QChar c = peek();
+            if (c == QLatin1Char('['))
+            {
+                ++m_pos;
+                Selector::Condition condition;
+                if (!parseCondition(&condition))
+                {
+                    return false;
+                }
+                step->conditions.append(condition);
+            }
+            else if (c == QLatin1Char('#'))
+            {
+                ++m_pos;
+                Selector::Condition condition;
+                condition.key = QStringLiteral("objectName");
+                condition.op = Selector::Op::Equals;
+                condition.value = identifier();
+                if (condition.value.isEmpty())
+                {
+                    return fail(QStringLiteral("Expected an objectName"));
+                }
+                step->conditions.append(condition);
+            }
+            else if (c == QLatin1Char(':'))
+            {
+                ++m_pos;
+                const QString pseudo = identifier();
+                if (pseudo == QLatin1String("visible"))
+                {
+                    step->flags |= MyTreeModel2::NodeVisible;
+                }
+                else if (pseudo == QLatin1String("hittable"))
+                {
+                    step->flags |= MyTreeModel2::NodeHitTestable;
+                }
+                else
+                {
+                    return fail(QStringLiteral("Unknown pseudo class ':%1'").arg(pseudo));
+                }
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (m_pos == start)
+        {
+            return fail(atEnd() ? QStringLiteral("Expected a selector")
+                                : QStringLiteral("Unexpected '%1'").arg(peek()));
+        }
+        return true;
+    }
+
+    bool parseCondition(Selector::Condition *condition)
+    {
+        skipSpaces();
+        condition->key = identifier();
+        if (condition->key.isEmpty())
+        {
+            return fail(QStringLiteral("Expected a property name"));
+        }
+        skipSpaces();
+        if (peek() == QLatin1Char(']'))
+        {
+            ++m_pos;
+            return true;
+        }
+
+        static const struct
+        {
+            const char *text;
+            Selector::Op op;
+        } ops[] = {
+            {"!=", Selector::Op::NotEquals},
+            {"*=", Selector::Op::Contains},
+            {"^=", Selector::Op::Prefix},
+            {"$=", Selector::Op::Suffix},
+            {"~=", Selector::Op::Regex},
+            {"=", Selector::Op::Equals},
+        };
+        bool found = false;
+        for (const auto &op : ops)
+        {
+            const QLatin1String text(op.text);
+            if (QStringView(m_text).mid(m_pos).startsWith(text))
+            {
+                condition->op = op.op;
+                m_pos += text.size();
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            return fail(QStringLiteral("Expected an operator"));
+        }
+
+        skipSpaces();
+        const QChar quote = peek();
+        if (quote == QLatin1Char('"') || quote == QLatin1Char('\''))
+        {
+            const int end = m_text.indexOf(quote, m_pos + 1);
+            if (end < 0)
+            {
+                return fail(QStringLiteral("Unterminated string"));
+            }
+            condition->value = m_text.mid(m_pos + 1, end - m_pos - 1);
+            m_pos = end + 1;
+        }
+        else
+        {
+            const int end = m_text.indexOf(QLatin1Char(']'), m_pos);
+            if (end < 0)
+            {
+                return fail(QStringLiteral("Expected ']'"));
+            }
+            condition->value = m_text.mid(m_pos, end - m_pos).trimmed();
+            m_pos = end;
+        }
+        skipSpaces();
+        if (!expect(QLatin1Char(']')))
+        {
+            return false;
+        }
+
+        condition->number = condition->value.toDouble(&condition->isNumber);
+        if (condition->value == QLatin1String("true") || condition->value == QLatin1String("1"))
+        {
+            condition->boolean = 1;
+        }
+        else if (condition->value == QLatin1String("false") || condition->value == QLatin1String("0"))
+        {
+            condition->boolean = 0;
+        }
+        if (condition->op == Selector::Op::Regex)
+        {
+            condition->regex.setPattern(condition->value);
+            if (!condition->regex.isValid())
+            {
+                return fail(QStringLiteral("Invalid regular expression: %1").arg(condition->regex.errorString()));
+            }
+            condition->regex.optimize();
+        }
+        return true;
+    }
+
+    QString identifier()
+    {
+        const int start = m_pos;
+        while (!atEnd() && (peek().isLetterOrNumber() || peek() == QLatin1Char('_') ||
+                            peek() == QLatin1Char('-') || peek() == QLatin1Char('.')))
+        {
+            ++m_pos;
+        }
+        return m_text.mid(start, m_pos - start);
+    }
+
+    bool skipSpaces()
+    {
+        const int start = m_pos;
+        while (!atEnd() && peek().isSpace())
+        {
+            ++m_pos;
+        }
+        return m_pos != start;
+    }
+
+    bool expect(QChar c)
+    {
+        if (peek() != c)
+        {
+            return fail(atEnd() ? QStringLiteral("Expected '%1'").arg(c)
+                                : QStringLiteral("Expected '%1' instead of '%2'").arg(c, peek()));
+        }
+        ++m_pos;
+        return true;
+    }
+
+    bool fail(const QString &message)
+    {
+        m_error = QStringLiteral("%1 at column %2").arg(message).arg(m_pos + 1);
+        return false;
+    }
+
+    bool atEnd() const
+    {
+        return m_pos >= m_text.size();
+    }
+
+    QChar peek() const
+    {
+        return atEnd() ? QChar() : m_text.at(m_pos);
+    }
+
+    const QString &m_text;
+    int m_pos = 0;
+    QString m_error;
+};
+
+// Binds a compiled selector to the columns of one model and runs it.
+class SelectorEvaluator
+{
+public:
+    SelectorEvaluator(const Selector &selector, const MyTreeModel2 *model)
+        : m_model(model)
+    {
+        for (int i = 0; i < selector.m_steps.size(); ++i)
+        {
+            const Selector::Step &step = selector.m_steps.at(i);
+
+            BoundStep bound;
+            bound.step = &step;
+            bound.classId = step.classname.isEmpty() ? AnyClass : model->classId(step.classname);
+            bound.bit = 1u << i;
+            bound.previousBit = i > 0 ? 1u << (i - 1) : 0;
+            for (const Selector::Condition &condition : step.conditions)
+            {
+                bound.columns.append(model->propertyColumn(condition.key));
+            }
+            m_steps.append(bound);
+
+            if (step.last)
+            {
+                m_lastMask |= bound.bit;
+            }
+        }
+
+        m_reach.resize(model->nodeCount());
+        m_inherited.resize(model->nodeCount());
+    }
+
+    QVector<int> run(int grain)
+    {
+        const int count = m_model->nodeCount();
+        if (count < 2 * grain || QThreadPool::globalInstance()->maxThreadCount() < 2)
+        {
+            QVector<int> matches;
+            for (int position = 0; position < count; ++position)
+            {
+                evaluate(position, &matches);
+            }
+            return matches;
+        }
+
+        // Nodes on the way to subtrees smaller than the grain are evaluated
+        // first; the subtrees then only depend on already computed parents.
+        QVector<int> spine;
+        QVector<int> chunks;
+        QVector<int> stack;
+        for (int position = 0; position < count; position += m_model->subtreeSizeAt(position) + 1)
+        {
+            stack.prepend(position);
+        }
+        while (!stack.isEmpty())
+        {
+            const int position = stack.takeLast();
+            const int size = m_model->subtreeSizeAt(position);
+            if (size < grain)
+            {
+                chunks.append(position);
+                continue;
+            }
+            spine.append(position);
+            QVector<int> children;
+            for (int child = position + 1; child <= position + size; child += m_model->subtreeSizeAt(child) + 1)
+            {
+                children.append(child);
+            }
+            for (auto it = children.crbegin(); it != children.crend(); ++it)
+            {
+                stack.append(*it);
+            }
+        }
+
+        QVector<int> matches;
+        for (int position : std::as_const(spine))
+        {
+            evaluate(position, &matches);
+        }
+
+        QVector<QVector<int>> chunkMatches(chunks.size());
+        parallelFor(chunks.size(),
+                    [&](int i)
+                    {
+                        const int first = chunks.at(i);
+                        const int last = first + m_model->subtreeSizeAt(first);
+                        for (int position = first; position <= last; ++position)
+                        {
+                            evaluate(position, &chunkMatches[i]);
+                        }
+                    });
+
+        for (const QVector<int> &chunk : std::as_const(chunkMatches))
+        {
+            matches.append(chunk);
+        }
+        std::sort(matches.begin(), matches.end());
+        return matches;
+    }
+
+private:
+    static constexpr int AnyClass = -2;
+
+    struct BoundStep
+    {
+        const Selector::Step *step = nullptr;
+        int classId = AnyClass;
+        quint32 bit = 0;
+        quint32 previousBit = 0;
+        QVector<QVector<QJsonValue>> columns;
+    };
+
+    static QString text(const QJsonValue &value)
+    {
+        switch (value.type())
+        {
+        case QJsonValue::String:
+            return value.toString();
+        case QJsonValue::Bool:
+            return value.toBool() ? QStringLiteral("true") : QStringLiteral("false");
+        case QJsonValue::Double:
+            return QString::number(value.toDouble());
+        default:
+            return value.toVariant().toString();
+        }
+    }
+
+    static bool equals(const QJsonValue &value, const Selector::Condition &condition)
+    {
+        switch (value.type())
+        {
+        case QJsonValue::Bool:
+            return condition.boolean == int(value.toBool());
+        case QJsonValue::Double:
+            return condition.isNumber && value.toDouble() == condition.number;
+        case QJsonValue::String:
+            return value.toString() == condition.value;
+        case QJsonValue::Null:
+            return condition.value == QLatin1String("null");
+        default:
+            return false;
+        }
+    }
+
+    static bool conditionMatches(const QJsonValue &value, const Selector::Condition &condition)
+    {
+        switch (condition.op)
+        {
+        case Selector::Op::Exists:
+            return !value.isUndefined();
+        case Selector::Op::Equals:
+            return equals(value, condition);
+        case Selector::Op::NotEquals:
+            return !equals(value, condition);
+        case Selector::Op::Contains:
+            return !value.isUndefined() && text(value).contains(condition.value);
+        case Selector::Op::Prefix:
+            return !value.isUndefined() && text(value).startsWith(condition.value);
+        case Selector::Op::Suffix:
+            return !value.isUndefined() && text(value).endsWith(condition.value);
+        case Selector::Op::Regex:
+            return !value.isUndefined() && condition.regex.match(text(value)).hasMatch();
+        }
+        return false;
+    }
+
+    bool matches(const BoundStep &bound, int position) const
+    {
+        if (bound.classId != AnyClass && bound.classId != m_model->classIdAt(position))
+        {
+            return false;
+        }
+        if ((m_model->flagsAt(position) & bound.step->flags) != bound.step->flags)
+        {
+            return false;
+        }
+        for (int i = 0; i < bound.columns.size(); ++i)
+        {
+            if (!conditionMatches(bound.columns.at(i).at(position), bound.step->conditions.at(i)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void evaluate(int position, QVector<int> *matches)
+    {
+        const int parent = m_model->parentAt(position);
+        const quint32 parentReach = parent >= 0 ? m_reach.at(parent) : 0;
+        const quint32 parentInherited = parent >= 0 ? m_inherited.at(parent) : 0;
+
+        quint32 reach = 0;
+        for (const BoundStep &bound : std::as_const(m_steps))
+        {
+            if (!bound.step->first && !((bound.step->child ? parentReach : parentInherited) & bound.previousBit))
+            {
+                continue;
+            }
+            if (matches(bound, position))
+            {
+                reach |= bound.bit;
+            }
+        }
+
+        m_reach[position] = reach;
+        m_inherited[position] = parentInherited | reach;
+        if (reach & m_lastMask)
+        {
+            matches->append(position);
+        }
+    }
+
+    const MyTreeModel2 *m_model {};
+    QVector<BoundStep> m_steps;
+    quint32 m_lastMask = 0;
+    QVector<quint32> m_reach;
+    QVector<quint32> m_inherited;
+};
+
+Selector Selector::compile(const QString &text, QString *error)
+{
+    Selector selector;
+    SelectorParser parser(text);
+    if (!parser.parse(&selector.m_steps))
+    {
+        if (error)
+        {
+            *error = parser.error();
+        }
+        return Selector();
+    }
+    if (selector.m_steps.size() > 32)
+    {
+        if (error)
+        {
+            *error = QStringLiteral("Selectors are limited to 32 compounds");
+        }
+        return Selector();
+    }
+
+    selector.m_text = text;
+    return selector;
+}
+
+bool Selector::isValid() const
+{
+    return !m_steps.isEmpty();
+}
+
+QString Selector::text() const
+{
+    return m_text;
+}
+
+QVector<int> Selector::evaluate(const MyTreeModel2 *model, int grain) const
+{
+    QAI_TRACE_SCOPE("selector", "evaluate");
+
+    if (!isValid() || !model || model->nodeCount() == 0)
+    {
+        return {};
+    }
+    return SelectorEvaluator(*this, model).run(qMax(grain, 1));
+}
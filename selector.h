@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QJsonValue>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+class MyTreeModel2;
+
+// CSS-like structural query over the dump tree:
+//
+//   ListView[objectName=feed] QQuickText[visible=1]
+//   QQuickWindow > * > #header, QQuickButton:hittable
+//
+// A compound is a classname (or *), followed by any of [key], [key=value],
+// [key!=value], [key*=value] (contains), [key^=value], [key$=value],
+// [key~=regexp], #objectName, :visible and :hittable. Compounds are joined
+// by whitespace (descendant) or > (child); commas separate alternatives.
+//
+// Evaluation is a single pre-order pass keeping, per node, a bitmask of the
+// selector steps matched at it and at its ancestors. Classnames and
+// properties are read from the model's class and property columns. Subtrees
+// below the grain size are independent and evaluated on the thread pool.
+class Selector
+{
+public:
+    Selector() = default;
+
+    static Selector compile(const QString &text, QString *error = nullptr);
+
+    bool isValid() const;
+    QString text() const;
+
+    // Positions of the matching nodes, in pre-order.
+    QVector<int> evaluate(const MyTreeModel2 *model, int grain = 16384) const;
+
+private:
+    enum class Op
+    {
+        Exists,
+        Equals,
+        NotEquals,
+        Contains,
+        Prefix,
+        Suffix,
+        Regex,
+    };
+
+    struct Condition
+    {
+        QString key;
+        Op op = Op::Exists;
+        QString value;
+        QRegularExpression regex;
+        double number = 0.0;
+        bool isNumber = false;
+        int boolean = -1; // value as a bool when it spells one, else -1
+    };
+
+    struct Step
+    {
+        QString classname; // empty for *
+        int flags = 0;
+        QVector<Condition> conditions;
+        bool first = false; // first step of its alternative
+        bool child = false; // joined to the previous step by >
+        bool last = false;  // last step of its alternative
+    };
+
+    friend class SelectorParser;
+    friend class SelectorEvaluator;
+
+    QString m_text;
+    QVector<Step> m_steps;
+};
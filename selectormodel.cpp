@@ -0,0 +1,154 @@
+#include "selectormodel.h"
+#include "mytreemodel2.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+SelectorModel::SelectorModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int SelectorModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_positions.size();
+}
+
+QVariant SelectorModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_positions.size() || !m_model)
+    {
+        return QVariant();
+    }
+
+    const int position = m_positions.at(index.row());
+    TreeItem2 *item = m_model->itemAt(position);
+    if (!item)
+    {
+        return QVariant();
+    }
+
+    switch (role)
+    {
+    case IndexRole:
+        return m_model->indexAt(position);
+    case PositionRole:
+        return position;
+    case Qt::DisplayRole:
+    case ClassnameRole:
+        return item->data(QStringLiteral("classname"));
+    case ObjectNameRole:
+        return item->data(QStringLiteral("objectName"));
+    case TextRole:
+        return item->data(QStringLiteral("mainTextProperty"));
+    case RectRole:
+        return m_model->rectAt(position);
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> SelectorModel::roleNames() const
+{
+    return {
+        { Qt::DisplayRole, "display" },
+        { IndexRole, "modelIndex" },
+        { PositionRole, "position" },
+        { ClassnameRole, "classname" },
+        { ObjectNameRole, "objectName" },
+        { TextRole, "text" },
+        { RectRole, "rect" },
+    };
+}
+
+MyTreeModel2 *SelectorModel::model() const
+{
+    return m_model;
+}
+
+void SelectorModel::setModel(MyTreeModel2 *model)
+{
+    if (m_model == model)
+    {
+        return;
+    }
+
+    if (m_model)
+    {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model)
+    {
+        connect(m_model, &QAbstractItemModel::modelReset, this, &SelectorModel::refresh);
+        connect(m_model, &MyTreeModel2::nodesUpdated, this, &SelectorModel::refresh);
+    }
+
+    refresh();
+    emit modelChanged();
+}
+
+QString SelectorModel::query() const
+{
+    return m_query;
+}
+
+void SelectorModel::setQuery(const QString &query)
+{
+    if (m_query == query)
+    {
+        return;
+    }
+
+    m_query = query;
+    m_error.clear();
+    m_selector = query.trimmed().isEmpty() ? Selector() : Selector::compile(query, &m_error);
+
+    refresh();
+    emit queryChanged();
+}
+
+QString SelectorModel::error() const
+{
+    return m_error;
+}
+
+qreal SelectorModel::elapsed() const
+{
+    return m_elapsed;
+}
+
+QModelIndex SelectorModel::indexAt(int row) const
+{
+    if (!m_model || row < 0 || row >= m_positions.size())
+    {
+        return QModelIndex();
+    }
+    return m_model->indexAt(m_positions.at(row));
+}
+
+QModelIndex SelectorModel::next(const QModelIndex &index) const
+{
+    if (!m_model || m_positions.isEmpty())
+    {
+        return QModelIndex();
+    }
+
+    const int position = m_model->positionOf(index);
+    const auto it = std::upper_bound(m_positions.cbegin(), m_positions.cend(), position);
+    return m_model->indexAt(it == m_positions.cend() ? m_positions.first() : *it);
+}
+
+void SelectorModel::refresh()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    beginResetModel();
+    m_positions = m_selector.evaluate(m_model);
+    endResetModel();
+
+    m_elapsed = timer.nsecsElapsed() / 1e6;
+    emit resultsChanged();
+}
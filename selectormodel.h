@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QPointer>
+
+#include "selector.h"
+
+class MyTreeModel2;
+
+// Matches of a Selector in a tree model, one row per node. The query runs
+// again whenever the query text changes or the tree is reloaded or updated.
+class SelectorModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(MyTreeModel2 *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(QString query READ query WRITE setQuery NOTIFY queryChanged)
+    Q_PROPERTY(QString error READ error NOTIFY resultsChanged)
+    Q_PROPERTY(int count READ rowCount NOTIFY resultsChanged)
+    Q_PROPERTY(qreal elapsed READ elapsed NOTIFY resultsChanged)
+public:
+    enum Roles
+    {
+        IndexRole = Qt::UserRole + 1,
+        PositionRole,
+        ClassnameRole,
+        ObjectNameRole,
+        TextRole,
+        RectRole,
+    };
+
+    explicit SelectorModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    MyTreeModel2 *model() const;
+    void setModel(MyTreeModel2 *model);
+
+    QString query() const;
+    void setQuery(const QString &query);
+
+    QString error() const;
+    qreal elapsed() const;
+
+    Q_INVOKABLE QModelIndex indexAt(int row) const;
+    // First match after index in tree order, wrapping around.
+    Q_INVOKABLE QModelIndex next(const QModelIndex &index) const;
+
+public slots:
+    void refresh();
+
+signals:
+    void modelChanged();
+    void queryChanged();
+    void resultsChanged();
+
+private:
+    QPointer<MyTreeModel2> m_model;
+    QString m_query;
+    Selector m_selector;
+    QString m_error;
+    QVector<int> m_positions;
+    qreal m_elapsed = 0.0;
+};
@@ -0,0 +1,169 @@
+#include "sharedring.h"
+
+#include <QDebug>
+
+#include <atomic>
+#include <cstring>
+#include <new>
+
+namespace {
+
+const quint32 s_magic = 0x51414952; // "QAIR"
+const quint32 s_version = 1;
+
+} // namespace
+
+// Lives at the start of the segment, the ring follows it. Both sides only
+// touch their own position and read the other's.
+struct SharedRing::Header
+{
+    quint32 magic;
+    quint32 version;
+    quint64 capacity;
+    alignas(64) std::atomic<quint64> written;
+    alignas(64) std::atomic<quint64> released;
+};
+
+static_assert(std::atomic<quint64>::is_always_lock_free, "ring positions must be lock free to be shared");
+
+SharedRing::SharedRing() = default;
+
+SharedRing::~SharedRing()
+{
+    detach();
+}
+
+bool SharedRing::create(const QString &key, qsizetype capacity)
+{
+    detach();
+
+    m_memory.setKey(key);
+    if (!m_memory.create(qsizetype(sizeof(Header)) + capacity))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to create" << key << m_memory.errorString();
+        return false;
+    }
+
+    m_header = new (m_memory.data()) Header {s_magic, s_version, quint64(capacity), {0}, {0}};
+    m_data = static_cast<char *>(m_memory.data()) + sizeof(Header);
+    return true;
+}
+
+bool SharedRing::attach(const QString &key)
+{
+    detach();
+
+    m_memory.setKey(key);
+    if (!m_memory.attach())
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to attach" << key << m_memory.errorString();
+        return false;
+    }
+
+    Header *header = static_cast<Header *>(m_memory.data());
+    if (m_memory.size() < qsizetype(sizeof(Header)) || header->magic != s_magic || header->version != s_version ||
+        header->capacity > quint64(m_memory.size()) - sizeof(Header))
+    {
+        qWarning() << Q_FUNC_INFO << "Not a ring segment:" << key;
+        m_memory.detach();
+        return false;
+    }
+
+    m_header = header;
+    m_data = static_cast<char *>(m_memory.data()) + sizeof(Header);
+    return true;
+}
+
+void SharedRing::detach()
+{
+    if (m_memory.isAttached())
+    {
+        m_memory.detach();
+    }
+    m_header = nullptr;
+    m_data = nullptr;
+}
+
+bool SharedRing::isAttached() const
+{
+    return m_header;
+}
+
+QString SharedRing::key() const
+{
+    return m_memory.key();
+}
+
+qsizetype SharedRing::capacity() const
+{
+    return m_header ? qsizetype(m_header->capacity) : 0;
+}
+
+qint64 SharedRing::write(QByteArrayView data)
+{
+    if (!m_header || data.isEmpty() || quint64(data.size()) > m_header->capacity)
+    {
+        return -1;
+    }
+
+    const quint64 capacity = m_header->capacity;
+    const quint64 size = quint64(data.size());
+    quint64 start = m_header->written.load(std::memory_order_relaxed);
+    if (start % capacity + size > capacity)
+    {
+        start += capacity - start % capacity;
+    }
+    if (start + size - m_header->released.load(std::memory_order_acquire) > capacity)
+    {
+        return -1;
+    }
+
+    std::memcpy(m_data + start % capacity, data.data(), size);
+    m_header->written.store(start + size, std::memory_order_release);
+    return qint64(start);
+}
+
+QByteArrayView SharedRing::read(qint64 offset, qsizetype size) const
+{
+    if (!m_header || offset < 0 || size <= 0)
+    {
+        return {};
+    }
+
+    const quint64 capacity = m_header->capacity;
+    const quint64 start = quint64(offset);
+    if (start < m_header->released.load(std::memory_order_relaxed) ||
+        start + quint64(size) > m_header->written.load(std::memory_order_acquire) ||
+        start % capacity + quint64(size) > capacity)
+    {
+        qWarning() << Q_FUNC_INFO << "Payload outside the written range:" << offset << size;
+        return {};
+    }
+    return QByteArrayView(m_data + start % capacity, size);
+}
+
+void SharedRing::release(qint64 end)
+{
+    if (m_header && end > 0)
+    {
+        m_header->released.store(quint64(end), std::memory_order_release);
+    }
+}
+
+bool SharedRing::skip(qint64 end)
+{
+    if (!m_header || end <= 0)
+    {
+        return false;
+    }
+
+    const quint64 position = quint64(end);
+    if (position < m_header->released.load(std::memory_order_relaxed) ||
+        position > m_header->written.load(std::memory_order_acquire))
+    {
+        qWarning() << Q_FUNC_INFO << "Outside the written range:" << end;
+        return false;
+    }
+    release(end);
+    return true;
+}
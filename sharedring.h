@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QByteArrayView>
+#include <QSharedMemory>
+#include <QString>
+
+// Single producer, single consumer byte ring in shared memory, used to hand
+// large payloads from a target on the same host to the inspector without
+// pushing them through a socket. The inspector creates the segment and
+// offers its key during initialize; the target attaches and writes payloads
+// into it, then sends a frame that names the offset and size.
+//
+// Offsets are logical positions that only grow. A payload never wraps
+// around the end of the buffer; the producer skips to the start instead.
+// The consumer reads payloads in the order they were written and releases
+// each one once it has been decoded, which frees the space for the producer.
+class SharedRing
+{
+public:
+    SharedRing();
+    ~SharedRing();
+
+    SharedRing(const SharedRing &) = delete;
+    SharedRing &operator=(const SharedRing &) = delete;
+
+    bool create(const QString &key, qsizetype capacity);
+    bool attach(const QString &key);
+    void detach();
+
+    bool isAttached() const;
+    QString key() const;
+    qsizetype capacity() const;
+
+    // Producer: copies data into the ring and returns its offset, or -1
+    // when the consumer has not released enough space yet.
+    qint64 write(QByteArrayView data);
+
+    // Consumer: the bytes of a written payload. The view stays valid until
+    // the payload is released.
+    QByteArrayView read(qint64 offset, qsizetype size) const;
+    void release(qint64 end);
+    // Releases up to end without reading, for a payload that was dropped or
+    // could not be read. Fails when end is not within the written range.
+    bool skip(qint64 end);
+
+private:
+    struct Header;
+
+    QSharedMemory m_memory;
+    Header *m_header {};
+    char *m_data {};
+};
@@ -0,0 +1,313 @@
+#include "snapshothistory.h"
+#include "dumpwatcher.h"
+#include "mytreemodel2.h"
+#include "screenprovider.h"
+#include "screenshottiers.h"
+#include "tracer.h"
+#include "treediff.h"
+
+#include <QJsonArray>
+#include <QSet>
+
+#include <iterator>
+#include <utility>
+
+SnapshotHistory::SnapshotHistory(ScreenshotStore *store, DumpWatcher *watcher, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_watcher(watcher)
+{
+    connect(m_store, &ScreenshotStore::changed, this, &SnapshotHistory::onScreenshotChanged);
+    connect(m_watcher, &DumpWatcher::treeApplied, this, &SnapshotHistory::recordTree);
+}
+
+MyTreeModel2 *SnapshotHistory::model() const
+{
+    return m_model;
+}
+
+void SnapshotHistory::setModel(MyTreeModel2 *model)
+{
+    if (m_model == model)
+    {
+        return;
+    }
+
+    if (m_model)
+    {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model)
+    {
+        connect(m_model, &QAbstractItemModel::modelReset, this, &SnapshotHistory::record);
+        connect(m_model, &MyTreeModel2::nodesUpdated, this, &SnapshotHistory::record);
+    }
+
+    clear();
+    emit modelChanged();
+}
+
+int SnapshotHistory::capacity() const
+{
+    return m_capacity;
+}
+
+void SnapshotHistory::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (m_capacity == capacity)
+    {
+        return;
+    }
+
+    m_capacity = capacity;
+    trim();
+    emit capacityChanged();
+}
+
+int SnapshotHistory::count() const
+{
+    return m_snapshots.size();
+}
+
+int SnapshotHistory::current() const
+{
+    return m_current;
+}
+
+void SnapshotHistory::setCurrent(int current)
+{
+    if (current == m_current || current < 0 || current >= m_snapshots.size() || !m_model)
+    {
+        return;
+    }
+
+    QAI_TRACE_SCOPE("history", "restore");
+
+    const Snapshot &snapshot = m_snapshots.at(current);
+    m_current = current;
+    m_restoring = true;
+    m_model->fillModel(toJson(*snapshot.root));
+    if (!snapshot.screenshot.isEmpty())
+    {
+        m_store->setData(snapshot.screenshot);
+    }
+    m_restoring = false;
+
+    emit currentChanged();
+}
+
+int SnapshotHistory::storedNodes() const
+{
+    return m_storedNodes;
+}
+
+int SnapshotHistory::totalNodes() const
+{
+    return m_totalNodes;
+}
+
+QDateTime SnapshotHistory::timeAt(int index) const
+{
+    return index >= 0 && index < m_snapshots.size() ? m_snapshots.at(index).time : QDateTime();
+}
+
+int SnapshotHistory::nodeCountAt(int index) const
+{
+    return index >= 0 && index < m_snapshots.size() ? m_snapshots.at(index).root->size : 0;
+}
+
+QJsonObject SnapshotHistory::dumpAt(int index) const
+{
+    return index >= 0 && index < m_snapshots.size() ? toJson(*m_snapshots.at(index).root) : QJsonObject();
+}
+
+void SnapshotHistory::clear()
+{
+    m_snapshots.clear();
+    m_index.clear();
+    m_current = -1;
+    m_storedNodes = 0;
+    m_totalNodes = 0;
+
+    emit historyChanged();
+    emit currentChanged();
+}
+
+bool SnapshotHistory::watcherUpdates() const
+{
+    return m_watcher->model() == m_model;
+}
+
+void SnapshotHistory::record()
+{
+    if (m_restoring || !m_model || m_model->nodeCount() == 0)
+    {
+        return;
+    }
+    // recordTree() gets the same tree, already hashed.
+    if (watcherUpdates() && m_watcher->isApplying())
+    {
+        return;
+    }
+
+    QAI_TRACE_SCOPE("history", "record");
+
+    TreeDiff::Tree tree;
+    tree.nodes.resize(m_model->nodeCount());
+    for (int position = 0; position < tree.nodes.size(); ++position)
+    {
+        TreeDiff::Tree::Node &node = tree.nodes[position];
+        node.data = m_model->itemAt(position)->data();
+        node.parent = m_model->parentAt(position);
+    }
+    tree.computeHashes();
+
+    addVersion(tree);
+}
+
+void SnapshotHistory::recordTree(const std::shared_ptr<const TreeDiff::Tree> &tree)
+{
+    if (m_restoring || !m_model || !watcherUpdates() || tree->nodes.isEmpty())
+    {
+        return;
+    }
+
+    QAI_TRACE_SCOPE("history", "recordTree");
+    addVersion(*tree);
+}
+
+void SnapshotHistory::addVersion(const TreeDiff::Tree &tree)
+{
+    const NodePtr root = share(tree, 0);
+    if (!m_snapshots.isEmpty() && m_snapshots.constLast().root == root)
+    {
+        // Same tree reloaded; the newest version already describes it.
+        if (m_current != m_snapshots.size() - 1)
+        {
+            m_current = m_snapshots.size() - 1;
+            emit currentChanged();
+        }
+        return;
+    }
+
+    // Live frames may be lossy or raw pixels; only PNG is kept.
+    const QByteArray screenshot = m_store->data();
+    m_snapshots.append({root, ScreenshotTiers::isLossless(screenshot) ? screenshot : QByteArray(),
+                        QDateTime::currentDateTime()});
+    m_current = m_snapshots.size() - 1;
+    trim();
+    countStored();
+
+    emit historyChanged();
+    emit currentChanged();
+}
+
+void SnapshotHistory::onScreenshotChanged()
+{
+    // Screenshots arrive after the dump they belong to, so a new one goes
+    // with the newest version as long as that is the one shown.
+    if (m_restoring || m_snapshots.isEmpty() || m_current != m_snapshots.size() - 1)
+    {
+        return;
+    }
+
+    const QByteArray data = m_store->data();
+    if (ScreenshotTiers::isLossless(data))
+    {
+        m_snapshots.last().screenshot = data;
+    }
+}
+
+SnapshotHistory::NodePtr SnapshotHistory::share(const TreeDiff::Tree &tree, int position)
+{
+    const TreeDiff::Tree::Node &flat = tree.nodes.at(position);
+
+    const auto found = m_index.constFind(flat.subtreeHash);
+    if (found != m_index.constEnd())
+    {
+        const NodePtr shared = found->lock();
+        if (shared && shared->size == flat.subtreeSize + 1 && shared->data == flat.data)
+        {
+            return shared;
+        }
+    }
+
+    auto node = std::make_shared<Node>();
+    node->data = flat.data;
+    node->subtreeHash = flat.subtreeHash;
+    node->size = flat.subtreeSize + 1;
+
+    const int end = position + flat.subtreeSize;
+    for (int child = position + 1; child <= end; child += tree.nodes.at(child).subtreeSize + 1)
+    {
+        node->children.append(share(tree, child));
+    }
+
+    m_index.insert(flat.subtreeHash, node);
+    return node;
+}
+
+QJsonObject SnapshotHistory::toJson(const Node &node)
+{
+    QJsonObject object = node.data;
+    if (!node.children.isEmpty())
+    {
+        QJsonArray children;
+        for (const NodePtr &child : node.children)
+        {
+            children.append(toJson(*child));
+        }
+        object.insert(QStringLiteral("children"), children);
+    }
+    return object;
+}
+
+void SnapshotHistory::trim()
+{
+    if (m_snapshots.size() <= m_capacity)
+    {
+        return;
+    }
+
+    const int evicted = m_snapshots.size() - m_capacity;
+    m_snapshots.remove(0, evicted);
+    m_current = qMax(0, m_current - evicted);
+
+    for (auto it = m_index.begin(); it != m_index.end();)
+    {
+        it = it->expired() ? m_index.erase(it) : std::next(it);
+    }
+
+    countStored();
+    emit historyChanged();
+    emit currentChanged();
+}
+
+void SnapshotHistory::countStored()
+{
+    QSet<const Node *> seen;
+    QVector<const Node *> stack;
+    m_totalNodes = 0;
+    for (const Snapshot &snapshot : std::as_const(m_snapshots))
+    {
+        m_totalNodes += snapshot.root->size;
+        stack.append(snapshot.root.get());
+    }
+
+    while (!stack.isEmpty())
+    {
+        const Node *node = stack.takeLast();
+        if (seen.contains(node))
+        {
+            continue;
+        }
+        seen.insert(node);
+        for (const NodePtr &child : node->children)
+        {
+            stack.append(child.get());
+        }
+    }
+    m_storedNodes = seen.size();
+}
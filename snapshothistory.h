@@ -0,0 +1,117 @@
+#pragma once
+
+#include <QDateTime>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+#include <memory>
+
+class DumpWatcher;
+class MyTreeModel2;
+class ScreenshotStore;
+
+namespace TreeDiff {
+struct Tree;
+}
+
+// Bounded history of the trees and screenshots the model showed. Every
+// reset or patch of the model is recorded; versions are persistent trees
+// in which a subtree whose hash matches a node of any retained version is
+// shared instead of copied, and node properties are implicitly shared
+// objects, so mostly static snapshots cost little beyond the nodes that
+// changed. Updates made by the watcher come with their tree already hashed
+// off the GUI thread; only other resets of the model are hashed here.
+// Screenshots are only kept when they are PNG, not live frames in a lossy
+// or raw tier. Setting current loads a version back into the model and the
+// screenshot store.
+class SnapshotHistory : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(MyTreeModel2 *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged)
+    Q_PROPERTY(int count READ count NOTIFY historyChanged)
+    Q_PROPERTY(int current READ current WRITE setCurrent NOTIFY currentChanged)
+    // Distinct nodes held by all versions together, against the nodes they
+    // would hold without sharing.
+    Q_PROPERTY(int storedNodes READ storedNodes NOTIFY historyChanged)
+    Q_PROPERTY(int totalNodes READ totalNodes NOTIFY historyChanged)
+public:
+    SnapshotHistory(ScreenshotStore *store, DumpWatcher *watcher, QObject *parent = nullptr);
+
+    MyTreeModel2 *model() const;
+    void setModel(MyTreeModel2 *model);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    int count() const;
+    int current() const;
+    void setCurrent(int current);
+
+    int storedNodes() const;
+    int totalNodes() const;
+
+    Q_INVOKABLE QDateTime timeAt(int index) const;
+    Q_INVOKABLE int nodeCountAt(int index) const;
+    Q_INVOKABLE QJsonObject dumpAt(int index) const;
+
+public slots:
+    void clear();
+
+signals:
+    void modelChanged();
+    void capacityChanged();
+    void historyChanged();
+    void currentChanged();
+
+private slots:
+    void record();
+    void recordTree(const std::shared_ptr<const TreeDiff::Tree> &tree);
+    void onScreenshotChanged();
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node
+    {
+        QJsonObject data; // without children
+        QVector<NodePtr> children;
+        size_t subtreeHash = 0;
+        int size = 0; // nodes in the subtree, including this one
+    };
+
+    struct Snapshot
+    {
+        NodePtr root;
+        QByteArray screenshot;
+        QDateTime time;
+    };
+
+    // Node for the subtree at position, reusing a retained one with the
+    // same hash where possible.
+    NodePtr share(const TreeDiff::Tree &tree, int position);
+    void addVersion(const TreeDiff::Tree &tree);
+    bool watcherUpdates() const;
+    static QJsonObject toJson(const Node &node);
+    void trim();
+    void countStored();
+
+    ScreenshotStore *m_store {};
+    DumpWatcher *m_watcher {};
+    QPointer<MyTreeModel2> m_model;
+    int m_capacity = 100;
+
+    QVector<Snapshot> m_snapshots;
+    int m_current = -1;
+    bool m_restoring = false;
+
+    // Every node of a retained version by subtree hash. Entries of evicted
+    // versions expire and are pruned in trim().
+    QHash<size_t, std::weak_ptr<const Node>> m_index;
+    int m_storedNodes = 0;
+    int m_totalNodes = 0;
+};
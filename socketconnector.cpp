@@ -1,51 +1,159 @@
 // Copyright (c) 2019-2020 Open Mobile Platform LLC.
 #include "socketconnector.h"
+#include "base64.h"
+#include "tracer.h"
 
+#include <QCoreApplication>
+#include <QDeadlineTimer>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QLocalSocket>
 #include <QTcpSocket>
+#include <QSaveFile>
 #include <QStandardPaths>
 #include <QDir>
+#include <QTimer>
+
+#include <utility>
+
+namespace {
+
+const int s_maxPathPoints = 2048;
+
+// String values longer than this are not copied into the reply object.
+const qsizetype s_inlineValueSize = 1024;
+
+const QLatin1String s_localPrefix("unix:");
+
+// How long stopAnalyze waits for an event already being received.
+const int s_analyzeDrainTimeout = 2000;
+
+// Time the target has to answer initialize on the main connection.
+const int s_initializeTimeout = 3000;
+
+// Time the control connection has to connect and answer initialize.
+const int s_controlTimeout = 1500;
+
+// Silence after which a reply without a terminating newline is tried as a
+// complete object.
+const int s_unterminatedReplyTimeout = 500;
+
+bool isLocalAddress(const QString &hostName)
+{
+    return hostName.startsWith(s_localPrefix);
+}
+
+} // namespace
 
 SocketConnector::SocketConnector(QObject* parent)
     : QObject(parent)
-    , m_socket(new QTcpSocket(this))
+    , m_tcpSocket(new QTcpSocket(this))
+    , m_localSocket(new QLocalSocket(this))
     , m_manager(new AnalyzeManager(this))
 {
-    connect(m_socket,
-            &QTcpSocket::connected,
-            [this]()
-            {
-                QJsonObject json;
-                json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
-                json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("initialize")));
-                json.insert(QStringLiteral("params"),
-                            QJsonValue::fromVariant(QStringList({m_applicationName})));
-                const QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
-
-                m_socket->write(data);
-                m_socket->write("\n", 1);
-                m_socket->waitForBytesWritten();
-
-                m_socket->waitForReadyRead(500);
-                qDebug().noquote() << m_socket->readAll();
-
-                qWarning() << Q_FUNC_INFO << "connected";
-                emit connectedChanged(true);
-            });
-    connect(m_socket,
-            &QTcpSocket::disconnected,
-            [this]()
-            {
-                qWarning() << Q_FUNC_INFO << "disconnected";
-                emit connectedChanged(false);
+    m_socket = m_tcpSocket;
+    m_requestClock.start();
+
+    connect(m_tcpSocket, &QTcpSocket::readyRead, this, &SocketConnector::processReplies);
+    connect(m_tcpSocket, &QTcpSocket::connected, this, &SocketConnector::onConnected);
+    connect(m_tcpSocket, &QTcpSocket::disconnected, this, &SocketConnector::onDisconnected);
+    connect(m_localSocket, &QLocalSocket::readyRead, this, &SocketConnector::processReplies);
+    connect(m_localSocket, &QLocalSocket::connected, this, &SocketConnector::onConnected);
+    connect(m_localSocket, &QLocalSocket::disconnected, this, &SocketConnector::onDisconnected);
+}
+
+void SocketConnector::onConnected()
+{
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("initialize")));
+    json.insert(QStringLiteral("params"),
+                QJsonValue::fromVariant(QStringList({m_applicationName})));
+    json.insert(QStringLiteral("screenshot"), ScreenshotTiers::offer(m_binaryFramingEnabled));
+    if (m_binaryFramingEnabled)
+    {
+        QJsonObject framing {
+            { "version", 1 },
+            { "codecs", QJsonArray::fromStringList(PayloadCodec::supportedCodecs()) },
+        };
+        // Only a target on this host can attach to the ring.
+        const QString ringKey = QStringLiteral("qainspector-%1-%2")
+                                    .arg(QCoreApplication::applicationPid())
+                                    .arg(quintptr(this), 0, 16);
+        if (m_socket == m_localSocket && m_sharedMemoryEnabled &&
+            m_ring.create(ringKey, qsizetype(qMax(1, m_sharedMemorySize)) * 1024 * 1024))
+        {
+            framing.insert(QStringLiteral("ring"), QJsonObject {
+                { "key", m_ring.key() },
+                { "size", m_ring.capacity() },
             });
+        }
+        json.insert(QStringLiteral("framing"), framing);
+    }
+    const QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+    m_socket->write(data);
+    m_socket->write("\n", 1);
+    m_socket->waitForBytesWritten();
+
+    // The target switches framing right after this line, so it is read as
+    // a line and negotiated before anything else is sent or read. Without
+    // it there is no telling how the next reply is framed.
+    const QDeadlineTimer deadline(s_initializeTimeout);
+    while (!m_socket->canReadLine() && m_socket->waitForReadyRead(deadline.remainingTime()))
+    {
+    }
+    if (!m_socket->canReadLine())
+    {
+        qWarning() << Q_FUNC_INFO << "No reply to initialize";
+        m_ring.detach();
+        m_socket->close();
+        return;
+    }
+
+    const QByteArray reply = m_socket->readLine();
+    qDebug().noquote() << reply.trimmed();
+    negotiate(QJsonDocument::fromJson(reply).object());
+
+    if (m_controlChannelEnabled)
+    {
+        openControl();
+    }
+
+    qWarning() << Q_FUNC_INFO << "connected";
+    emit connectedChanged(true);
+}
+
+void SocketConnector::onDisconnected()
+{
+    qWarning() << Q_FUNC_INFO << "disconnected";
+    closeControl();
+    m_ringActive = false;
+    m_ring.detach();
+    m_screenshotTiers.reset();
+    if (m_binaryFraming)
+    {
+        m_binaryFraming = false;
+        emit protocolChanged();
+    }
+    failPending(&m_pending, QStringLiteral("Disconnected"));
+    m_analyzeStream = false;
+    m_analyzeLocation.clear();
+    m_analyzeBuffer.clear();
+    if (m_analyzing)
+    {
+        m_analyzing = false;
+        emit analyzingChanged(false);
+    }
+    emit connectedChanged(false);
 }
 
 bool SocketConnector::isConnected() const
 {
-    return m_socket->state() == QTcpSocket::ConnectedState;
+    return m_socket == m_localSocket
+        ? m_localSocket->state() == QLocalSocket::ConnectedState
+        : m_tcpSocket->state() == QTcpSocket::ConnectedState;
 }
 
 void SocketConnector::setConnected(bool connected)
@@ -59,159 +167,806 @@ void SocketConnector::setConnected(bool connected)
     }
     else if (connected && !lastConnected)
     {
-        m_socket->connectToHost(m_hostName, m_hostPort.toUShort());
-        qDebug() << Q_FUNC_INFO << "Connecting:" << m_socket->waitForConnected(3000);
+        if (isLocalAddress(m_hostName))
+        {
+            m_socket = m_localSocket;
+            m_localSocket->connectToServer(localServerName(m_hostName));
+            qDebug() << Q_FUNC_INFO << "Connecting:" << m_localSocket->waitForConnected(3000);
+        }
+        else
+        {
+            m_socket = m_tcpSocket;
+            m_tcpSocket->connectToHost(m_hostName, m_hostPort.toUShort());
+            qDebug() << Q_FUNC_INFO << "Connecting:" << m_tcpSocket->waitForConnected(3000);
+        }
     }
 
     qDebug() << Q_FUNC_INFO << "Set connect:" << connected << "Connected:" << isConnected();
 }
 
-QString SocketConnector::getDumpTree(const QString &filter)
+QString SocketConnector::protocol() const
 {
-    qDebug() << filter;
+    QString protocol = QStringLiteral("json");
+    if (m_binaryFraming)
+    {
+        protocol = QStringLiteral("binary/") + PayloadCodec::codecName(m_codec);
+        if (m_ringActive)
+        {
+            protocol += QStringLiteral("+shm");
+        }
+    }
+    if (m_control)
+    {
+        protocol += QStringLiteral("+control");
+    }
+    return protocol;
+}
 
-    QJsonDocument filterDoc = QJsonDocument::fromJson(filter.toUtf8());
+void SocketConnector::negotiate(const QJsonObject &initializeReply)
+{
+    bool ok = false;
+    const PayloadCodec::Codec codec =
+        PayloadCodec::codecFromName(initializeReply.value(QStringLiteral("codec")).toString(), &ok);
 
-    QJsonObject json
+    m_binaryFraming = m_binaryFramingEnabled && ok &&
+        initializeReply.value(QStringLiteral("framing")).toString() == QLatin1String("binary");
+    m_codec = m_binaryFraming ? codec : PayloadCodec::None;
+
+    m_ringActive = m_binaryFraming && m_ring.isAttached() && initializeReply.value(QStringLiteral("ring")).toBool();
+    if (!m_ringActive)
     {
-        { "cmd", "action" },
-        { "action", "execute" },
-        { "params", {
-            { "app:dumpTreeFilter",  QJsonArray{{ filterDoc.array() }} }
-        }}
-    };
+        m_ring.detach();
+    }
+
+    // Raw pixels only pay off when the frame codec compresses them.
+    m_screenshotTiers.negotiate(initializeReply, m_binaryFraming && m_codec != PayloadCodec::None);
+
+    qDebug() << Q_FUNC_INFO << "Protocol:" << protocol();
+    emit protocolChanged();
+}
+
+void SocketConnector::openControl()
+{
+    QAI_TRACE_SCOPE("connector", "openControl");
+    closeControl();
+
+    // Same transport and handshake as the main connection, minus framing:
+    // nothing large is ever requested on it. Until it is initialized,
+    // control requests go over the main connection.
+    QIODevice *control = nullptr;
+    if (m_socket == m_localSocket)
+    {
+        QLocalSocket *socket = new QLocalSocket(this);
+        connect(socket, &QLocalSocket::connected, this, &SocketConnector::initializeControl);
+        connect(socket, &QLocalSocket::disconnected, this, &SocketConnector::closeControl);
+        connect(socket, &QLocalSocket::errorOccurred, this, &SocketConnector::closeControl);
+        control = socket;
+    }
+    else
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        connect(socket, &QTcpSocket::connected, this, &SocketConnector::initializeControl);
+        connect(socket, &QTcpSocket::disconnected, this, &SocketConnector::closeControl);
+        connect(socket, &QTcpSocket::errorOccurred, this, &SocketConnector::closeControl);
+        control = socket;
+    }
+    connect(control, &QIODevice::readyRead, this, &SocketConnector::processControlReplies);
+    m_controlConnecting = control;
+
+    QTimer::singleShot(s_controlTimeout, control,
+                       [this, control]()
+                       {
+                           if (m_controlConnecting == control)
+                           {
+                               closeControl();
+                           }
+                       });
+
+    if (QLocalSocket *socket = qobject_cast<QLocalSocket *>(control))
+    {
+        socket->connectToServer(m_localSocket->fullServerName());
+    }
+    else
+    {
+        qobject_cast<QTcpSocket *>(control)->connectToHost(m_hostName, m_hostPort.toUShort());
+    }
+}
+
+void SocketConnector::initializeControl()
+{
+    if (!m_controlConnecting)
+    {
+        return;
+    }
+
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket *>(m_controlConnecting))
+    {
+        // Input requests are tiny; do not let Nagle hold them back.
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    }
+
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("initialize")));
+    json.insert(QStringLiteral("params"), QJsonValue::fromVariant(QStringList({m_applicationName})));
+
+    m_controlConnecting->write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    m_controlConnecting->write("\n", 1);
+}
+
+void SocketConnector::closeControl()
+{
+    const bool open = m_control != nullptr;
+    QIODevice *control = open ? std::exchange(m_control, nullptr) : std::exchange(m_controlConnecting, nullptr);
+    if (!control)
+    {
+        return;
+    }
+
+    disconnect(control, nullptr, this, nullptr);
+    control->close();
+    control->deleteLater();
+
+    if (!open)
+    {
+        qWarning() << Q_FUNC_INFO << "No control connection, input shares the main one";
+        return;
+    }
+
+    failPending(&m_controlPending, QStringLiteral("Control connection lost"));
+    emit protocolChanged();
+}
+
+QString SocketConnector::screenshotTier() const
+{
+    return ScreenshotTiers::tierName(m_screenshotTiers.mode());
+}
+
+void SocketConnector::setScreenshotTier(const QString &tier)
+{
+    bool ok = false;
+    const ScreenshotTiers::Tier mode = ScreenshotTiers::tierFromName(tier, &ok);
+    if (!ok)
+    {
+        qWarning() << Q_FUNC_INFO << "Unknown screenshot tier:" << tier;
+        return;
+    }
+    if (mode != m_screenshotTiers.mode())
+    {
+        m_screenshotTiers.setMode(mode);
+        emit screenshotTierChanged();
+    }
+}
+
+int SocketConnector::screenshotQuality() const
+{
+    return m_screenshotTiers.quality();
+}
+
+void SocketConnector::setScreenshotQuality(int quality)
+{
+    if (quality != m_screenshotTiers.quality())
+    {
+        m_screenshotTiers.setQuality(quality);
+        emit screenshotTierChanged();
+    }
+}
+
+QString SocketConnector::screenshotFormat() const
+{
+    return m_screenshotFormat;
+}
+
+QJsonObject SocketConnector::liveScreenshotRequest()
+{
+    const ScreenshotTiers::Tier tier = m_screenshotTiers.next();
+    const QString format = m_screenshotTiers.format(tier);
+    if (format != m_screenshotFormat)
+    {
+        m_screenshotFormat = format;
+        emit screenshotFormatChanged();
+    }
+    return m_screenshotTiers.request(tier);
+}
+
+QJsonObject SocketConnector::losslessScreenshotRequest() const
+{
+    return m_screenshotTiers.request(ScreenshotTiers::Lossless);
+}
+
+int SocketConnector::pendingRequests() const
+{
+    return m_pending.size() + m_controlPending.size();
+}
+
+quint64 SocketConnector::sendRequest(const QJsonObject &json, const ReplyCallback &callback, size_t knownDigest)
+{
+    return enqueueRequest(m_socket, &m_pending, json, callback, knownDigest);
+}
+
+quint64 SocketConnector::sendControlRequest(const QJsonObject &json, const ReplyCallback &callback)
+{
+    if (!m_control)
+    {
+        return sendRequest(json, callback);
+    }
+    return enqueueRequest(m_control, &m_controlPending, json, callback, 0);
+}
+
+quint64 SocketConnector::enqueueRequest(QIODevice *socket, QQueue<PendingRequest> *queue, const QJsonObject &json,
+                                        const ReplyCallback &callback, size_t knownDigest)
+{
+    const QJsonValue params = json.value(QStringLiteral("params"));
+
+    PendingRequest request;
+    request.id = ++m_lastRequestId;
+    request.action = params.isArray()
+        ? params.toArray().at(0).toString()
+        : json.value(QStringLiteral("action")).toString();
+    request.sentAt = m_requestClock.elapsed();
+    request.callback = callback;
+    request.knownDigest = knownDigest;
+
+    if (socket == m_socket && connectionBusy())
+    {
+        qWarning() << Q_FUNC_INFO << "Analyzing, not sending" << request.action;
+        QMetaObject::invokeMethod(
+            this,
+            [this, request]() { finishRequest(request, errorReply(QStringLiteral("Analyzing"))); },
+            Qt::QueuedConnection);
+        return request.id;
+    }
+
     const QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    socket->write(data);
+    socket->write("\n", 1);
 
-    qDebug().noquote() << QJsonDocument(json).toJson();
+    queue->enqueue(request);
+    emit pendingRequestsChanged();
+    return request.id;
+}
 
-    m_socket->write(data);
-    m_socket->write("\n", 1);
-    m_socket->waitForBytesWritten();
+void SocketConnector::cancelRequest(quint64 id)
+{
+    for (PendingRequest &request : m_pending)
+    {
+        if (request.id == id)
+        {
+            request.cancelled = true;
+            request.callback = {};
+            return;
+        }
+    }
+}
 
-    QByteArray replyData;
-    QJsonDocument replyDoc;
-    QJsonParseError error;
-    error.error = QJsonParseError::UnterminatedObject;
+void SocketConnector::cancelBulkRequests()
+{
+    for (PendingRequest &request : m_pending)
+    {
+        request.cancelled = true;
+        request.callback = {};
+    }
+}
 
-    replyDoc = QJsonDocument::fromJson(replyData, &error);
+void SocketConnector::processReplies()
+{
+    if (m_analyzeStream)
+    {
+        readAnalyzeStream();
+        return;
+    }
 
-    while (error.error != QJsonParseError::NoError)
+    while (!m_pending.isEmpty() && replyAvailable())
     {
-        if (!m_socket->waitForReadyRead(-1))
+        const PendingRequest request = m_pending.dequeue();
+        // Replies queue up behind each other, so a request's own time
+        // starts when the one before it was answered.
+        const qint64 startedAt = qMax(request.sentAt, m_lastReplyAt);
+        m_lastReplyAt = m_requestClock.elapsed();
+        if (request.cancelled)
         {
-            qWarning() << Q_FUNC_INFO << "Timeout" << error.error << error.errorString();
-            qDebug().noquote() << replyData;
-            return QString();
+            skipReply();
+            emit pendingRequestsChanged();
+            continue;
         }
-        replyData.append(m_socket->readAll());
-        replyDoc = QJsonDocument::fromJson(replyData, &error);
+
+        const Reply reply = takeReply(request.knownDigest);
+        if (request.action == QLatin1String("getScreenshot") && reply.status() == 0)
+        {
+            m_screenshotTiers.addSample(reply.object.value(QStringLiteral("format")).toString(),
+                                        m_requestClock.elapsed() - startedAt);
+        }
+        finishRequest(request, reply);
     }
 
-    QJsonObject replyObject = replyDoc.object();
-    if (replyObject.contains(QStringLiteral("status")) &&
-        replyObject.value(QStringLiteral("status")).toInt() == 0)
+    if (m_analyzing && m_pending.isEmpty())
     {
-        QByteArray data = qUncompress(QByteArray::fromBase64(
-            replyObject.value(QStringLiteral("value")).toString().toLatin1()));
-        return QString::fromUtf8(data);
+        startAnalyze();
     }
-    return QString();
 }
 
-QByteArray SocketConnector::getGrabWindow()
+void SocketConnector::processControlReplies()
 {
-    QJsonObject json;
-    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
-    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("getScreenshot")));
-    json.insert(QStringLiteral("params"), QJsonValue(QString()));
-    const QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    if (m_controlConnecting && m_controlConnecting->canReadLine())
+    {
+        qDebug().noquote() << m_controlConnecting->readLine().trimmed();
+        m_control = std::exchange(m_controlConnecting, nullptr);
+        emit protocolChanged();
+    }
 
-    m_socket->write(data);
-    m_socket->write("\n", 1);
-    m_socket->waitForBytesWritten();
+    while (m_control && m_control->canReadLine())
+    {
+        const QByteArray line = m_control->readLine();
+        if (m_controlPending.isEmpty())
+        {
+            qWarning() << Q_FUNC_INFO << "Unexpected reply of" << line.size() << "bytes";
+            continue;
+        }
+        finishRequest(m_controlPending.dequeue(), parseReply(line));
+    }
+}
 
-    QByteArray replyData;
-    QJsonDocument replyDoc;
-    QJsonParseError error;
-    error.error = QJsonParseError::UnterminatedObject;
+void SocketConnector::finishRequest(const PendingRequest &request, const Reply &reply)
+{
+    const int status = reply.status();
+    const int latency = int(m_requestClock.elapsed() - request.sentAt);
 
-    replyDoc = QJsonDocument::fromJson(replyData, &error);
+    if (request.callback)
+    {
+        request.callback(reply);
+    }
 
-    while (error.error != QJsonParseError::NoError)
+    emit requestFinished(request.action, status, latency);
+    emit pendingRequestsChanged();
+}
+
+void SocketConnector::failPending(QQueue<PendingRequest> *queue, const QString &message)
+{
+    if (queue->isEmpty())
+    {
+        return;
+    }
+
+    const QQueue<PendingRequest> dropped = std::exchange(*queue, {});
+    const Reply reply = errorReply(message);
+    for (const PendingRequest &request : dropped)
     {
-        if (!m_socket->waitForReadyRead(-1))
+        if (!request.cancelled)
         {
-            qWarning() << Q_FUNC_INFO << "Timeout" << error.error << error.errorString();
-            qDebug().noquote() << replyData;
-            return {};
+            finishRequest(request, reply);
         }
-        replyData.append(m_socket->readAll());
-        replyDoc = QJsonDocument::fromJson(replyData, &error);
     }
+    emit pendingRequestsChanged();
+}
 
-    QJsonObject replyObject = replyDoc.object();
-    if (replyObject.contains(QStringLiteral("status")) &&
-        replyObject.value(QStringLiteral("status")).toInt() == 0)
+void SocketConnector::flushPending()
+{
+    // Replies come back in request order, so asynchronous requests sent
+    // earlier have to be answered before a blocking reply can be read.
+    while (!m_pending.isEmpty())
     {
-        const auto b64 = replyObject.value(QStringLiteral("value")).toString();
-        emit imageData(b64);
-        const QByteArray img =
-            QByteArray::fromBase64(b64.toUtf8());
-        qDebug() << Q_FUNC_INFO << img.size();
-        return img;
+        if (!replyAvailable() && !m_socket->waitForReadyRead(5000))
+        {
+            qWarning() << Q_FUNC_INFO << "Timeout waiting for" << m_pending.size() << "pending replies";
+            failPending(&m_pending, QStringLiteral("Timeout"));
+            return;
+        }
+        processReplies();
     }
-    return {};
 }
 
-void SocketConnector::startAnalyze()
+bool SocketConnector::replyAvailable() const
 {
-    QJsonObject json
+    if (m_binaryFraming)
+    {
+        const qsizetype size = PayloadCodec::frameSize(m_socket->peek(PayloadCodec::FrameHeaderSize));
+        if (size > 0)
+        {
+            return m_socket->bytesAvailable() >= size;
+        }
+        if (size == 0)
+        {
+            return false;
+        }
+        // Not a frame: the server answered with a plain JSON line.
+    }
+    return m_socket->canReadLine();
+}
+
+SocketConnector::Reply SocketConnector::takeReply(size_t knownDigest)
+{
+    Reply reply;
+    if (m_binaryFraming)
+    {
+        const qsizetype size = PayloadCodec::frameSize(m_socket->peek(PayloadCodec::FrameHeaderSize));
+        if (size > 0)
+        {
+            const QByteArray data = m_socket->read(size);
+            reply.digest = qHashBits(data.constData(), size_t(data.size()));
+            reply.unchanged = knownDigest != 0 && reply.digest == knownDigest;
+
+            PayloadCodec::Frame frame;
+            if (!PayloadCodec::decodeFrame(data, &frame, !reply.unchanged))
+            {
+                qWarning() << Q_FUNC_INFO << "Malformed frame of" << size << "bytes";
+                return Reply();
+            }
+            if (frame.header.contains(QLatin1String("ring")) && !takeRingPayload(&frame, knownDigest, &reply))
+            {
+                return Reply();
+            }
+            reply.object = frame.header;
+            reply.payload = frame.payload;
+            reply.binary = true;
+            return reply;
+        }
+    }
+
+    const QByteArray line = m_socket->readLine();
+    reply = parseReply(line);
+    reply.digest = qHashBits(line.constData(), size_t(line.size()));
+    reply.unchanged = knownDigest != 0 && reply.digest == knownDigest;
+    return reply;
+}
+
+void SocketConnector::skipReply()
+{
+    QAI_TRACE_SCOPE("connector", "skip");
+
+    if (m_binaryFraming)
+    {
+        const qsizetype size = PayloadCodec::frameSize(m_socket->peek(PayloadCodec::FrameHeaderSize));
+        if (size > 0)
+        {
+            PayloadCodec::Frame frame;
+            if (PayloadCodec::decodeFrame(m_socket->read(size), &frame, false) && m_ringActive)
+            {
+                const QJsonArray ring = frame.header.value(QStringLiteral("ring")).toArray();
+                if (!ring.isEmpty())
+                {
+                    m_ring.skip(ring.at(0).toInteger() + ring.at(1).toInteger());
+                }
+            }
+            return;
+        }
+    }
+    m_socket->readLine();
+}
+
+bool SocketConnector::takeRingPayload(PayloadCodec::Frame *frame, size_t knownDigest, Reply *reply)
+{
+    const QJsonArray ring = frame->header.take(QStringLiteral("ring")).toArray();
+    const qint64 offset = ring.at(0).toInteger(-1);
+    const qsizetype size = ring.at(1).toInteger();
+
+    const QByteArrayView packed = m_ringActive ? m_ring.read(offset, size) : QByteArrayView();
+    if (packed.isNull())
+    {
+        qWarning() << Q_FUNC_INFO << "No ring payload at" << offset << size;
+        // The space still has to be given back, or the target finds the
+        // ring full from now on. If even that is not possible, the ring is
+        // out of step and is dropped until the next connect.
+        if (m_ringActive && !m_ring.skip(offset + size))
+        {
+            m_ringActive = false;
+            m_ring.detach();
+            emit protocolChanged();
+        }
+        return false;
+    }
+
+    // The digest covers the payload, not the frame that points to it.
+    reply->digest = qHashBits(packed.data(), size_t(packed.size()));
+    reply->unchanged = knownDigest != 0 && reply->digest == knownDigest;
+
+    bool ok = true;
+    if (!reply->unchanged)
+    {
+        QAI_TRACE_SCOPE("connector", "ring");
+        // Compressed payloads are decoded straight out of shared memory;
+        // stored ones need their one copy before the space is released.
+        frame->payload = frame->codec == PayloadCodec::None
+            ? packed.toByteArray()
+            : PayloadCodec::decompress(frame->codec, QByteArray::fromRawData(packed.data(), packed.size()),
+                                       frame->rawSize, &ok);
+    }
+    m_ring.release(offset + size);
+    return ok;
+}
+
+SocketConnector::Reply SocketConnector::parseReply(const QByteArray &line)
+{
+    Reply reply;
+
+    const QByteArrayView value = Base64::jsonStringValue(line, "value");
+    if (value.size() <= s_inlineValueSize)
+    {
+        reply.object = QJsonDocument::fromJson(line).object();
+        return reply;
+    }
+
+    // Parse the small envelope only, with the value cut down to "".
+    reply.raw = line;
+    reply.valueOffset = value.data() - line.constData();
+    reply.valueSize = value.size();
+
+    QByteArray envelope = line.left(reply.valueOffset);
+    envelope.append(QByteArrayView(line).sliced(reply.valueOffset + reply.valueSize));
+    reply.object = QJsonDocument::fromJson(envelope).object();
+    return reply;
+}
+
+SocketConnector::Reply SocketConnector::errorReply(const QString &message)
+{
+    Reply reply;
+    reply.object = QJsonObject {
+        { "status", -1 },
+        { "value", message },
+    };
+    return reply;
+}
+
+QString SocketConnector::localServerName(const QString &hostName)
+{
+    return isLocalAddress(hostName) ? hostName.mid(s_localPrefix.size()) : QString();
+}
+
+bool SocketConnector::connectionBusy() const
+{
+    return m_analyzing || m_analyzeStream;
+}
+
+SocketConnector::Reply SocketConnector::readReply()
+{
+    QAI_TRACE_SCOPE("connector", "reply");
+
+    flushPending();
+
+    if (m_binaryFraming)
+    {
+        while (!replyAvailable())
+        {
+            if (!m_socket->waitForReadyRead(-1))
+            {
+                qWarning() << Q_FUNC_INFO << "Timeout waiting for frame";
+                return {};
+            }
+        }
+        return takeReply();
+    }
+
+    // Wait for the terminating newline instead of re-parsing the growing
+    // buffer after every chunk. A server that omits the newline is still
+    // understood: once nothing arrived for a while, the buffered data is
+    // parsed as a whole, once per pause rather than once per chunk.
+    while (!m_socket->canReadLine())
+    {
+        if (m_socket->waitForReadyRead(s_unterminatedReplyTimeout))
+        {
+            continue;
+        }
+
+        if (!isConnected())
+        {
+            qWarning() << Q_FUNC_INFO << "Connection lost waiting for reply";
+            qDebug().noquote() << m_socket->peek(256);
+            return {};
+        }
+
+        const QByteArray buffered = m_socket->peek(m_socket->bytesAvailable());
+        if (buffered.endsWith('}'))
+        {
+            QJsonParseError error;
+            QJsonDocument::fromJson(buffered, &error);
+            if (error.error == QJsonParseError::NoError)
+            {
+                return parseReply(m_socket->read(buffered.size()));
+            }
+        }
+    }
+
+    return parseReply(m_socket->readLine());
+}
+
+QJsonObject SocketConnector::dumpTreeRequest(const QString &filter)
+{
+    QJsonDocument filterDoc = QJsonDocument::fromJson(filter.toUtf8());
+
+    return QJsonObject
     {
         { "cmd", "action" },
-        { "action", "startAnalyze" },
-        { "params", "" }
+        { "action", "execute" },
+        { "params", {
+            { "app:dumpTreeFilter",  QJsonArray{{ filterDoc.array() }} }
+        }}
     };
-    const auto data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+QByteArray SocketConnector::decodeDump(const Reply &reply)
+{
+    if (reply.status() != 0)
+    {
+        return QByteArray();
+    }
+    if (reply.binary)
+    {
+        return reply.payload;
+    }
+
+    QByteArray compressed;
+    {
+        QAI_TRACE_SCOPE("connector", "base64");
+        compressed = reply.valueOffset >= 0
+            ? Base64::decode(reply.encodedValue())
+            : Base64::decode(reply.object.value(QStringLiteral("value")).toString().toLatin1());
+    }
+    QAI_TRACE_SCOPE("connector", "qUncompress");
+    return qUncompress(compressed);
+}
+
+QByteArray SocketConnector::decodeScreenshot(const Reply &reply)
+{
+    if (reply.status() != 0)
+    {
+        return QByteArray();
+    }
+    if (reply.binary)
+    {
+        return reply.payload;
+    }
+
+    QAI_TRACE_SCOPE("connector", "base64");
+    return reply.valueOffset >= 0
+        ? Base64::decode(reply.encodedValue())
+        : Base64::decode(reply.object.value(QStringLiteral("value")).toString().toLatin1());
+}
+
+QString SocketConnector::getDumpTree(const QString &filter)
+{
+    QAI_TRACE_SCOPE("connector", "getDumpTree");
+    qDebug() << filter;
+
+    if (connectionBusy())
+    {
+        qWarning() << Q_FUNC_INFO << "Not available while analyzing";
+        return {};
+    }
+
+    const QJsonObject json = dumpTreeRequest(filter);
+    const QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+    qDebug().noquote() << QJsonDocument(json).toJson();
 
     m_socket->write(data);
     m_socket->write("\n", 1);
     m_socket->waitForBytesWritten();
 
-    connect(m_socket, &QTcpSocket::readyRead, this, &SocketConnector::onDataAvailable, Qt::UniqueConnection);
+    return QString::fromUtf8(decodeDump(readReply()));
 }
 
-void SocketConnector::stopAnalyze()
+QByteArray SocketConnector::getGrabWindow()
+{
+    QAI_TRACE_SCOPE("connector", "getGrabWindow");
+
+    if (connectionBusy())
+    {
+        qWarning() << Q_FUNC_INFO << "Not available while analyzing";
+        return {};
+    }
+
+    const QByteArray data = QJsonDocument(losslessScreenshotRequest()).toJson(QJsonDocument::Compact);
+
+    m_socket->write(data);
+    m_socket->write("\n", 1);
+    m_socket->waitForBytesWritten();
+
+    const QByteArray img = decodeScreenshot(readReply());
+    qDebug() << Q_FUNC_INFO << img.size();
+    if (!img.isEmpty())
+    {
+        emit imageData(img);
+    }
+    return img;
+}
+
+bool SocketConnector::isAnalyzing() const
 {
-    disconnect(m_socket, &QTcpSocket::readyRead, this, &SocketConnector::onDataAvailable);
+    return m_analyzing;
+}
+
+void SocketConnector::startAnalyze()
+{
+    if (m_analyzeStream || !isConnected())
+    {
+        return;
+    }
+    if (!m_analyzing)
+    {
+        m_analyzing = true;
+        // The watcher and the replay stop on this, so nothing new is queued.
+        emit analyzingChanged(true);
+    }
+
+    // Analyze lines and replies cannot be told apart, so the stream is only
+    // asked for once every earlier request is answered; processReplies()
+    // calls back here when the last one is.
+    if (!m_pending.isEmpty())
+    {
+        qDebug() << Q_FUNC_INFO << "Waiting for" << m_pending.size() << "replies";
+        return;
+    }
 
     QJsonObject json
     {
         { "cmd", "action" },
-        { "action", "stopAnalyze" },
+        { "action", "startAnalyze" },
         { "params", "" }
     };
     const auto data = QJsonDocument(json).toJson(QJsonDocument::Compact);
 
     m_socket->write(data);
     m_socket->write("\n", 1);
-    m_socket->waitForBytesWritten();
+    m_analyzeStream = true;
 }
 
-void SocketConnector::onDataAvailable()
+void SocketConnector::stopAnalyze()
 {
-    disconnect(m_socket, &QTcpSocket::readyRead, this, &SocketConnector::onDataAvailable);
+    if (!m_analyzing)
+    {
+        return;
+    }
+    m_analyzing = false;
+
+    if (m_analyzeStream)
+    {
+        QJsonObject json
+        {
+            { "cmd", "action" },
+            { "action", "stopAnalyze" },
+            { "params", "" }
+        };
+        const auto data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+        m_socket->write(data);
+        m_socket->write("\n", 1);
+
+        // An event the target is in the middle of sending is still read;
+        // requests wait until it is complete.
+        if (m_analyzeLocation.isEmpty())
+        {
+            endAnalyzeStream();
+        }
+        else
+        {
+            QTimer::singleShot(s_analyzeDrainTimeout, this,
+                               [this]()
+                               {
+                                   if (!m_analyzing)
+                                   {
+                                       endAnalyzeStream();
+                                   }
+                               });
+        }
+    }
 
-    QString location;
+    emit analyzingChanged(false);
+}
 
-    QByteArray buf;
+void SocketConnector::readAnalyzeStream()
+{
+    QAI_TRACE_SCOPE("connector", "analyzeEvent");
 
-    qDebug() << Q_FUNC_INFO << m_socket->bytesAvailable();
-    while (m_socket->bytesAvailable() > 0 || m_socket->waitForReadyRead(1000)) {
+    // Only whole lines are taken; the rest of an event is read as it
+    // arrives, on the next readyRead.
+    while (m_analyzeStream && m_socket->canReadLine()) {
         const auto data = m_socket->readLine();
         qDebug() << "read line:" << data.size();
-        qDebug().noquote() << data;
 
         if (data.startsWith("pressed:")) {
+            // A target that sends no screenshot ends an event by starting
+            // the next one.
+            finishAnalyzeEvent();
+
             const auto msecs = QDateTime::currentMSecsSinceEpoch();
             const auto dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
             const auto current = QString::number(msecs);
@@ -219,116 +974,193 @@ void SocketConnector::onDataAvailable()
             QDir dirPath(dir);
             dirPath.mkpath(current);
 
-            location = dirPath.absoluteFilePath(current);
+            m_analyzeLocation = dirPath.absoluteFilePath(current);
 
-            qDebug() << "Created location:" << location;
+            qDebug() << "Created location:" << m_analyzeLocation;
 
             QString pointStr = data.mid(9).trimmed();
             QJsonObject json {
                 { "x", pointStr.section(',', 0, 0).toInt() },
                 { "y", pointStr.section(',', 1, 1).toInt() },
             };
-            QFile pointFile(location + "/point.json");
+            QSaveFile pointFile(m_analyzeLocation + "/point.json");
             if (pointFile.open(QIODevice::WriteOnly)) {
                 pointFile.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
-                pointFile.close();
+                if (!pointFile.commit()) {
+                    qWarning() << Q_FUNC_INFO << "Failed to write" << pointFile.fileName() << pointFile.errorString();
+                }
             } else {
                 qWarning() << Q_FUNC_INFO << "Failed to open file for writing:" << pointFile.fileName();
             }
-        } else if (data.startsWith("dump start:")) {
-            buf.clear();
+        } else if (data.startsWith("dump start:") || data.startsWith("screen start:")) {
+            m_analyzeBuffer.clear();
+        } else if (m_analyzeLocation.isEmpty()) {
+            qWarning() << Q_FUNC_INFO << "Analyze data outside of an event:" << data.size();
         } else if (data.startsWith("dump end")) {
-            qDebug() << Q_FUNC_INFO << "Dump end, size:" << buf.size();
-            QFile dumpFile(location + "/dump.json");
+            qDebug() << Q_FUNC_INFO << "Dump end, size:" << m_analyzeBuffer.size();
+            QSaveFile dumpFile(m_analyzeLocation + "/dump.json");
             if (dumpFile.open(QIODevice::WriteOnly)) {
-                dumpFile.write(qUncompress(buf));
-                dumpFile.close();
+                dumpFile.write(qUncompress(m_analyzeBuffer));
+                if (!dumpFile.commit()) {
+                    qWarning() << Q_FUNC_INFO << "Failed to write" << dumpFile.fileName() << dumpFile.errorString();
+                }
             } else {
                 qWarning() << Q_FUNC_INFO << "Failed to open file for writing:" << dumpFile.fileName();
             }
-            buf.clear();
-        } else if (data.startsWith("screen start:")) {
-            buf.clear();
+            m_analyzeBuffer.clear();
         } else if (data.startsWith("screen end")) {
-            qDebug() << Q_FUNC_INFO << "Screen end, size:" << buf.size();
-            QFile screenFile(location + "/screenshot.png");
+            qDebug() << Q_FUNC_INFO << "Screen end, size:" << m_analyzeBuffer.size();
+            QSaveFile screenFile(m_analyzeLocation + "/screenshot.png");
             if (screenFile.open(QIODevice::WriteOnly)) {
-                screenFile.write(qUncompress(buf));
-                screenFile.close();
+                screenFile.write(qUncompress(m_analyzeBuffer));
+                if (!screenFile.commit()) {
+                    qWarning() << Q_FUNC_INFO << "Failed to write" << screenFile.fileName() << screenFile.errorString();
+                }
             } else {
                 qWarning() << Q_FUNC_INFO << "Failed to open file for writing:" << screenFile.fileName();
             }
-            buf.clear();
+            finishAnalyzeEvent();
         } else {
-            buf.append(data);
+            m_analyzeBuffer.append(data);
         }
     }
+}
 
-    m_manager->analyzeDataAdded(location);
+void SocketConnector::finishAnalyzeEvent()
+{
+    m_analyzeBuffer.clear();
+    if (m_analyzeLocation.isEmpty())
+    {
+        return;
+    }
 
-    connect(m_socket, &QTcpSocket::readyRead, this, &SocketConnector::onDataAvailable, Qt::UniqueConnection);
+    m_manager->analyzeDataAdded(std::exchange(m_analyzeLocation, QString()));
+    if (!m_analyzing)
+    {
+        endAnalyzeStream();
+    }
 }
 
-void SocketConnector::analyzeData(const QByteArray &data)
+void SocketConnector::endAnalyzeStream()
 {
-    qDebug() << Q_FUNC_INFO << data.size();
-    if (data.startsWith("pressed:")) {
+    if (!m_analyzeStream)
+    {
+        return;
+    }
 
+    if (!m_analyzeLocation.isEmpty())
+    {
+        qWarning() << Q_FUNC_INFO << "Event incomplete:" << m_analyzeLocation;
     }
-    // qDebug().noquote() << data;
+    m_analyzeStream = false;
+    finishAnalyzeEvent();
 }
 
 void SocketConnector::mousePressed(const QPoint &p)
 {
-    m_points = {p};
     m_timer.start();
+    m_points = {{p, 0}};
+    m_pathSegment = 0;
 }
 
 void SocketConnector::mouseReleased(const QPoint &p)
 {
+    QAI_TRACE_SCOPE("connector", "input");
     qint64 elapsed = m_timer.elapsed();
 
-    QByteArray data;
+    if (m_gesturePaths && (m_pathSegment > 0 || m_points.size() > 1)) {
+        m_points.append({p, elapsed});
+        sendPathSegment(true);
+        return;
+    }
+
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("execute")));
 
-    if (m_points.size() == 1) {
+    if (m_points.size() <= 1) {
         QString action = QStringLiteral("app:click");
         if (elapsed > 700) {
             action = QStringLiteral("app:pressAndHold");
         }
-        QJsonObject json;
-        json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
-        json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("execute")));
         json.insert(
             QStringLiteral("params"),
             QJsonValue::fromVariant(QVariantList{action, QVariantList{p.x(), p.y()}}));
-        data = QJsonDocument(json).toJson(QJsonDocument::Compact);
     } else {
-        QPoint fp = m_points.first();
+        QPoint fp = m_points.first().pos;
 
-        QJsonObject json;
-        json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
-        json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("execute")));
         json.insert(
             QStringLiteral("params"),
             QJsonValue::fromVariant(QVariantList{QStringLiteral("app:move"), QVariantList{fp.x(), fp.y(), p.x(), p.y()}}));
-        data = QJsonDocument(json).toJson(QJsonDocument::Compact);
     }
 
-    if (data.isEmpty()) {
+    m_points.clear();
+    sendControlRequest(json);
+}
+
+void SocketConnector::mouseMoved(const QPoint &p)
+{
+    if (m_points.isEmpty()) {
         return;
     }
 
-    m_socket->write(data);
-    m_socket->write("\n", 1);
-    m_socket->waitForBytesWritten();
+    const qint64 elapsed = m_timer.elapsed();
+    const qint64 interval = m_moveRate > 0 ? 1000 / m_moveRate : 0;
 
-    m_socket->waitForReadyRead(5000);
-    m_socket->readAll();
+    if (m_points.size() > 1 && elapsed - m_points.at(m_points.size() - 2).msecs < interval) {
+        m_points.last() = {p, elapsed};
+    } else {
+        m_points.append({p, elapsed});
+    }
+
+    // Very long drags at a high move rate: keep every other point of the path.
+    if (m_points.size() > s_maxPathPoints) {
+        QVector<TouchPoint> decimated;
+        decimated.reserve(m_points.size() / 2 + 1);
+        for (int i = 0; i < m_points.size(); i += 2) {
+            decimated.append(m_points.at(i));
+        }
+        if (decimated.last().msecs != m_points.last().msecs) {
+            decimated.append(m_points.last());
+        }
+        m_points = decimated;
+    }
+
+    if (m_gesturePaths && m_points.last().msecs - m_points.first().msecs >= interval) {
+        sendPathSegment(false);
+    }
 }
 
-void SocketConnector::mouseMoved(const QPoint &p)
+void SocketConnector::sendPathSegment(bool final)
 {
-    m_points.append(p);
+    QAI_TRACE_SCOPE("connector", "input");
+
+    // Segment 0 starts with the press point; later ones leave out the
+    // point that ended the previous segment.
+    QJsonArray path;
+    for (int i = m_pathSegment > 0 ? 1 : 0; i < m_points.size(); ++i) {
+        const TouchPoint &point = m_points.at(i);
+        path.append(QJsonArray{point.pos.x(), point.pos.y(), point.msecs});
+    }
+
+    QJsonObject json;
+    json.insert(QStringLiteral("cmd"), QJsonValue(QStringLiteral("action")));
+    json.insert(QStringLiteral("action"), QJsonValue(QStringLiteral("execute")));
+    json.insert(
+        QStringLiteral("params"),
+        QJsonArray{QStringLiteral("app:movePath"), path, QJsonObject{
+            { "segment", m_pathSegment },
+            { "final", final },
+        }});
+
+    if (final) {
+        m_points.clear();
+        m_pathSegment = 0;
+    } else {
+        m_points = {m_points.last()};
+        ++m_pathSegment;
+    }
+    sendControlRequest(json);
 }
 
 AnalyzeManager *SocketConnector::manager()
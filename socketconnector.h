@@ -3,12 +3,21 @@
 #define SOCKETCONNECTOR_H
 
 #include "analyzemanager.h"
+#include "payloadcodec.h"
+#include "screenshottiers.h"
+#include "sharedring.h"
 
 #include <QElapsedTimer>
+#include <QJsonObject>
 #include <QObject>
 #include <QPoint>
+#include <QQueue>
 #include <QVector>
 
+#include <functional>
+
+class QIODevice;
+class QLocalSocket;
 class QTcpSocket;
 class SocketConnector : public QObject
 {
@@ -20,11 +29,117 @@ public:
     bool isConnected() const;
     void setConnected(bool connected);
 
+    // A hostname of the form unix:<path> connects to a Unix domain socket
+    // and ignores the port.
     Q_PROPERTY(QString hostname MEMBER m_hostName NOTIFY hostnameChanged)
     Q_PROPERTY(QString port MEMBER m_hostPort NOTIFY portChanged)
     Q_PROPERTY(QString applicationName MEMBER m_applicationName NOTIFY applicationNameChanged)
 
     Q_PROPERTY(AnalyzeManager *manager READ manager CONSTANT)
+    // While analyzing, the main connection carries the analyze stream: other
+    // requests on it fail right away with an error reply, and getDumpTree()
+    // and getGrabWindow() return nothing.
+    Q_PROPERTY(bool analyzing READ isAnalyzing NOTIFY analyzingChanged)
+    bool isAnalyzing() const;
+
+    // Pointer moves closer together than 1000 / moveRate ms are coalesced
+    // into the latest position; 0 keeps every move.
+    Q_PROPERTY(int moveRate MEMBER m_moveRate NOTIFY moveRateChanged)
+    // Stream the timestamped drag path as app:movePath segments while the
+    // pointer moves, at most moveRate per second, instead of a first/last
+    // point app:move on release. The options object of a segment carries
+    // its number and whether it ends the gesture; the target presses at the
+    // first point of segment 0 and releases after the final one.
+    Q_PROPERTY(bool gesturePaths MEMBER m_gesturePaths NOTIFY gesturePathsChanged)
+
+    Q_PROPERTY(int pendingRequests READ pendingRequests NOTIFY pendingRequestsChanged)
+    int pendingRequests() const;
+
+    // Offer binary framing in initialize; the server may still answer with
+    // the JSON protocol.
+    Q_PROPERTY(bool binaryFraming MEMBER m_binaryFramingEnabled NOTIFY binaryFramingChanged)
+    // Over a Unix domain socket, also offer a shared memory ring of
+    // sharedMemorySize MiB that large payloads are written to instead.
+    Q_PROPERTY(bool sharedMemory MEMBER m_sharedMemoryEnabled NOTIFY sharedMemoryChanged)
+    Q_PROPERTY(int sharedMemorySize MEMBER m_sharedMemorySize NOTIFY sharedMemoryChanged)
+    // Open a second connection for input and other small commands, so they
+    // never wait behind a dump or screenshot still streaming on the main
+    // one. Takes effect on the next connect.
+    Q_PROPERTY(bool controlChannel MEMBER m_controlChannelEnabled NOTIFY controlChannelChanged)
+    // Screenshots for live views, see ScreenshotTiers: "auto", "lossy",
+    // "raw" or "lossless". getGrabWindow() always asks for lossless PNG.
+    Q_PROPERTY(QString screenshotTier READ screenshotTier WRITE setScreenshotTier NOTIFY screenshotTierChanged)
+    Q_PROPERTY(int screenshotQuality READ screenshotQuality WRITE setScreenshotQuality NOTIFY screenshotTierChanged)
+    // Format of the latest live screenshot request.
+    Q_PROPERTY(QString screenshotFormat READ screenshotFormat NOTIFY screenshotFormatChanged)
+    QString screenshotTier() const;
+    void setScreenshotTier(const QString &tier);
+    int screenshotQuality() const;
+    void setScreenshotQuality(int quality);
+    QString screenshotFormat() const;
+
+    // "json", or "binary/<codec>" once binary framing was negotiated, with
+    // "+shm" when the target writes payloads to shared memory and
+    // "+control" while the control connection is open.
+    Q_PROPERTY(QString protocol READ protocol NOTIFY protocolChanged)
+    QString protocol() const;
+
+    // A reply as read from the socket. With binary framing the value of
+    // dumps and screenshots arrives already decoded in payload. Large JSON
+    // string values are left out of object and kept as a span of raw, so
+    // base64 is decoded from the received bytes.
+    struct Reply
+    {
+        QJsonObject object;
+        QByteArray payload;
+        bool binary = false;
+
+        QByteArray raw;
+        qsizetype valueOffset = -1;
+        qsizetype valueSize = 0;
+
+        // Hash of the reply bytes as received, before any decoding. When it
+        // equals the knownDigest passed to sendRequest, the reply is marked
+        // unchanged and a binary payload is not even decompressed. The
+        // digest stays on this side: the target does not see it and still
+        // sends the whole payload.
+        size_t digest = 0;
+        bool unchanged = false;
+
+        int status() const
+        {
+            return object.value(QStringLiteral("status")).toInt(-1);
+        }
+
+        QByteArrayView encodedValue() const
+        {
+            return valueOffset < 0 ? QByteArrayView() : QByteArrayView(raw).sliced(valueOffset, valueSize);
+        }
+    };
+
+    using ReplyCallback = std::function<void(const Reply &reply)>;
+    // Both return an id for cancelRequest(). Control requests go over the
+    // control connection when it is open and over the main one otherwise;
+    // their replies must be small, they are never framed.
+    quint64 sendRequest(const QJsonObject &json, const ReplyCallback &callback = {}, size_t knownDigest = 0);
+    quint64 sendControlRequest(const QJsonObject &json, const ReplyCallback &callback = {});
+    // The callback of a cancelled request is never called. Its reply still
+    // has to be read off the main connection, but it is dropped without
+    // being decoded and its shared memory is released right away.
+    void cancelRequest(quint64 id);
+
+    static QJsonObject dumpTreeRequest(const QString &filter);
+    // Request for a live screenshot in the tier chosen for the next frame.
+    QJsonObject liveScreenshotRequest();
+    // Request for a PNG screenshot, as recordings and history keep.
+    QJsonObject losslessScreenshotRequest() const;
+    static QByteArray decodeDump(const Reply &reply);
+    static QByteArray decodeScreenshot(const Reply &reply);
+    static Reply parseReply(const QByteArray &line);
+    // Reply for a request that never got one, with a non-zero status.
+    static Reply errorReply(const QString &message);
+    // Server name of a unix:<path> hostname, empty for a TCP host.
+    static QString localServerName(const QString &hostName);
 
 public slots:
     QString getDumpTree(const QString &filter = {});
@@ -34,33 +149,124 @@ public slots:
     void mouseReleased(const QPoint &p);
     void mouseMoved(const QPoint &p);
 
+    void cancelBulkRequests();
+
     AnalyzeManager *manager();
 
     void startAnalyze();
     void stopAnalyze();
 
 private slots:
-    void onDataAvailable();
-    void analyzeData(const QByteArray &data);
+    void onConnected();
+    void onDisconnected();
+    void processReplies();
+    void processControlReplies();
+    void initializeControl();
+    void closeControl();
 
 signals:
     void connectedChanged(bool connected);
     void hostnameChanged();
     void portChanged();
     void applicationNameChanged();
+    void moveRateChanged();
+    void gesturePathsChanged();
+    void pendingRequestsChanged();
+    void binaryFramingChanged();
+    void sharedMemoryChanged();
+    void controlChannelChanged();
+    void screenshotTierChanged();
+    void screenshotFormatChanged();
+    void protocolChanged();
+    void analyzingChanged(bool analyzing);
+
+    void requestFinished(const QString &action, int status, int latency);
 
-    void imageData(const QString &b64);
+    void imageData(const QByteArray &data);
 
 private:
-    QTcpSocket* m_socket {};
+    struct PendingRequest
+    {
+        quint64 id = 0;
+        QString action;
+        qint64 sentAt = 0;
+        ReplyCallback callback;
+        size_t knownDigest = 0;
+        bool cancelled = false;
+    };
+
+    struct TouchPoint
+    {
+        QPoint pos;
+        qint64 msecs = 0;
+    };
+
+    void negotiate(const QJsonObject &initializeReply);
+    void openControl();
+    quint64 enqueueRequest(QIODevice *socket, QQueue<PendingRequest> *queue, const QJsonObject &json,
+                           const ReplyCallback &callback, size_t knownDigest);
+    void finishRequest(const PendingRequest &request, const Reply &reply);
+    // Requests that will never be answered get an error reply, so callers
+    // waiting for one can move on.
+    void failPending(QQueue<PendingRequest> *queue, const QString &message);
+    bool replyAvailable() const;
+    Reply takeReply(size_t knownDigest = 0);
+    void skipReply();
+    bool takeRingPayload(PayloadCodec::Frame *frame, size_t knownDigest, Reply *reply);
+    void flushPending();
+    Reply readReply();
+    bool connectionBusy() const;
+    void readAnalyzeStream();
+    void finishAnalyzeEvent();
+    void endAnalyzeStream();
+    void sendPathSegment(bool final);
+
+    // m_socket is whichever of the two the current hostname selects.
+    QIODevice* m_socket {};
+    QTcpSocket* m_tcpSocket {};
+    QLocalSocket* m_localSocket {};
     QString m_hostName;
     QString m_hostPort;
     QString m_applicationName;
 
-    QVector<QPoint> m_points;
+    // Points not sent yet; while a path streams, the first one is the last
+    // point already sent.
+    QVector<TouchPoint> m_points;
+    int m_pathSegment = 0;
     QElapsedTimer m_timer;
+    int m_moveRate = 60;
+    bool m_gesturePaths = false;
+
+    bool m_binaryFramingEnabled = true;
+    bool m_binaryFraming = false;
+    PayloadCodec::Codec m_codec = PayloadCodec::None;
+    bool m_sharedMemoryEnabled = true;
+    int m_sharedMemorySize = 64;
+    SharedRing m_ring;
+    bool m_ringActive = false;
+
+    // Open and initialized, or null. Replies on it are plain JSON lines.
+    QIODevice* m_control {};
+    // Connecting or waiting for the initialize reply.
+    QIODevice* m_controlConnecting {};
+    bool m_controlChannelEnabled = true;
+
+    QQueue<PendingRequest> m_pending;
+    QQueue<PendingRequest> m_controlPending;
+    quint64 m_lastRequestId = 0;
+    qint64 m_lastReplyAt = 0;
+    QElapsedTimer m_requestClock;
+
+    ScreenshotTiers m_screenshotTiers;
+    QString m_screenshotFormat;
 
     AnalyzeManager *m_manager {};
+    bool m_analyzing = false;
+    // Set from the moment startAnalyze is sent until the last event after
+    // stopAnalyze is read; analyze lines may still arrive in between.
+    bool m_analyzeStream = false;
+    QString m_analyzeLocation;
+    QByteArray m_analyzeBuffer;
 };
 
 #endif // SOCKETCONNECTOR_H
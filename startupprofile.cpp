@@ -0,0 +1,117 @@
+#include "startupprofile.h"
+#include "tracer.h"
+
+#include <QDebug>
+#include <QQuickWindow>
+#include <QTimer>
+
+StartupProfile::StartupProfile(QObject *parent)
+    : QObject(parent)
+    , m_budget(qEnvironmentVariableIntValue("QAINSPECTOR_STARTUP_BUDGET"))
+{
+    m_clock.start();
+}
+
+void StartupProfile::mark(const char *phase)
+{
+    const qint64 elapsed = m_clock.nsecsElapsed() / 1000;
+
+    if (Tracer::enabled())
+    {
+        Tracer *tracer = Tracer::instance();
+        const qint64 previous = m_phases.isEmpty() ? 0 : m_phases.last().elapsed;
+        const qint64 end = tracer->timestamp();
+        tracer->record("startup", phase, qMax<qint64>(0, end - (elapsed - previous)), end);
+    }
+
+    m_phases.append(Phase {phase, elapsed});
+}
+
+void StartupProfile::watch(QQuickWindow *window)
+{
+    if (!window)
+    {
+        qWarning() << Q_FUNC_INFO << "No window to watch";
+        return;
+    }
+
+    // frameSwapped comes from the render thread, so the connection is queued.
+    m_window = window;
+    connect(m_window, &QQuickWindow::frameSwapped, this, &StartupProfile::onFrameSwapped, Qt::QueuedConnection);
+}
+
+bool StartupProfile::isInteractive() const
+{
+    return m_timeToInteractive >= 0;
+}
+
+int StartupProfile::timeToFirstFrame() const
+{
+    return m_timeToFirstFrame;
+}
+
+int StartupProfile::timeToInteractive() const
+{
+    return m_timeToInteractive;
+}
+
+int StartupProfile::budget() const
+{
+    return m_budget;
+}
+
+QVariantList StartupProfile::phases() const
+{
+    QVariantList phases;
+    for (const Phase &phase : m_phases)
+    {
+        phases.append(QVariantMap {
+            { "name", QString::fromLatin1(phase.name) },
+            { "elapsed", phase.elapsed / 1000.0 },
+        });
+    }
+    return phases;
+}
+
+void StartupProfile::onFrameSwapped()
+{
+    if (m_timeToFirstFrame >= 0)
+    {
+        return;
+    }
+    disconnect(m_window, &QQuickWindow::frameSwapped, this, &StartupProfile::onFrameSwapped);
+
+    mark("firstFrame");
+    m_timeToFirstFrame = int(m_clock.elapsed());
+    emit firstFrameSwapped();
+
+    // Everything queued while the first frame was produced runs before this.
+    QTimer::singleShot(0, this,
+                       [this]()
+                       {
+                           mark("interactive");
+                           m_timeToInteractive = int(m_clock.elapsed());
+                           emit interactiveChanged();
+                           report();
+                       });
+}
+
+void StartupProfile::report() const
+{
+    QStringList phases;
+    qint64 previous = 0;
+    for (const Phase &phase : m_phases)
+    {
+        phases.append(QStringLiteral("%1 +%2 ms").arg(QString::fromLatin1(phase.name))
+                          .arg((phase.elapsed - previous) / 1000.0, 0, 'f', 1));
+        previous = phase.elapsed;
+    }
+
+    qInfo().noquote() << "Startup: first frame" << m_timeToFirstFrame << "ms, interactive"
+                      << m_timeToInteractive << "ms (" + phases.join(QStringLiteral(", ")) + ")";
+
+    if (m_budget > 0 && m_timeToInteractive > m_budget)
+    {
+        qWarning() << "Startup exceeded budget:" << m_timeToInteractive << "ms >" << m_budget << "ms";
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVariantList>
+#include <QVector>
+
+class QQuickWindow;
+
+// Measures inspector startup. Phases are marked from main(); the first
+// frame swapped by the main window gives the time to first frame, and the
+// first pass of the event loop after it the time to interactive. Phases are
+// also recorded as "startup" trace spans when tracing is enabled.
+//
+// QAINSPECTOR_STARTUP_BUDGET=<ms> turns an over-budget time to interactive
+// into a warning.
+class StartupProfile : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool interactive READ isInteractive NOTIFY interactiveChanged)
+    Q_PROPERTY(int timeToFirstFrame READ timeToFirstFrame NOTIFY firstFrameSwapped)
+    Q_PROPERTY(int timeToInteractive READ timeToInteractive NOTIFY interactiveChanged)
+    Q_PROPERTY(int budget READ budget CONSTANT)
+public:
+    explicit StartupProfile(QObject *parent = nullptr);
+
+    void mark(const char *phase);
+    void watch(QQuickWindow *window);
+
+    bool isInteractive() const;
+    int timeToFirstFrame() const;
+    int timeToInteractive() const;
+    int budget() const;
+
+    Q_INVOKABLE QVariantList phases() const;
+
+signals:
+    void firstFrameSwapped();
+    void interactiveChanged();
+
+private slots:
+    void onFrameSwapped();
+
+private:
+    void report() const;
+
+    struct Phase
+    {
+        const char *name = nullptr;
+        qint64 elapsed = 0; // microseconds since the profile was created
+    };
+
+    QElapsedTimer m_clock;
+    QVector<Phase> m_phases;
+    QQuickWindow *m_window {};
+    int m_timeToFirstFrame = -1;
+    int m_timeToInteractive = -1;
+    int m_budget = 0;
+};
@@ -0,0 +1,317 @@
+#include "tapstatistics.h"
+#include "analyzemanager.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Taps further out are recorded at the edge instead of growing the grid
+// without bound.
+const int s_maxCoordinate = 16384;
+
+QPoint clampPoint(const QPoint &point)
+{
+    return QPoint(qBound(0, point.x(), s_maxCoordinate), qBound(0, point.y(), s_maxCoordinate));
+}
+
+} // namespace
+
+TapStatistics::TapStatistics(AnalyzeManager *manager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+{
+    connect(m_manager, &AnalyzeManager::dataAdded, this, &TapStatistics::onDataAdded);
+    connect(m_manager, &AnalyzeManager::dataRemoved, this, &TapStatistics::onDataRemoved);
+    connect(m_manager, &AnalyzeManager::dataRefined, this, &TapStatistics::onDataRefined);
+}
+
+bool TapStatistics::isLoaded() const
+{
+    return m_loaded;
+}
+
+int TapStatistics::cellSize() const
+{
+    return m_cellSize;
+}
+
+void TapStatistics::setCellSize(int cellSize)
+{
+    cellSize = qBound(1, cellSize, 256);
+    if (m_cellSize == cellSize)
+    {
+        return;
+    }
+
+    m_cellSize = cellSize;
+    rebuild();
+}
+
+QSize TapStatistics::gridSize() const
+{
+    return m_gridSize;
+}
+
+const QVector<quint32> &TapStatistics::cells() const
+{
+    return m_cells;
+}
+
+int TapStatistics::taps() const
+{
+    return m_taps.size();
+}
+
+int TapStatistics::refinedTaps() const
+{
+    return m_refinedTaps;
+}
+
+int TapStatistics::elements() const
+{
+    return m_hits.size();
+}
+
+int TapStatistics::maxCount() const
+{
+    return int(m_maxCount);
+}
+
+int TapStatistics::hitsFor(const QString &id) const
+{
+    return m_hits.value(id);
+}
+
+QVariantList TapStatistics::topElements(int count) const
+{
+    QVector<std::pair<QString, int>> hits;
+    hits.reserve(m_hits.size());
+    for (auto it = m_hits.constBegin(); it != m_hits.constEnd(); ++it)
+    {
+        hits.append({it.key(), it.value()});
+    }
+
+    const auto middle = hits.begin() + qBound(0, count, int(hits.size()));
+    std::partial_sort(hits.begin(), middle, hits.end(),
+                      [](const auto &left, const auto &right)
+                      {
+                          return left.second > right.second ||
+                                 (left.second == right.second && left.first < right.first);
+                      });
+
+    QVariantList result;
+    for (auto it = hits.begin(); it != middle; ++it)
+    {
+        result.append(QVariantMap {
+            { "id", it->first },
+            { "hits", it->second },
+        });
+    }
+    return result;
+}
+
+void TapStatistics::reload()
+{
+    const quint64 generation = ++m_generation;
+
+    // Reading thousands of point.json files stays off the GUI thread. The
+    // statistics are destroyed at exit before the pool finishes, so the
+    // result goes to the application object and the pointer is checked on
+    // the GUI thread.
+    const QPointer<TapStatistics> statistics(this);
+    QThreadPool::globalInstance()->start(
+        [statistics, generation]()
+        {
+            QAI_TRACE_SCOPE("taps", "read");
+
+            QHash<QString, Tap> taps;
+            const QList<QVariantMap> recordings = AnalyzeManager::recordings();
+            for (const QVariantMap &point : recordings)
+            {
+                taps.insert(point.value(QStringLiteral("location")).toString(), tapFrom(point));
+            }
+
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [statistics, generation, taps]()
+                {
+                    if (!statistics || generation != statistics->m_generation)
+                    {
+                        return;
+                    }
+
+                    // Taps recorded while reading are already counted in.
+                    for (auto it = taps.constBegin(); it != taps.constEnd(); ++it)
+                    {
+                        if (!statistics->m_taps.contains(it.key()))
+                        {
+                            statistics->m_taps.insert(it.key(), it.value());
+                        }
+                    }
+                    statistics->m_loaded = true;
+                    statistics->rebuild();
+                },
+                Qt::QueuedConnection);
+        });
+}
+
+void TapStatistics::clear()
+{
+    ++m_generation;
+    m_taps.clear();
+    m_loaded = false;
+    rebuild();
+}
+
+void TapStatistics::onDataAdded(const QVariantMap &point)
+{
+    const QString location = point.value(QStringLiteral("location")).toString();
+    const Tap tap = tapFrom(point);
+
+    const auto existing = m_taps.constFind(location);
+    if (existing != m_taps.constEnd())
+    {
+        // The analyze window loads every recording again when it opens.
+        if (existing->point == tap.point && existing->id == tap.id)
+        {
+            return;
+        }
+        count(*existing, -1);
+    }
+
+    m_taps.insert(location, tap);
+    count(tap, 1);
+    emit statsChanged();
+}
+
+void TapStatistics::onDataRemoved(const QString &location)
+{
+    const auto existing = m_taps.constFind(location);
+    if (existing == m_taps.constEnd())
+    {
+        return;
+    }
+
+    count(*existing, -1);
+    m_taps.erase(existing);
+    emit statsChanged();
+}
+
+void TapStatistics::onDataRefined(const QString &location, const QString &id)
+{
+    const auto existing = m_taps.find(location);
+    if (existing == m_taps.end() || existing->id == id)
+    {
+        return;
+    }
+
+    countHit(existing->id, -1);
+    existing->id = id;
+    countHit(id, 1);
+    emit statsChanged();
+}
+
+TapStatistics::Tap TapStatistics::tapFrom(const QVariantMap &point)
+{
+    return Tap {
+        clampPoint(QPoint(point.value(QStringLiteral("x")).toInt(), point.value(QStringLiteral("y")).toInt())),
+        point.value(QStringLiteral("id")).toString(),
+    };
+}
+
+void TapStatistics::count(const Tap &tap, int delta)
+{
+    const int index = cellIndex(tap.point);
+    quint32 &cell = m_cells[index];
+    if (delta > 0)
+    {
+        ++cell;
+        m_maxCount = qMax(m_maxCount, cell);
+    }
+    else if (cell > 0)
+    {
+        --cell;
+    }
+
+    countHit(tap.id, delta);
+    emit cellChanged(index);
+}
+
+void TapStatistics::countHit(const QString &id, int delta)
+{
+    if (id.isEmpty())
+    {
+        return;
+    }
+
+    m_refinedTaps += delta;
+    int &hits = m_hits[id];
+    hits += delta;
+    if (hits <= 0)
+    {
+        m_hits.remove(id);
+    }
+}
+
+int TapStatistics::cellIndex(const QPoint &point)
+{
+    const int column = point.x() / m_cellSize;
+    const int row = point.y() / m_cellSize;
+    if (column >= m_gridSize.width() || row >= m_gridSize.height())
+    {
+        // Doubling keeps growth rare while taps keep landing further out.
+        resizeGrid(QSize(column >= m_gridSize.width() ? qMax(column + 1, m_gridSize.width() * 2) : m_gridSize.width(),
+                         row >= m_gridSize.height() ? qMax(row + 1, m_gridSize.height() * 2) : m_gridSize.height()));
+    }
+    return row * m_gridSize.width() + column;
+}
+
+void TapStatistics::resizeGrid(const QSize &size)
+{
+    QAI_TRACE_SCOPE("taps", "resizeGrid");
+
+    QVector<quint32> cells(size.width() * size.height(), 0);
+    for (int row = 0; row < m_gridSize.height(); ++row)
+    {
+        std::copy_n(m_cells.constBegin() + row * m_gridSize.width(), m_gridSize.width(),
+                    cells.begin() + row * size.width());
+    }
+
+    m_cells = std::move(cells);
+    m_gridSize = size;
+    emit gridReset();
+}
+
+void TapStatistics::rebuild()
+{
+    QAI_TRACE_SCOPE("taps", "rebuild");
+
+    QPoint extent;
+    for (const Tap &tap : std::as_const(m_taps))
+    {
+        extent.setX(qMax(extent.x(), tap.point.x()));
+        extent.setY(qMax(extent.y(), tap.point.y()));
+    }
+
+    m_gridSize = m_taps.isEmpty() ? QSize() : QSize(extent.x() / m_cellSize + 1, extent.y() / m_cellSize + 1);
+    m_cells.fill(0, m_gridSize.width() * m_gridSize.height());
+    m_hits.clear();
+    m_refinedTaps = 0;
+    m_maxCount = 0;
+
+    for (const Tap &tap : std::as_const(m_taps))
+    {
+        quint32 &cell = m_cells[cellIndex(tap.point)];
+        m_maxCount = qMax(m_maxCount, ++cell);
+        countHit(tap.id, 1);
+    }
+
+    emit gridReset();
+    emit statsChanged();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QPoint>
+#include <QSize>
+#include <QVariantList>
+#include <QVector>
+
+class AnalyzeManager;
+
+// Tap counts across all analyze recordings: a grid of cellSize device
+// pixels per cell for the heatmap, and hits per refined element id. Both
+// are kept up to date from AnalyzeManager's signals, one tap at a time,
+// and only rebuilt by reload() or when the cell size changes.
+class TapStatistics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool loaded READ isLoaded NOTIFY statsChanged)
+    Q_PROPERTY(int cellSize READ cellSize WRITE setCellSize NOTIFY gridReset)
+    Q_PROPERTY(QSize gridSize READ gridSize NOTIFY gridReset)
+    Q_PROPERTY(int taps READ taps NOTIFY statsChanged)
+    Q_PROPERTY(int refinedTaps READ refinedTaps NOTIFY statsChanged)
+    Q_PROPERTY(int elements READ elements NOTIFY statsChanged)
+    Q_PROPERTY(int maxCount READ maxCount NOTIFY statsChanged)
+public:
+    explicit TapStatistics(AnalyzeManager *manager, QObject *parent = nullptr);
+
+    bool isLoaded() const;
+
+    int cellSize() const;
+    void setCellSize(int cellSize);
+
+    // Cells in rows of gridSize().width(); the grid grows to cover every
+    // tap seen.
+    QSize gridSize() const;
+    const QVector<quint32> &cells() const;
+
+    int taps() const;
+    int refinedTaps() const;
+    int elements() const;
+    // Highest cell count. Removed taps leave it as an upper bound until the
+    // next reload.
+    int maxCount() const;
+
+    Q_INVOKABLE int hitsFor(const QString &id) const;
+    // The count most tapped elements as {id, hits} maps.
+    Q_INVOKABLE QVariantList topElements(int count) const;
+
+public slots:
+    void reload();
+    void clear();
+
+signals:
+    void statsChanged();
+    void gridReset();
+    void cellChanged(int index);
+
+private slots:
+    void onDataAdded(const QVariantMap &point);
+    void onDataRemoved(const QString &location);
+    void onDataRefined(const QString &location, const QString &id);
+
+private:
+    struct Tap
+    {
+        QPoint point;
+        QString id;
+    };
+
+    static Tap tapFrom(const QVariantMap &point);
+    void count(const Tap &tap, int delta);
+    void countHit(const QString &id, int delta);
+    int cellIndex(const QPoint &point);
+    void resizeGrid(const QSize &size);
+    void rebuild();
+
+    AnalyzeManager *m_manager {};
+    bool m_loaded = false;
+    quint64 m_generation = 0;
+
+    QHash<QString, Tap> m_taps;
+    QHash<QString, int> m_hits;
+    int m_refinedTaps = 0;
+
+    int m_cellSize = 16;
+    QSize m_gridSize;
+    QVector<quint32> m_cells;
+    quint32 m_maxCount = 0;
+};
@@ -0,0 +1,105 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include "base64.h"
+#include "socketconnector.h"
+
+namespace {
+
+// Median throughput in MB/s of the decoded payload.
+template <typename Fn>
+double measure(int iterations, qsizetype bytes, Fn &&fn)
+{
+    QVector<qint64> nsecs;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i)
+    {
+        timer.start();
+        fn();
+        nsecs.append(timer.nsecsElapsed());
+    }
+    std::sort(nsecs.begin(), nsecs.end());
+    const double seconds = nsecs.at(nsecs.size() / 2) / 1e9;
+    return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("qainspector-base64bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares Base64::decode with QByteArray::fromBase64");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"n", "iterations"}, "Iterations per size.", "count", "20"},
+        {"sizes", "Comma separated decoded sizes in KiB.", "list", "4,64,1024,8192"},
+    });
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value("iterations").toInt());
+
+    QTextStream out(stdout);
+    out << "implementation: " << Base64::implementation() << Qt::endl;
+    out << qSetFieldWidth(10) << Qt::right << "KiB"
+        << qSetFieldWidth(14) << "Qt MB/s" << "simd MB/s" << "reply Qt" << "reply simd"
+        << qSetFieldWidth(0) << Qt::endl;
+
+    const QStringList sizes = parser.value("sizes").split(',', Qt::SkipEmptyParts);
+    for (const QString &size : sizes)
+    {
+        const qsizetype bytes = size.toLongLong() * 1024;
+
+        QByteArray payload(bytes, Qt::Uninitialized);
+        QRandomGenerator generator(42);
+        generator.fillRange(reinterpret_cast<quint32 *>(payload.data()), bytes / sizeof(quint32));
+
+        const QByteArray encoded = payload.toBase64();
+        const QByteArray line = QJsonDocument(QJsonObject {
+            { "status", 0 },
+            { "value", QString::fromLatin1(encoded) },
+        }).toJson(QJsonDocument::Compact) + '\n';
+
+        if (Base64::decode(encoded) != payload ||
+            SocketConnector::decodeScreenshot(SocketConnector::parseReply(line)) != payload)
+        {
+            qWarning() << "Decoded data mismatch for" << bytes << "bytes";
+            return 1;
+        }
+
+        // Plain decoding of the base64 text.
+        const double qt = measure(iterations, bytes, [&]() { return QByteArray::fromBase64(encoded); });
+        const double simd = measure(iterations, bytes, [&]() { return Base64::decode(encoded); });
+
+        // The whole reply: parsing the JSON line and decoding its value.
+        const double replyQt = measure(iterations, bytes,
+                                       [&]()
+                                       {
+                                           const QJsonObject object = QJsonDocument::fromJson(line).object();
+                                           return QByteArray::fromBase64(
+                                               object.value(QStringLiteral("value")).toString().toLatin1());
+                                       });
+        const double replySimd = measure(iterations, bytes,
+                                         [&]()
+                                         {
+                                             return SocketConnector::decodeScreenshot(
+                                                 SocketConnector::parseReply(line));
+                                         });
+
+        out << qSetFieldWidth(10) << size
+            << qSetFieldWidth(14) << QString::number(qt, 'f', 1) << QString::number(simd, 'f', 1)
+            << QString::number(replyQt, 'f', 1) << QString::number(replySimd, 'f', 1)
+            << qSetFieldWidth(0) << Qt::endl;
+    }
+
+    return 0;
+}
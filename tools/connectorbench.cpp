@@ -0,0 +1,287 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "socketconnector.h"
+
+namespace {
+
+struct Samples
+{
+    QVector<double> msecs;
+    qint64 bytes = 0;
+};
+
+double percentile(const QVector<double> &sorted, double p)
+{
+    if (sorted.isEmpty())
+    {
+        return 0.0;
+    }
+    const int index = qBound(0, int(std::ceil(p * sorted.size())) - 1, int(sorted.size()) - 1);
+    return sorted.at(index);
+}
+
+void report(QTextStream &out, const QString &name, Samples samples)
+{
+    std::sort(samples.msecs.begin(), samples.msecs.end());
+
+    double total = 0.0;
+    for (double msecs : samples.msecs)
+    {
+        total += msecs;
+    }
+
+    const double mbps = total > 0.0 ? (samples.bytes / (1024.0 * 1024.0)) / (total / 1000.0) : 0.0;
+
+    out << qSetFieldWidth(12) << Qt::left << name
+        << qSetFieldWidth(8) << Qt::right << samples.msecs.size()
+        << qSetFieldWidth(10) << QString::number(percentile(samples.msecs, 0.50), 'f', 2)
+        << QString::number(percentile(samples.msecs, 0.90), 'f', 2)
+        << QString::number(percentile(samples.msecs, 0.99), 'f', 2)
+        << QString::number(samples.msecs.isEmpty() ? 0.0 : samples.msecs.last(), 'f', 2)
+        << QString::number(mbps, 'f', 2)
+        << qSetFieldWidth(0) << Qt::endl;
+}
+
+// Input commands are sent asynchronously; wait until their replies arrive.
+qint64 waitForReplies(SocketConnector &connector)
+{
+    while (connector.pendingRequests() > 0 && connector.isConnected())
+    {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return 0;
+}
+
+// Waits for the reply to one request, leaving other replies pending.
+qint64 waitForAction(SocketConnector &connector, const QString &action)
+{
+    QEventLoop loop;
+    QObject::connect(&connector, &SocketConnector::requestFinished, &loop,
+                     [&](const QString &finished)
+                     {
+                         if (finished == action)
+                         {
+                             loop.quit();
+                         }
+                     });
+    QObject::connect(&connector, &SocketConnector::connectedChanged, &loop, &QEventLoop::quit);
+    loop.exec();
+    return 0;
+}
+
+template <typename Fn>
+Samples measure(int iterations, Fn &&fn)
+{
+    Samples samples;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i)
+    {
+        timer.start();
+        samples.bytes += fn();
+        samples.msecs.append(timer.nsecsElapsed() / 1e6);
+    }
+    return samples;
+}
+
+Samples measureAnalyze(SocketConnector &connector, int events, int timeout)
+{
+    Samples samples;
+    QEventLoop loop;
+    QElapsedTimer timer;
+
+    QObject::connect(connector.manager(), &AnalyzeManager::dataAdded, &loop,
+                     [&](const QVariantMap &)
+                     {
+                         samples.msecs.append(timer.nsecsElapsed() / 1e6);
+                         timer.start();
+                         if (samples.msecs.size() >= events)
+                         {
+                             loop.quit();
+                         }
+                     });
+    QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+
+    timer.start();
+    connector.startAnalyze();
+    loop.exec();
+    connector.stopAnalyze();
+
+    return samples;
+}
+
+// Runs the selected commands against one host and prints a table.
+bool run(const QCommandLineParser &parser, const QString &host, QTextStream &out)
+{
+    SocketConnector connector;
+    connector.setProperty("hostname", host);
+    connector.setProperty("port", parser.value("port"));
+    connector.setProperty("applicationName", "inspector");
+    connector.setProperty("binaryFraming", !parser.isSet("json"));
+    connector.setProperty("sharedMemory", !parser.isSet("no-shm"));
+    connector.setProperty("controlChannel", !parser.isSet("no-control"));
+    connector.setProperty("screenshotTier", parser.value("tier"));
+    connector.setConnected(true);
+
+    if (!connector.isConnected())
+    {
+        qWarning() << "Failed to connect to" << host << parser.value("port");
+        return false;
+    }
+
+    const int iterations = qMax(1, parser.value("iterations").toInt());
+    const QString filter = parser.value("filter");
+    const QPoint from(100, 100);
+    const QPoint to(100, 600);
+
+    out << "host: " << host << ", protocol: " << connector.protocol() << Qt::endl;
+    out << qSetFieldWidth(12) << Qt::left << "command"
+        << qSetFieldWidth(8) << Qt::right << "n"
+        << qSetFieldWidth(10) << "p50 ms" << "p90 ms" << "p99 ms" << "max ms" << "MB/s"
+        << qSetFieldWidth(0) << Qt::endl;
+
+    const QStringList commands = parser.value("commands").split(',', Qt::SkipEmptyParts);
+    for (const QString &command : commands)
+    {
+        if (command == QLatin1String("dump"))
+        {
+            report(out, command, measure(iterations, [&]() {
+                return qint64(connector.getDumpTree(filter).toUtf8().size());
+            }));
+        }
+        else if (command == QLatin1String("screenshot"))
+        {
+            report(out, command, measure(iterations, [&]() {
+                return qint64(connector.getGrabWindow().size());
+            }));
+        }
+        else if (command == QLatin1String("live"))
+        {
+            // Screenshots as the dump watcher requests them; in auto mode
+            // the format may change while this runs.
+            QStringList formats;
+            report(out, command, measure(iterations, [&]() {
+                qint64 bytes = 0;
+                connector.sendRequest(connector.liveScreenshotRequest(),
+                                      [&](const SocketConnector::Reply &reply) {
+                                          bytes = SocketConnector::decodeScreenshot(reply).size();
+                                      });
+                if (!formats.contains(connector.screenshotFormat()))
+                {
+                    formats.append(connector.screenshotFormat());
+                }
+                waitForReplies(connector);
+                return bytes;
+            }));
+            out << "  formats: " << formats.join(QLatin1String(", ")) << ", last: "
+                << connector.screenshotFormat() << Qt::endl;
+        }
+        else if (command == QLatin1String("click"))
+        {
+            report(out, command, measure(iterations, [&]() {
+                connector.mousePressed(from);
+                connector.mouseReleased(from);
+                return waitForReplies(connector);
+            }));
+        }
+        else if (command == QLatin1String("move"))
+        {
+            report(out, command, measure(iterations, [&]() {
+                connector.mousePressed(from);
+                connector.mouseMoved(to);
+                connector.mouseReleased(to);
+                return waitForReplies(connector);
+            }));
+        }
+        else if (command == QLatin1String("click-load"))
+        {
+            // Taps while the main connection keeps --load dumps in flight.
+            const int load = qMax(1, parser.value("load").toInt());
+            int inFlight = 0;
+            report(out, command, measure(iterations, [&]() {
+                while (inFlight < load)
+                {
+                    ++inFlight;
+                    connector.sendRequest(SocketConnector::dumpTreeRequest(filter),
+                                          [&inFlight](const SocketConnector::Reply &) { --inFlight; });
+                }
+                connector.mousePressed(from);
+                connector.mouseReleased(from);
+                return waitForAction(connector, QStringLiteral("app:click"));
+            }));
+            connector.cancelBulkRequests();
+            waitForReplies(connector);
+        }
+        else if (command == QLatin1String("analyze"))
+        {
+            const int events = qMax(1, parser.value("events").toInt());
+            report(out, command, measureAnalyze(connector, events, events * 10000));
+        }
+        else
+        {
+            qWarning() << "Unknown command:" << command;
+        }
+    }
+
+    connector.setConnected(false);
+    out << Qt::endl;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("qainspector-bench");
+    app.setOrganizationName("coderus");
+    app.setOrganizationDomain("org.coderus");
+
+    // Analyze recordings produced by the benchmark must not end up next to real ones.
+    QStandardPaths::setTestModeEnabled(true);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Latency and throughput harness for SocketConnector");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"H", "host"}, "Host to connect to.", "host", "127.0.0.1"},
+        {{"p", "port"}, "Port to connect to.", "port", "8888"},
+        {{"n", "iterations"}, "Iterations per command.", "count", "50"},
+        {{"c", "commands"}, "Comma separated commands: dump,screenshot,live,click,move,click-load,analyze.", "list",
+         "dump,screenshot,click,move"},
+        {"filter", "Dump filter JSON passed to getDumpTree.", "json", ""},
+        {"events", "Analyze events to wait for.", "count", "3"},
+        {"load", "Dumps kept in flight by click-load.", "count", "2"},
+        {"tier", "Screenshot tier for live: auto, lossy, raw or lossless.", "tier", "auto"},
+        {"json", "Do not offer binary framing, measure the JSON protocol."},
+        {"local", "Run the commands again over this Unix domain socket of the mock server.", "path"},
+        {"no-shm", "Do not offer the shared memory ring over Unix domain sockets."},
+        {"no-control", "Send input over the main connection instead of a control connection."},
+    });
+    parser.process(app);
+
+    QStringList hosts {parser.value("host")};
+    if (parser.isSet("local"))
+    {
+        hosts.append(QStringLiteral("unix:") + parser.value("local"));
+    }
+
+    QTextStream out(stdout);
+    for (const QString &host : std::as_const(hosts))
+    {
+        if (!run(parser, host, out))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
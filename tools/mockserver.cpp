@@ -0,0 +1,580 @@
+#include "mockserver.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QRect>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace {
+
+const int s_pumpInterval = 5;
+
+// Smaller payloads are cheaper to send inline than to go through the ring.
+const qsizetype s_ringThreshold = 64 * 1024;
+
+QJsonObject makeNode(int budget, int &serial, const QRect &rect)
+{
+    static const QStringList classes {
+        QStringLiteral("QQuickItem"),
+        QStringLiteral("QQuickRectangle"),
+        QStringLiteral("QQuickText"),
+        QStringLiteral("QQuickListView"),
+        QStringLiteral("QQuickImage"),
+        QStringLiteral("QQuickMouseArea"),
+    };
+
+    const int id = serial++;
+    QJsonObject node {
+        { "id", QStringLiteral("0x%1").arg(id, 8, 16, QLatin1Char('0')) },
+        { "classname", classes.at(id % classes.size()) },
+        { "objectName", id % 7 == 0 ? QStringLiteral("item%1").arg(id) : QString() },
+        { "objectId", QString() },
+        { "mainTextProperty", id % 3 == 0 ? QStringLiteral("Text %1").arg(id) : QString() },
+        { "abs_x", rect.x() },
+        { "abs_y", rect.y() },
+        { "width", rect.width() },
+        { "height", rect.height() },
+        { "visible", true },
+        { "enabled", true },
+        { "opacity", 1 },
+    };
+
+    const int childBudget = budget - 1;
+    if (childBudget <= 0)
+    {
+        return node;
+    }
+
+    const int fanout = qMin(childBudget, 4);
+    const int rowHeight = qMax(1, rect.height() / fanout);
+    QJsonArray children;
+    for (int i = 0; i < fanout; ++i)
+    {
+        const int share = childBudget / fanout + (i < childBudget % fanout ? 1 : 0);
+        const QRect childRect(rect.x(), rect.y() + i * rowHeight, rect.width(), rowHeight);
+        children.append(makeNode(share, serial, childRect));
+    }
+    node.insert(QStringLiteral("children"), children);
+    return node;
+}
+
+QByteArray makeReply(const QJsonValue &value, int status, const QJsonObject &fields)
+{
+    QJsonObject json = fields;
+    json.insert(QStringLiteral("status"), status);
+    json.insert(QStringLiteral("value"), value);
+    QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    data.append('\n');
+    return data;
+}
+
+} // namespace
+
+MockSession::MockSession(QIODevice *socket, const MockPayloads &payloads, QObject *parent)
+    : QObject(parent)
+    , m_socket(socket)
+    , m_payloads(payloads)
+    , m_pumpTimer(new QTimer(this))
+    , m_analyzeTimer(new QTimer(this))
+{
+    m_socket->setParent(this);
+    m_compressedDump = qCompress(m_payloads.dump);
+
+    m_pumpTimer->setInterval(s_pumpInterval);
+    connect(m_pumpTimer, &QTimer::timeout, this, &MockSession::pump);
+    connect(m_analyzeTimer, &QTimer::timeout, this, &MockSession::emitAnalyzeEvent);
+
+    connect(m_socket, &QIODevice::readyRead, this, &MockSession::onReadyRead);
+}
+
+void MockSession::setRtt(int msecs)
+{
+    m_rtt = msecs;
+}
+
+void MockSession::setBandwidth(qint64 bytesPerSecond)
+{
+    m_bandwidth = bytesPerSecond;
+}
+
+void MockSession::setAnalyzeEvents(int count, int intervalMsecs)
+{
+    m_analyzeCount = count;
+    m_analyzeTimer->setInterval(intervalMsecs);
+}
+
+void MockSession::setBinaryFraming(bool enabled)
+{
+    m_binaryFramingEnabled = enabled;
+}
+
+void MockSession::setRingAllowed(bool allowed)
+{
+    m_ringAllowed = allowed;
+}
+
+void MockSession::onReadyRead()
+{
+    while (m_socket->canReadLine())
+    {
+        const QByteArray line = m_socket->readLine().trimmed();
+        if (line.isEmpty())
+        {
+            continue;
+        }
+
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        if (error.error != QJsonParseError::NoError || !doc.isObject())
+        {
+            qWarning() << Q_FUNC_INFO << "Malformed request:" << error.errorString();
+            reply(error.errorString(), 1);
+            continue;
+        }
+
+        handleRequest(doc.object());
+    }
+}
+
+void MockSession::handleRequest(const QJsonObject &request)
+{
+    const QString action = request.value(QStringLiteral("action")).toString();
+    const QJsonValue params = request.value(QStringLiteral("params"));
+
+    if (action == QLatin1String("initialize"))
+    {
+        initialize(request);
+    }
+    else if (action == QLatin1String("getScreenshot"))
+    {
+        replyScreenshot(params.toObject());
+    }
+    else if (action == QLatin1String("startAnalyze"))
+    {
+        m_analyzeSent = 0;
+        m_analyzeTimer->start();
+    }
+    else if (action == QLatin1String("stopAnalyze"))
+    {
+        m_analyzeTimer->stop();
+    }
+    else if (action == QLatin1String("execute") && params.isObject() &&
+             params.toObject().contains(QStringLiteral("app:dumpTreeFilter")))
+    {
+        if (!m_binaryFraming)
+        {
+            reply(QString::fromLatin1(m_compressedDump.toBase64()));
+            return;
+        }
+        // The dump never changes, so it is only compressed once per session.
+        if (m_packedDump.isEmpty())
+        {
+            m_packedDump = PayloadCodec::compress(m_codec, m_payloads.dump);
+        }
+        enqueue(payloadFrame(m_packedDump, m_codec, m_payloads.dump.size()));
+    }
+    else if (action == QLatin1String("execute") && params.isArray())
+    {
+        const QString method = params.toArray().at(0).toString();
+        if (method == QLatin1String("app:click") ||
+            method == QLatin1String("app:pressAndHold") ||
+            method == QLatin1String("app:move") ||
+            method == QLatin1String("app:movePath"))
+        {
+            reply(QJsonValue());
+        }
+        else
+        {
+            reply(QStringLiteral("Unsupported method: %1").arg(method), 1);
+        }
+    }
+    else
+    {
+        qWarning() << Q_FUNC_INFO << "Unsupported action:" << action;
+        reply(QStringLiteral("Unsupported action: %1").arg(action), 1);
+    }
+}
+
+void MockSession::initialize(const QJsonObject &request)
+{
+    // The initialize reply itself is always a JSON line; binary framing
+    // starts with the next reply.
+    m_binaryFraming = false;
+    m_packedDump.clear();
+    m_ring.detach();
+    m_screenshotFormats.clear();
+
+    const QJsonObject framing = request.value(QStringLiteral("framing")).toObject();
+    const QJsonArray offered = framing.value(QStringLiteral("codecs")).toArray();
+    const QStringList supported = PayloadCodec::supportedCodecs();
+
+    QJsonObject json {
+        { "status", 0 },
+        { "value", QJsonValue() },
+    };
+    if (m_binaryFramingEnabled)
+    {
+        for (const QJsonValue &codec : offered)
+        {
+            if (supported.contains(codec.toString()))
+            {
+                m_codec = PayloadCodec::codecFromName(codec.toString());
+                m_binaryFraming = true;
+                json.insert(QStringLiteral("framing"), QStringLiteral("binary"));
+                json.insert(QStringLiteral("codec"), codec.toString());
+                break;
+            }
+        }
+    }
+
+    const QJsonObject ring = framing.value(QStringLiteral("ring")).toObject();
+    if (m_binaryFraming && m_ringAllowed && !ring.isEmpty() &&
+        m_ring.attach(ring.value(QStringLiteral("key")).toString()))
+    {
+        json.insert(QStringLiteral("ring"), true);
+    }
+
+    const QList<QByteArray> encodable = QImageWriter::supportedImageFormats();
+    const QJsonArray formats = request.value(QStringLiteral("screenshot")).toObject()
+                                   .value(QStringLiteral("formats")).toArray();
+    for (const QJsonValue &format : formats)
+    {
+        if (encodable.contains(format.toString().toLatin1()))
+        {
+            m_screenshotFormats.append(format.toString());
+        }
+    }
+    if (!m_screenshotFormats.isEmpty())
+    {
+        json.insert(QStringLiteral("screenshot"),
+                    QJsonObject {{ "formats", QJsonArray::fromStringList(m_screenshotFormats) }});
+    }
+
+    qDebug() << Q_FUNC_INFO << "Binary framing:" << m_binaryFraming << PayloadCodec::codecName(m_codec)
+             << "ring:" << m_ring.isAttached() << "screenshots:" << m_screenshotFormats;
+
+    QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    data.append('\n');
+    enqueue(data);
+}
+
+void MockSession::reply(const QJsonValue &value, int status, const QJsonObject &fields)
+{
+    if (m_binaryFraming)
+    {
+        QJsonObject header = fields;
+        header.insert(QStringLiteral("status"), status);
+        header.insert(QStringLiteral("value"), value);
+        enqueue(PayloadCodec::encodeFrame(header, QByteArray(), PayloadCodec::None));
+        return;
+    }
+    enqueue(makeReply(value, status, fields));
+}
+
+void MockSession::replyPayload(const QByteArray &payload, PayloadCodec::Codec codec, const QByteArray &legacyValue,
+                               const QJsonObject &fields)
+{
+    if (!m_binaryFraming)
+    {
+        reply(QString::fromLatin1(legacyValue), 0, fields);
+        return;
+    }
+
+    enqueue(payloadFrame(PayloadCodec::compress(codec, payload), codec, payload.size(), fields));
+}
+
+void MockSession::replyScreenshot(const QJsonObject &params)
+{
+    const QString format = params.value(QStringLiteral("format")).toString();
+    if (!m_screenshotFormats.contains(format) || format == QLatin1String("png"))
+    {
+        // PNG data does not get any smaller, so it is never recompressed.
+        replyPayload(m_payloads.screenshot, PayloadCodec::None, m_payloads.screenshot.toBase64(),
+                     {{ "format", "png" }});
+        return;
+    }
+
+    if (m_screenImage.isNull())
+    {
+        m_screenImage = QImage::fromData(m_payloads.screenshot);
+    }
+
+    // Encoded for every request, the way a device would, so the cost of
+    // each format shows up in the frame latency.
+    const bool raw = format == QLatin1String("ppm");
+    QByteArray encoded;
+    QBuffer buffer(&encoded);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, format.toLatin1());
+    writer.setQuality(params.value(QStringLiteral("quality")).toInt(-1));
+    if (!writer.write(raw ? m_screenImage.convertToFormat(QImage::Format_RGB888) : m_screenImage))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to encode" << format << writer.errorString();
+        reply(writer.errorString(), 1);
+        return;
+    }
+
+    // Raw pixels are left to the frame codec; lossy images are not
+    // compressed again.
+    replyPayload(encoded, raw ? m_codec : PayloadCodec::None, encoded.toBase64(), {{ "format", format }});
+}
+
+QByteArray MockSession::payloadFrame(const QByteArray &packed, PayloadCodec::Codec codec, qsizetype rawSize,
+                                     const QJsonObject &fields)
+{
+    QJsonObject header = fields;
+    header.insert(QStringLiteral("status"), 0);
+
+    if (m_ring.isAttached() && packed.size() >= s_ringThreshold)
+    {
+        const qint64 offset = m_ring.write(packed);
+        if (offset >= 0)
+        {
+            header.insert(QStringLiteral("ring"), QJsonArray { offset, packed.size() });
+            return PayloadCodec::encodePackedFrame(header, QByteArray(), codec, rawSize);
+        }
+        qDebug() << Q_FUNC_INFO << "Ring full, sending" << packed.size() << "bytes inline";
+    }
+
+    return PayloadCodec::encodePackedFrame(header, packed, codec, rawSize);
+}
+
+void MockSession::enqueue(const QByteArray &data)
+{
+    auto send = [this, data]()
+    {
+        m_outgoing.append(data);
+        pump();
+    };
+
+    if (m_rtt > 0)
+    {
+        QTimer::singleShot(m_rtt, this, send);
+    }
+    else
+    {
+        send();
+    }
+}
+
+void MockSession::pump()
+{
+    if (m_outgoing.isEmpty())
+    {
+        m_pumpTimer->stop();
+        return;
+    }
+
+    if (m_bandwidth <= 0)
+    {
+        m_socket->write(m_outgoing);
+        m_outgoing.clear();
+        return;
+    }
+
+    if (!m_pumpTimer->isActive())
+    {
+        m_pumpClock.start();
+        m_pumpTimer->start();
+        return;
+    }
+
+    const qint64 elapsed = qMax<qint64>(1, m_pumpClock.restart());
+    const qint64 budget = qMax<qint64>(1, m_bandwidth * elapsed / 1000);
+    const qint64 chunk = qMin<qint64>(budget, m_outgoing.size());
+
+    m_socket->write(m_outgoing.constData(), chunk);
+    m_outgoing.remove(0, chunk);
+}
+
+void MockSession::emitAnalyzeEvent()
+{
+    if (m_analyzeCount > 0 && m_analyzeSent >= m_analyzeCount)
+    {
+        m_analyzeTimer->stop();
+        return;
+    }
+
+    const QPoint tap = m_payloads.taps.isEmpty()
+        ? QPoint(100, 100)
+        : m_payloads.taps.at(m_analyzeSent % m_payloads.taps.size());
+    ++m_analyzeSent;
+
+    QByteArray data;
+    data.append(QStringLiteral("pressed: %1,%2\n").arg(tap.x()).arg(tap.y()).toLatin1());
+
+    data.append("dump start: " + QByteArray::number(m_compressedDump.size()) + "\n");
+    data.append(m_compressedDump);
+    data.append("\ndump end\n");
+
+    const QByteArray screen = qCompress(m_payloads.screenshot);
+    data.append("screen start: " + QByteArray::number(screen.size()) + "\n");
+    data.append(screen);
+    data.append("\nscreen end\n");
+
+    enqueue(data);
+}
+
+MockServer::MockServer(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_localServer(new QLocalServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MockServer::onNewConnection);
+    connect(m_localServer, &QLocalServer::newConnection, this, &MockServer::onNewLocalConnection);
+}
+
+bool MockServer::loadRecording(const QString &location)
+{
+    QDir dir(location);
+
+    QFile dumpFile(dir.absoluteFilePath(QStringLiteral("dump.json")));
+    if (!dumpFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to open dump file:" << dumpFile.fileName();
+        return false;
+    }
+    m_payloads.dump = dumpFile.readAll();
+
+    QFile screenFile(dir.absoluteFilePath(QStringLiteral("screenshot.png")));
+    if (!screenFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to open screenshot file:" << screenFile.fileName();
+        return false;
+    }
+    m_payloads.screenshot = screenFile.readAll();
+
+    QFile pointFile(dir.absoluteFilePath(QStringLiteral("point.json")));
+    if (pointFile.open(QIODevice::ReadOnly))
+    {
+        const QJsonObject point = QJsonDocument::fromJson(pointFile.readAll()).object();
+        m_payloads.taps = {
+            QPoint(point.value(QStringLiteral("x")).toInt(), point.value(QStringLiteral("y")).toInt())
+        };
+    }
+
+    return true;
+}
+
+void MockServer::generatePayloads(int dumpNodes, const QSize &screenSize)
+{
+    int serial = 0;
+    const QJsonObject root = makeNode(qMax(1, dumpNodes), serial, QRect(QPoint(), screenSize));
+    m_payloads.dump = QJsonDocument(root).toJson(QJsonDocument::Compact);
+
+    QImage image(screenSize, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+        {
+            line[x] = qRgb(x * 255 / image.width(), y * 255 / image.height(), (x ^ y) & 0xff);
+        }
+    }
+
+    QBuffer buffer(&m_payloads.screenshot);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+
+    m_payloads.taps.clear();
+    for (int i = 1; i <= 8; ++i)
+    {
+        m_payloads.taps.append(QPoint(screenSize.width() * i / 9, screenSize.height() * i / 9));
+    }
+}
+
+void MockServer::setRtt(int msecs)
+{
+    m_rtt = msecs;
+}
+
+void MockServer::setBandwidth(qint64 bytesPerSecond)
+{
+    m_bandwidth = bytesPerSecond;
+}
+
+void MockServer::setAnalyzeEvents(int count, int intervalMsecs)
+{
+    m_analyzeCount = count;
+    m_analyzeInterval = intervalMsecs;
+}
+
+void MockServer::setBinaryFraming(bool enabled)
+{
+    m_binaryFraming = enabled;
+}
+
+bool MockServer::listen(quint16 port)
+{
+    if (!m_server->listen(QHostAddress::Any, port))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to listen:" << m_server->errorString();
+        return false;
+    }
+
+    qInfo() << "Mock server listening on port" << m_server->serverPort()
+            << "dump:" << m_payloads.dump.size() << "bytes"
+            << "screenshot:" << m_payloads.screenshot.size() << "bytes";
+    return true;
+}
+
+bool MockServer::listenLocal(const QString &path)
+{
+    QLocalServer::removeServer(path);
+    if (!m_localServer->listen(path))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to listen:" << m_localServer->errorString();
+        return false;
+    }
+
+    qInfo() << "Mock server listening on" << m_localServer->fullServerName();
+    return true;
+}
+
+const MockPayloads &MockServer::payloads() const
+{
+    return m_payloads;
+}
+
+void MockServer::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection())
+    {
+        qDebug() << Q_FUNC_INFO << socket->peerAddress() << socket->peerPort();
+
+        MockSession *session = createSession(socket);
+        connect(socket, &QTcpSocket::disconnected, session, &QObject::deleteLater);
+    }
+}
+
+void MockServer::onNewLocalConnection()
+{
+    while (QLocalSocket *socket = m_localServer->nextPendingConnection())
+    {
+        qDebug() << Q_FUNC_INFO << m_localServer->fullServerName();
+
+        MockSession *session = createSession(socket);
+        session->setRingAllowed(true);
+        connect(socket, &QLocalSocket::disconnected, session, &QObject::deleteLater);
+    }
+}
+
+MockSession *MockServer::createSession(QIODevice *socket)
+{
+    MockSession *session = new MockSession(socket, m_payloads, this);
+    session->setRtt(m_rtt);
+    session->setBandwidth(m_bandwidth);
+    session->setAnalyzeEvents(m_analyzeCount, m_analyzeInterval);
+    session->setBinaryFraming(m_binaryFraming);
+    return session;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QJsonObject>
+#include <QObject>
+#include <QPoint>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+#include "payloadcodec.h"
+#include "sharedring.h"
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+class QTimer;
+
+// Payloads served by the mock server. The dump is kept uncompressed, the same
+// way the analyze recorder stores it in dump.json.
+struct MockPayloads
+{
+    QByteArray dump;
+    QByteArray screenshot;
+    QVector<QPoint> taps;
+};
+
+class MockSession : public QObject
+{
+    Q_OBJECT
+public:
+    MockSession(QIODevice *socket, const MockPayloads &payloads, QObject *parent = nullptr);
+
+    void setRtt(int msecs);
+    void setBandwidth(qint64 bytesPerSecond);
+    void setAnalyzeEvents(int count, int intervalMsecs);
+    void setBinaryFraming(bool enabled);
+    // Accept the inspector's shared memory ring; only for local sockets.
+    void setRingAllowed(bool allowed);
+
+private slots:
+    void onReadyRead();
+    void pump();
+    void emitAnalyzeEvent();
+
+private:
+    void handleRequest(const QJsonObject &request);
+    void initialize(const QJsonObject &request);
+    void reply(const QJsonValue &value, int status = 0, const QJsonObject &fields = {});
+    void replyPayload(const QByteArray &payload, PayloadCodec::Codec codec, const QByteArray &legacyValue,
+                      const QJsonObject &fields = {});
+    void replyScreenshot(const QJsonObject &params);
+    // Frame for a payload already compressed with codec, placed in the ring
+    // when there is one and it has room.
+    QByteArray payloadFrame(const QByteArray &packed, PayloadCodec::Codec codec, qsizetype rawSize,
+                            const QJsonObject &fields = {});
+    void enqueue(const QByteArray &data);
+
+    QIODevice *m_socket {};
+    const MockPayloads &m_payloads;
+    QByteArray m_compressedDump;
+
+    bool m_binaryFramingEnabled = true;
+    bool m_binaryFraming = false;
+    PayloadCodec::Codec m_codec = PayloadCodec::None;
+    QByteArray m_packedDump;
+
+    bool m_ringAllowed = false;
+    SharedRing m_ring;
+
+    // Screenshot formats agreed on in initialize, besides the PNG payload.
+    QStringList m_screenshotFormats;
+    QImage m_screenImage;
+
+    int m_rtt = 0;
+    qint64 m_bandwidth = 0;
+    QByteArray m_outgoing;
+    QTimer *m_pumpTimer {};
+    QElapsedTimer m_pumpClock;
+
+    QTimer *m_analyzeTimer {};
+    int m_analyzeCount = 0;
+    int m_analyzeSent = 0;
+};
+
+class MockServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MockServer(QObject *parent = nullptr);
+
+    bool loadRecording(const QString &location);
+    void generatePayloads(int dumpNodes, const QSize &screenSize);
+
+    void setRtt(int msecs);
+    void setBandwidth(qint64 bytesPerSecond);
+    void setAnalyzeEvents(int count, int intervalMsecs);
+    void setBinaryFraming(bool enabled);
+
+    bool listen(quint16 port);
+    bool listenLocal(const QString &path);
+    const MockPayloads &payloads() const;
+
+private slots:
+    void onNewConnection();
+    void onNewLocalConnection();
+
+private:
+    MockSession *createSession(QIODevice *socket);
+
+    QTcpServer *m_server {};
+    QLocalServer *m_localServer {};
+    MockPayloads m_payloads;
+
+    int m_rtt = 0;
+    qint64 m_bandwidth = 0;
+    int m_analyzeCount = 1;
+    int m_analyzeInterval = 1500;
+    bool m_binaryFraming = true;
+};
@@ -0,0 +1,66 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include "mockserver.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("qainspector-mockserver");
+    app.setOrganizationName("coderus");
+    app.setOrganizationDomain("org.coderus");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Local stand-in for the qaengine inspector protocol");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"p", "port"}, "Port to listen on.", "port", "8888"},
+        {"local", "Also listen on this Unix domain socket; clients connect with host unix:<path>.", "path"},
+        {{"r", "recording"}, "Analyze recording directory to replay (dump.json, screenshot.png, point.json).", "dir"},
+        {"nodes", "Number of nodes in the generated dump.", "count", "5000"},
+        {"screen", "Size of the generated screenshot, WxH.", "size", "1080x1920"},
+        {"rtt", "Artificial round-trip time in milliseconds.", "msecs", "0"},
+        {"bandwidth", "Outgoing bandwidth limit in KiB/s, 0 for unlimited.", "kibps", "0"},
+        {"events", "Analyze events sent per startAnalyze, 0 for endless.", "count", "1"},
+        {"event-interval", "Interval between analyze events in milliseconds.", "msecs", "1500"},
+        {"json-only", "Refuse binary framing and answer with the JSON protocol only."},
+    });
+    parser.process(app);
+
+    MockServer server;
+
+    if (parser.isSet("recording"))
+    {
+        if (!server.loadRecording(parser.value("recording")))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        const QStringList screen = parser.value("screen").split('x');
+        const QSize screenSize(screen.value(0).toInt(), screen.value(1).toInt());
+        if (screenSize.isEmpty())
+        {
+            qWarning() << "Invalid screen size:" << parser.value("screen");
+            return 1;
+        }
+        server.generatePayloads(parser.value("nodes").toInt(), screenSize);
+    }
+
+    server.setRtt(parser.value("rtt").toInt());
+    server.setBandwidth(parser.value("bandwidth").toLongLong() * 1024);
+    server.setAnalyzeEvents(parser.value("events").toInt(), parser.value("event-interval").toInt());
+    server.setBinaryFraming(!parser.isSet("json-only"));
+
+    if (!server.listen(parser.value("port").toUShort()))
+    {
+        return 1;
+    }
+    if (parser.isSet("local") && !server.listenLocal(parser.value("local")))
+    {
+        return 1;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,157 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <iterator>
+
+#include "mytreemodel2.h"
+
+namespace {
+
+const char *const s_classnames[] = {
+    "QQuickItem", "QQuickRectangle", "QQuickText", "QQuickImage", "QQuickListView",
+    "QQuickColumn", "QQuickRow", "QQuickMouseArea", "QQuickLoader", "QQuickFlickable",
+};
+
+// Random tree of exactly count nodes with two to eight children per inner
+// node, shaped roughly like an application window.
+QJsonObject makeNode(int count, QRandomGenerator &generator, int &nextId)
+{
+    const int id = nextId++;
+    QJsonObject node {
+        { "classname", s_classnames[generator.bounded(int(std::size(s_classnames)))] },
+        { "objectName", id % 7 == 0 ? QStringLiteral("item%1").arg(id) : QString() },
+        { "objectId", QStringLiteral("0x%1").arg(id, 8, 16, QLatin1Char('0')) },
+        { "mainTextProperty", id % 3 == 0 ? QStringLiteral("Text %1").arg(id) : QString() },
+        { "abs_x", generator.bounded(1080) },
+        { "abs_y", generator.bounded(1920) },
+        { "width", generator.bounded(1, 1080) },
+        { "height", generator.bounded(1, 400) },
+        { "enabled", true },
+        { "visible", generator.bounded(10) != 0 },
+    };
+
+    int remaining = count - 1;
+    if (remaining > 0)
+    {
+        const int childCount = remaining == 1 ? 1 : generator.bounded(2, qMin(8, remaining) + 1);
+        QJsonArray children;
+        for (int i = 0; i < childCount; ++i)
+        {
+            // Leave at least one node for every child still to come.
+            const int left = childCount - i - 1;
+            const int size = i == childCount - 1 ? remaining : generator.bounded(1, remaining - left + 1);
+            children.append(makeNode(size, generator, nextId));
+            remaining -= size;
+        }
+        node.insert("children", children);
+    }
+    return node;
+}
+
+bool sameTree(const MyTreeModel2 &a, const MyTreeModel2 &b)
+{
+    if (a.nodeCount() != b.nodeCount())
+    {
+        return false;
+    }
+    for (int position = 0; position < a.nodeCount(); ++position)
+    {
+        if (a.parentAt(position) != b.parentAt(position) ||
+            a.itemAt(position)->row() != b.itemAt(position)->row() ||
+            a.itemAt(position)->data() != b.itemAt(position)->data())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Fn>
+double median(int iterations, Fn &&fn)
+{
+    QVector<double> msecs;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i)
+    {
+        timer.start();
+        fn();
+        msecs.append(timer.nsecsElapsed() / 1e6);
+    }
+    std::sort(msecs.begin(), msecs.end());
+    return msecs.at(msecs.size() / 2);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("qainspector-treebench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures MyTreeModel2::fillModel across thread counts");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"n", "iterations"}, "Iterations per thread count.", "count", "5"},
+        {"nodes", "Nodes in the generated dump.", "count", "500000"},
+        {"threshold", "Subtree size built as one task.", "nodes", "8192"},
+        {"dump", "Use this dump.json instead of a generated one.", "file"},
+    });
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value("iterations").toInt());
+    const int threshold = qMax(1, parser.value("threshold").toInt());
+
+    QJsonObject root;
+    if (parser.isSet("dump"))
+    {
+        QFile file(parser.value("dump"));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Failed to open" << file.fileName();
+            return 1;
+        }
+        root = QJsonDocument::fromJson(file.readAll()).object();
+    }
+    else
+    {
+        QRandomGenerator generator(42);
+        int nextId = 0;
+        root = makeNode(qMax(1, parser.value("nodes").toInt()), generator, nextId);
+    }
+
+    MyTreeModel2 serial;
+    serial.setBuildThreshold(0);
+    const double serialMsecs = median(iterations, [&]() { serial.fillModel(root); });
+
+    QTextStream out(stdout);
+    out << "nodes: " << serial.nodeCount() << ", threshold: " << threshold << Qt::endl;
+    out << qSetFieldWidth(10) << Qt::right << "threads" << "ms" << "speedup" << "same"
+        << qSetFieldWidth(0) << Qt::endl;
+    out << qSetFieldWidth(10) << "serial" << QString::number(serialMsecs, 'f', 1) << "1.00" << "-"
+        << qSetFieldWidth(0) << Qt::endl;
+
+    MyTreeModel2 parallel;
+    parallel.setBuildThreshold(threshold);
+    for (int threads = 1; threads <= QThread::idealThreadCount(); threads *= 2)
+    {
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+        const double msecs = median(iterations, [&]() { parallel.fillModel(root); });
+
+        out << qSetFieldWidth(10) << threads << QString::number(msecs, 'f', 1)
+            << QString::number(serialMsecs / msecs, 'f', 2) << (sameTree(serial, parallel) ? "yes" : "NO")
+            << qSetFieldWidth(0) << Qt::endl;
+    }
+
+    return 0;
+}
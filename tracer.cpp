@@ -0,0 +1,223 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QStandardPaths>
+#include <QThread>
+
+std::atomic<bool> Tracer::s_enabled {false};
+
+namespace {
+
+const char *internName(const QString &name)
+{
+    static QMutex mutex;
+    static QHash<QString, QByteArray> names;
+
+    QMutexLocker locker(&mutex);
+    auto it = names.find(name);
+    if (it == names.end())
+    {
+        it = names.insert(name, name.toUtf8());
+    }
+    return it->constData();
+}
+
+} // namespace
+
+Tracer::Tracer(QObject *parent)
+    : QObject(parent)
+    , m_slots(new Slot[s_capacity])
+{
+    m_clock.start();
+
+    if (qEnvironmentVariableIsSet("QAINSPECTOR_TRACE"))
+    {
+        s_enabled.store(true, std::memory_order_relaxed);
+    }
+}
+
+Tracer *Tracer::instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+bool Tracer::isEnabled() const
+{
+    return enabled();
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    if (s_enabled.exchange(enabled) == enabled)
+    {
+        return;
+    }
+
+    emit enabledChanged(enabled);
+}
+
+qint64 Tracer::timestamp() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::record(const char *category, const char *name, qint64 start, qint64 end)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    const quint64 index = m_head.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = m_slots[index & (s_capacity - 1)];
+
+    // Per-slot sequence lock: readers skip slots that are being rewritten.
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(end - start, std::memory_order_relaxed);
+    slot.thread.store(reinterpret_cast<quintptr>(QThread::currentThreadId()), std::memory_order_relaxed);
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+QVector<TraceEvent> Tracer::snapshot() const
+{
+    QVector<TraceEvent> events;
+
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    const quint64 first = head > s_capacity ? head - s_capacity : 0;
+    events.reserve(int(head - first));
+
+    for (quint64 index = first; index < head; ++index)
+    {
+        const Slot &slot = m_slots[index & (s_capacity - 1)];
+
+        const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != index + 1)
+        {
+            continue;
+        }
+
+        TraceEvent event;
+        event.category = slot.category.load(std::memory_order_relaxed);
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.start = slot.start.load(std::memory_order_relaxed);
+        event.duration = slot.duration.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+
+        events.append(event);
+    }
+
+    return events;
+}
+
+qint64 Tracer::now() const
+{
+    return timestamp();
+}
+
+void Tracer::complete(const QString &name, qint64 start)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    record("qml", internName(name), start, timestamp());
+}
+
+QVariantList Tracer::recent(int count) const
+{
+    const QVector<TraceEvent> events = snapshot();
+
+    QVariantList result;
+    for (int i = events.size() - 1; i >= 0 && result.size() < count; --i)
+    {
+        const TraceEvent &event = events.at(i);
+        result.append(QVariantMap {
+            { "category", QString::fromUtf8(event.category) },
+            { "name", QString::fromUtf8(event.name) },
+            { "duration", event.duration / 1000.0 },
+        });
+    }
+    return result;
+}
+
+QString Tracer::exportChromeTrace(const QString &fileName) const
+{
+    QString location = fileName;
+    if (location.isEmpty())
+    {
+        // Not under the app data directory, every directory there is taken
+        // for a recording.
+        QDir dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+        dir.mkpath(QStringLiteral("traces"));
+        location = dir.absoluteFilePath(
+            QStringLiteral("traces/trace-%1.json").arg(QDateTime::currentMSecsSinceEpoch()));
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QHash<quintptr, int> threads;
+
+    QJsonArray traceEvents;
+    for (const TraceEvent &event : snapshot())
+    {
+        auto thread = threads.find(event.thread);
+        if (thread == threads.end())
+        {
+            thread = threads.insert(event.thread, threads.size() + 1);
+        }
+
+        traceEvents.append(QJsonObject {
+            { "name", QString::fromUtf8(event.name) },
+            { "cat", QString::fromUtf8(event.category) },
+            { "ph", "X" },
+            { "ts", event.start },
+            { "dur", event.duration },
+            { "pid", pid },
+            { "tid", thread.value() },
+        });
+    }
+
+    const QJsonObject json {
+        { "traceEvents", traceEvents },
+        { "displayTimeUnit", "ms" },
+    };
+
+    QFile file(location);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << Q_FUNC_INFO << "Failed to open file for writing:" << file.fileName();
+        return QString();
+    }
+    file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+
+    qDebug() << Q_FUNC_INFO << "Exported" << traceEvents.size() << "events to" << location;
+    return location;
+}
+
+void Tracer::clear()
+{
+    // Bumping the head past the whole buffer makes every slot stale.
+    m_head.fetch_add(s_capacity, std::memory_order_acq_rel);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVariantList>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+struct TraceEvent
+{
+    const char *category = nullptr;
+    const char *name = nullptr;
+    qint64 start = 0;    // microseconds since the tracer was created
+    qint64 duration = 0; // microseconds
+    quintptr thread = 0;
+};
+
+// Collects complete ("X") trace events into a fixed size lock-free ring buffer.
+// When tracing is disabled a TraceScope costs a single relaxed atomic load.
+class Tracer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+public:
+    static Tracer *instance();
+
+    static bool enabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    qint64 timestamp() const;
+    void record(const char *category, const char *name, qint64 start, qint64 end);
+
+    QVector<TraceEvent> snapshot() const;
+
+    Q_INVOKABLE qint64 now() const;
+    Q_INVOKABLE void complete(const QString &name, qint64 start);
+    Q_INVOKABLE QVariantList recent(int count = 10) const;
+    Q_INVOKABLE QString exportChromeTrace(const QString &fileName = QString()) const;
+    Q_INVOKABLE void clear();
+
+signals:
+    void enabledChanged(bool enabled);
+
+private:
+    explicit Tracer(QObject *parent = nullptr);
+
+    struct Slot
+    {
+        std::atomic<quint64> sequence {0};
+        std::atomic<const char *> category {nullptr};
+        std::atomic<const char *> name {nullptr};
+        std::atomic<qint64> start {0};
+        std::atomic<qint64> duration {0};
+        std::atomic<quintptr> thread {0};
+    };
+
+    static constexpr quint64 s_capacity = 1 << 14;
+    static std::atomic<bool> s_enabled;
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<quint64> m_head {0};
+    QElapsedTimer m_clock;
+};
+
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::enabled() ? Tracer::instance()->timestamp() : -1)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (m_start >= 0)
+        {
+            Tracer *tracer = Tracer::instance();
+            tracer->record(m_category, m_name, m_start, tracer->timestamp());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define QAI_TRACE_CONCAT_IMPL(a, b) a##b
+#define QAI_TRACE_CONCAT(a, b) QAI_TRACE_CONCAT_IMPL(a, b)
+#define QAI_TRACE_SCOPE(category, name) \
+    TraceScope QAI_TRACE_CONCAT(traceScope, __LINE__)(category, name)
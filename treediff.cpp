@@ -0,0 +1,553 @@
+#include "treediff.h"
+#include "tracer.h"
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <utility>
+
+namespace {
+
+size_t valueHash(const QJsonValue &value, size_t seed)
+{
+    switch (value.type())
+    {
+    case QJsonValue::Bool:
+        return qHash(value.toBool(), seed);
+    case QJsonValue::Double:
+        return qHash(value.toDouble(), seed);
+    case QJsonValue::String:
+        return qHash(value.toString(), seed);
+    case QJsonValue::Array:
+        return qHash(QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact), seed);
+    case QJsonValue::Object:
+        return qHash(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact), seed);
+    default:
+        return qHash(int(value.type()), seed);
+    }
+}
+
+size_t propertiesHash(const QJsonObject &data)
+{
+    // Keys are iterated in sorted order, so equal objects hash equally.
+    size_t hash = 0;
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it)
+    {
+        hash = qHashMulti(hash, it.key());
+        hash = valueHash(it.value(), hash);
+    }
+    return hash;
+}
+
+QString stringValue(const QJsonObject &data, QLatin1String key)
+{
+    return data.value(key).toVariant().toString();
+}
+
+class Differ
+{
+public:
+    explicit Differ(TreeDiff::Result &result)
+        : m_result(result)
+        , m_left(result.left)
+        , m_right(result.right)
+    {
+    }
+
+    void run()
+    {
+        if (!m_left.nodes.isEmpty() && !m_right.nodes.isEmpty())
+        {
+            diffPair(0, 0);
+        }
+        else if (!m_left.nodes.isEmpty())
+        {
+            m_removed.append(0);
+        }
+        else if (!m_right.nodes.isEmpty())
+        {
+            m_added.append(0);
+        }
+        matchMoves();
+    }
+
+private:
+    QVector<int> children(const TreeDiff::Tree &tree, int position) const
+    {
+        QVector<int> result;
+        const int end = position + tree.nodes.at(position).subtreeSize;
+        for (int child = position + 1; child <= end; child += tree.nodes.at(child).subtreeSize + 1)
+        {
+            result.append(child);
+        }
+        return result;
+    }
+
+    void diffPair(int left, int right)
+    {
+        const TreeDiff::Tree::Node &leftNode = m_left.nodes.at(left);
+        const TreeDiff::Tree::Node &rightNode = m_right.nodes.at(right);
+        if (leftNode.subtreeHash == rightNode.subtreeHash && leftNode.subtreeSize == rightNode.subtreeSize)
+        {
+            m_result.identical += leftNode.subtreeSize + 1;
+            return;
+        }
+
+        if (leftNode.hash != rightNode.hash)
+        {
+            m_result.changes.append({TreeDiff::Kind::Changed, left, right, propertyChanges(left, right)});
+        }
+        matchChildren(left, right);
+    }
+
+    void matchChildren(int left, int right)
+    {
+        const QVector<int> leftChildren = children(m_left, left);
+        const QVector<int> rightChildren = children(m_right, right);
+
+        QVector<int> pairs(leftChildren.size(), -1);
+        QVector<bool> rightMatched(rightChildren.size(), false);
+
+        // Identity keys, ignoring keys that are not unique among siblings.
+        QHash<QString, int> rightByKey;
+        for (int j = 0; j < rightChildren.size(); ++j)
+        {
+            const QString key = m_right.key(rightChildren.at(j));
+            if (!key.isEmpty())
+            {
+                auto it = rightByKey.find(key);
+                if (it == rightByKey.end())
+                {
+                    rightByKey.insert(key, j);
+                }
+                else
+                {
+                    *it = -1;
+                }
+            }
+        }
+        for (int i = 0; i < leftChildren.size() && !rightByKey.isEmpty(); ++i)
+        {
+            const QString key = m_left.key(leftChildren.at(i));
+            const int j = key.isEmpty() ? -1 : rightByKey.value(key, -1);
+            if (j >= 0 && !rightMatched.at(j))
+            {
+                pairs[i] = j;
+                rightMatched[j] = true;
+            }
+        }
+
+        // Identical subtrees that moved among their siblings.
+        QMultiHash<size_t, int> rightByHash;
+        for (int j = 0; j < rightChildren.size(); ++j)
+        {
+            if (!rightMatched.at(j))
+            {
+                rightByHash.insert(m_right.nodes.at(rightChildren.at(j)).subtreeHash, j);
+            }
+        }
+        for (int i = 0; i < leftChildren.size() && !rightByHash.isEmpty(); ++i)
+        {
+            if (pairs.at(i) >= 0)
+            {
+                continue;
+            }
+            const size_t hash = m_left.nodes.at(leftChildren.at(i)).subtreeHash;
+            for (auto it = rightByHash.find(hash); it != rightByHash.end() && it.key() == hash; ++it)
+            {
+                if (!rightMatched.at(it.value()))
+                {
+                    pairs[i] = it.value();
+                    rightMatched[it.value()] = true;
+                    rightByHash.erase(it);
+                    break;
+                }
+            }
+        }
+
+        // Whatever is left pairs up in order by classname.
+        int cursor = 0;
+        for (int i = 0; i < leftChildren.size(); ++i)
+        {
+            if (pairs.at(i) >= 0)
+            {
+                continue;
+            }
+            const QJsonValue classname = m_left.nodes.at(leftChildren.at(i)).data.value(QLatin1String("classname"));
+            for (int j = cursor; j < rightChildren.size(); ++j)
+            {
+                if (!rightMatched.at(j) &&
+                    m_right.nodes.at(rightChildren.at(j)).data.value(QLatin1String("classname")) == classname)
+                {
+                    pairs[i] = j;
+                    rightMatched[j] = true;
+                    cursor = j + 1;
+                    break;
+                }
+            }
+        }
+
+        for (int i = 0; i < leftChildren.size(); ++i)
+        {
+            if (pairs.at(i) >= 0)
+            {
+                diffPair(leftChildren.at(i), rightChildren.at(pairs.at(i)));
+            }
+            else
+            {
+                m_removed.append(leftChildren.at(i));
+            }
+        }
+        for (int j = 0; j < rightChildren.size(); ++j)
+        {
+            if (!rightMatched.at(j))
+            {
+                m_added.append(rightChildren.at(j));
+            }
+        }
+    }
+
+    // Identity keys that occur exactly once inside the given subtrees.
+    static QHash<QString, int> uniqueKeys(const TreeDiff::Tree &tree, const QVector<int> &roots)
+    {
+        QHash<QString, int> keys;
+        for (int root : roots)
+        {
+            const int end = root + tree.nodes.at(root).subtreeSize;
+            for (int position = root; position <= end; ++position)
+            {
+                const QString key = tree.key(position);
+                if (key.isEmpty())
+                {
+                    continue;
+                }
+                auto it = keys.find(key);
+                if (it == keys.end())
+                {
+                    keys.insert(key, position);
+                }
+                else
+                {
+                    *it = -1;
+                }
+            }
+        }
+        return keys;
+    }
+
+    void matchMoves()
+    {
+        const QVector<int> removed = std::exchange(m_removed, {});
+        const QVector<int> added = std::exchange(m_added, {});
+
+        const QHash<QString, int> leftKeys = uniqueKeys(m_left, removed);
+        const QHash<QString, int> rightKeys = uniqueKeys(m_right, added);
+        QVector<bool> consumed(m_right.nodes.size(), false);
+        QVector<bool> moved(m_left.nodes.size(), false);
+
+        for (int root : removed)
+        {
+            const int end = root + m_left.nodes.at(root).subtreeSize;
+            for (int position = root; position <= end; ++position)
+            {
+                const QString key = m_left.key(position);
+                if (key.isEmpty() || leftKeys.value(key) != position)
+                {
+                    continue;
+                }
+                const int right = rightKeys.value(key, -1);
+                if (right < 0 || consumed.at(right))
+                {
+                    continue;
+                }
+
+                const int rightEnd = right + m_right.nodes.at(right).subtreeSize;
+                for (int i = right; i <= rightEnd; ++i)
+                {
+                    consumed[i] = true;
+                }
+                moved[position] = true;
+
+                m_result.changes.append({TreeDiff::Kind::Moved, position, right, propertyChanges(position, right)});
+                matchChildren(position, right);
+                position += m_left.nodes.at(position).subtreeSize;
+            }
+        }
+
+        for (int root : removed)
+        {
+            if (!moved.at(root))
+            {
+                m_result.changes.append({TreeDiff::Kind::Removed, root, -1, {}});
+            }
+        }
+        for (int root : added)
+        {
+            if (!consumed.at(root))
+            {
+                m_result.changes.append({TreeDiff::Kind::Added, -1, root, {}});
+            }
+        }
+
+        // Leftovers from inside moved subtrees.
+        for (int root : std::as_const(m_removed))
+        {
+            m_result.changes.append({TreeDiff::Kind::Removed, root, -1, {}});
+        }
+        for (int root : std::as_const(m_added))
+        {
+            m_result.changes.append({TreeDiff::Kind::Added, -1, root, {}});
+        }
+    }
+
+    QVector<TreeDiff::PropertyChange> propertyChanges(int left, int right) const
+    {
+        const QJsonObject &leftData = m_left.nodes.at(left).data;
+        const QJsonObject &rightData = m_right.nodes.at(right).data;
+        const QStringList leftKeys = leftData.keys();
+        const QStringList rightKeys = rightData.keys();
+
+        // Both key lists are sorted, so a merge walk finds the differences.
+        QVector<TreeDiff::PropertyChange> changes;
+        int i = 0;
+        int j = 0;
+        while (i < leftKeys.size() || j < rightKeys.size())
+        {
+            if (j == rightKeys.size() || (i < leftKeys.size() && leftKeys.at(i) < rightKeys.at(j)))
+            {
+                changes.append({leftKeys.at(i), leftData.value(leftKeys.at(i)), QJsonValue::Undefined});
+                ++i;
+            }
+            else if (i == leftKeys.size() || rightKeys.at(j) < leftKeys.at(i))
+            {
+                changes.append({rightKeys.at(j), QJsonValue::Undefined, rightData.value(rightKeys.at(j))});
+                ++j;
+            }
+            else
+            {
+                const QJsonValue leftValue = leftData.value(leftKeys.at(i));
+                const QJsonValue rightValue = rightData.value(rightKeys.at(j));
+                if (leftValue != rightValue)
+                {
+                    changes.append({leftKeys.at(i), leftValue, rightValue});
+                }
+                ++i;
+                ++j;
+            }
+        }
+        return changes;
+    }
+
+    TreeDiff::Result &m_result;
+    const TreeDiff::Tree &m_left;
+    const TreeDiff::Tree &m_right;
+    QVector<int> m_removed;
+    QVector<int> m_added;
+};
+
+QJsonValue jsonValue(const QJsonValue &value)
+{
+    return value.isUndefined() ? QJsonValue(QJsonValue::Null) : value;
+}
+
+} // namespace
+
+namespace TreeDiff {
+
+Tree Tree::fromJson(const QJsonObject &root)
+{
+    QAI_TRACE_SCOPE("diff", "flatten");
+
+    Tree tree;
+    if (root.isEmpty())
+    {
+        return tree;
+    }
+
+    struct Entry
+    {
+        QJsonObject object;
+        int parent;
+    };
+    QVector<Entry> stack {{root, -1}};
+    while (!stack.isEmpty())
+    {
+        Entry entry = stack.takeLast();
+        const int position = tree.nodes.size();
+        const QJsonArray children = entry.object.take(QLatin1String("children")).toArray();
+
+        Node node;
+        node.data = entry.object;
+        node.parent = entry.parent;
+        tree.nodes.append(node);
+
+        for (int i = children.size() - 1; i >= 0; --i)
+        {
+            stack.append({children.at(i).toObject(), position});
+        }
+    }
+
+    tree.computeHashes();
+    return tree;
+}
+
+void Tree::computeHashes()
+{
+    QAI_TRACE_SCOPE("diff", "hash");
+
+    for (Node &node : nodes)
+    {
+        node.subtreeSize = 0;
+        node.hash = propertiesHash(node.data);
+    }
+    for (int position = nodes.size() - 1; position > 0; --position)
+    {
+        const Node &node = nodes.at(position);
+        nodes[node.parent].subtreeSize += node.subtreeSize + 1;
+    }
+
+    // Children come after their parent, so a reverse pass sees every
+    // child's subtree hash before the parent combines them in order.
+    for (int position = nodes.size() - 1; position >= 0; --position)
+    {
+        Node &node = nodes[position];
+        size_t hash = node.hash;
+        const int end = position + node.subtreeSize;
+        for (int child = position + 1; child <= end; child += nodes.at(child).subtreeSize + 1)
+        {
+            hash = qHashMulti(hash, nodes.at(child).subtreeHash);
+        }
+        node.subtreeHash = hash;
+    }
+}
+
+QString Tree::key(int position) const
+{
+    const QJsonObject &data = nodes.at(position).data;
+    QString identity = stringValue(data, QLatin1String("id"));
+    if (identity.isEmpty())
+    {
+        identity = stringValue(data, QLatin1String("objectName"));
+        if (identity.isEmpty())
+        {
+            return QString();
+        }
+    }
+    return stringValue(data, QLatin1String("classname")) + QLatin1Char('/') + identity;
+}
+
+QString Tree::label(int position) const
+{
+    const QJsonObject &data = nodes.at(position).data;
+    for (QLatin1String key : {QLatin1String("objectName"), QLatin1String("id"), QLatin1String("mainTextProperty")})
+    {
+        const QString value = stringValue(data, key);
+        if (!value.isEmpty())
+        {
+            return value;
+        }
+    }
+    return QString();
+}
+
+QString Tree::path(int position) const
+{
+    QStringList parts;
+    for (; position >= 0; position = nodes.at(position).parent)
+    {
+        parts.prepend(stringValue(nodes.at(position).data, QLatin1String("classname")));
+    }
+    return parts.join(QLatin1Char('/'));
+}
+
+QRect Tree::rect(int position) const
+{
+    const QJsonObject &data = nodes.at(position).data;
+    return QRect(data.value(QLatin1String("abs_x")).toVariant().toInt(),
+                 data.value(QLatin1String("abs_y")).toVariant().toInt(),
+                 data.value(QLatin1String("width")).toVariant().toInt(),
+                 data.value(QLatin1String("height")).toVariant().toInt());
+}
+
+Result diff(const QJsonObject &left, const QJsonObject &right)
+{
+    return diff(Tree::fromJson(left), Tree::fromJson(right));
+}
+
+Result diff(Tree left, Tree right)
+{
+    QAI_TRACE_SCOPE("diff", "diff");
+
+    Result result;
+    result.left = std::move(left);
+    result.right = std::move(right);
+    Differ(result).run();
+    return result;
+}
+
+QString kindName(Kind kind)
+{
+    switch (kind)
+    {
+    case Kind::Added:
+        return QStringLiteral("added");
+    case Kind::Removed:
+        return QStringLiteral("removed");
+    case Kind::Changed:
+        return QStringLiteral("changed");
+    case Kind::Moved:
+        return QStringLiteral("moved");
+    }
+    return QString();
+}
+
+QJsonObject toJson(const Result &result)
+{
+    QJsonArray changes;
+    for (const Change &change : result.changes)
+    {
+        const Tree &tree = change.left >= 0 ? result.left : result.right;
+        const int position = change.left >= 0 ? change.left : change.right;
+
+        QJsonObject object {
+            { QStringLiteral("kind"), kindName(change.kind) },
+            { QStringLiteral("classname"), tree.nodes.at(position).data.value(QLatin1String("classname")) },
+            { QStringLiteral("label"), tree.label(position) },
+        };
+        if (change.left >= 0)
+        {
+            object.insert(QStringLiteral("left"), result.left.path(change.left));
+        }
+        if (change.right >= 0)
+        {
+            object.insert(QStringLiteral("right"), result.right.path(change.right));
+        }
+        if (change.kind == Kind::Added || change.kind == Kind::Removed)
+        {
+            object.insert(QStringLiteral("nodes"), tree.nodes.at(position).subtreeSize + 1);
+        }
+
+        QJsonArray properties;
+        for (const PropertyChange &property : change.properties)
+        {
+            properties.append(QJsonObject {
+                { QStringLiteral("name"), property.name },
+                { QStringLiteral("left"), jsonValue(property.left) },
+                { QStringLiteral("right"), jsonValue(property.right) },
+            });
+        }
+        if (!properties.isEmpty())
+        {
+            object.insert(QStringLiteral("properties"), properties);
+        }
+        changes.append(object);
+    }
+
+    return QJsonObject {
+        { QStringLiteral("identical"), result.identical },
+        { QStringLiteral("changes"), changes },
+    };
+}
+
+} // namespace TreeDiff
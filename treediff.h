@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QRect>
+#include <QVector>
+
+// Structural diff of two dumps. Every node carries a hash of its own
+// properties and a Merkle hash of its whole subtree, so identical subtrees
+// are skipped after a single comparison. Children are paired by identity
+// (classname plus id or objectName), then by subtree hash, then in order by
+// classname; keyed nodes that changed parent are paired across the trees
+// afterwards and reported as moved.
+namespace TreeDiff {
+
+enum class Kind
+{
+    Added,
+    Removed,
+    Changed,
+    Moved,
+};
+
+// One dump flattened in pre-order. The children of the node at position p
+// start at p + 1 and the subtree ends at p + subtreeSize.
+struct Tree
+{
+    struct Node
+    {
+        QJsonObject data; // without children
+        int parent = -1;
+        int subtreeSize = 0;
+        size_t hash = 0;
+        size_t subtreeHash = 0;
+    };
+
+    static Tree fromJson(const QJsonObject &root);
+    // Fills subtreeSize, hash and subtreeHash once data and parent are set,
+    // for trees flattened from something other than JSON.
+    void computeHashes();
+
+    QString key(int position) const;
+    QString label(int position) const;
+    QString path(int position) const;
+    QRect rect(int position) const;
+
+    QVector<Node> nodes;
+};
+
+struct PropertyChange
+{
+    QString name;
+    QJsonValue left;
+    QJsonValue right;
+};
+
+struct Change
+{
+    Kind kind = Kind::Changed;
+    int left = -1;
+    int right = -1;
+    QVector<PropertyChange> properties;
+};
+
+struct Result
+{
+    Tree left;
+    Tree right;
+    QVector<Change> changes;
+    int identical = 0; // nodes inside skipped identical subtrees
+};
+
+Result diff(const QJsonObject &left, const QJsonObject &right);
+Result diff(Tree left, Tree right);
+
+QString kindName(Kind kind);
+QJsonObject toJson(const Result &result);
+
+} // namespace TreeDiff